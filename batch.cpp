@@ -0,0 +1,195 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include "batch.h"
+#include "keycache.h"
+#include "queue.h"
+#include "session.h"
+#include "errors.h"
+using namespace std;
+
+int read_manifest(char * manifest_file, vector<ManifestEntry>& entries) {
+  ifstream in(manifest_file);
+  if (!in) {
+    cerr << "Error opening manifest file " << manifest_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  entries.clear();
+  string text;
+  for (int line = 1; getline(in, text); line++) {
+    istringstream words(text);
+    ManifestEntry entry;
+    entry.line = line;
+    if (!(words >> entry.in_file) || entry.in_file[0] == '#')
+      continue;
+    words >> entry.out_file;
+    for (string word; words >> word; )
+      entry.key_files.push_back(word);
+
+    bool compiled_key = !entry.key_files.empty() && entry.key_files[0] == "--key";
+    if (entry.out_file.empty() || (compiled_key ? entry.key_files.size() != 2 : entry.key_files.size() < MIN_PARAMETERS - 1)) {
+      cerr << "Invalid entry in manifest " << manifest_file << " line " << line 
+        << " (input-file output-file (plugboard-file reflector-file (<rotor-file>)* rotor-positions | --key key-file))\n";
+      return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+    }
+    entries.push_back(entry);
+  }
+  return NO_ERROR;
+}
+
+/* A file travelling through the pipeline */
+struct BatchJob {
+  ManifestEntry const* entry;
+  shared_ptr<Machine const> machine;
+  vector<char> input, output;
+  size_t output_length = 0;
+  int res = NO_ERROR;
+  char error_input = 0;
+};
+
+/* This function reads a whole file */
+static int read_file(string const& file, vector<char>& data) {
+  ifstream in(file, ios::binary | ios::ate);
+  if (!in) {
+    cerr << "Error opening input file " << file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  data.resize(in.tellg());
+  in.seekg(0);
+  if (!in.read(data.data(), data.size())) {
+    cerr << "Error reading input file " << file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  return NO_ERROR;
+}
+
+/* This function encodes / decodes a job from the key's starting positions */
+static void encrypt_job(BatchJob& job) {
+  job.output.resize(job.input.size());
+  // only the offsets are the job's own (the keystream too is shared, if the key is compiled)
+  Session session(job.machine);
+  job.res = session.encrypt(job.input.data(), job.input.size(), job.output.data(), job.output_length, job.error_input);
+}
+
+int encrypt_batch_files(vector<ManifestEntry> const& entries, int num_of_threads, int queue_size, BatchStats& stats) {
+  auto start_time = chrono::steady_clock::now();
+  if (num_of_threads <= 0)
+    num_of_threads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+  // NULL marks the end of the jobs
+  BoundedQueue<BatchJob*> to_encrypt(queue_size), to_write(queue_size);
+  int first_error = NO_ERROR;
+
+  // reader: keys are parsed the first time they are named, files are read in manifest order
+  thread reader([&]() {
+    // large enough for every key of the manifest, so that none is parsed twice
+    KeyCache keys(entries.size());
+    for (ManifestEntry const& entry : entries) {
+      BatchJob* job = new BatchJob;
+      job->entry = &entry;
+      job->res = keys.get(entry.key_files, false, job->machine);
+      if (job->res == NO_ERROR)
+        job->res = read_file(entry.in_file, job->input);
+      // the key is compiled once a file long enough uses it
+      if (job->res == NO_ERROR && job->input.size() > (size_t) BLOCK_SIZE)
+        job->res = keys.get(entry.key_files, true, job->machine);
+      to_encrypt.push(job);
+    }
+    stats.keys = keys.size();
+    for (int t = 0; t < num_of_threads; t++)
+      to_encrypt.push(NULL);
+  });
+
+  // encryptors: each passes on the end of the jobs when it gets it
+  vector<thread> encryptors;
+  for (int t = 0; t < num_of_threads; t++) {
+    encryptors.push_back(thread([&]() {
+      for (BatchJob* job; (job = to_encrypt.pop()) != NULL; ) {
+        if (job->res == NO_ERROR)
+          encrypt_job(*job);
+        to_write.push(job);
+      }
+      to_write.push(NULL);
+    }));
+  }
+
+  // writer: the calling thread, until every encryptor has finished
+  for (int finished = 0; finished < num_of_threads; ) {
+    unique_ptr<BatchJob> job(to_write.pop());
+    if (!job) {
+      finished++;
+      continue;
+    }
+    ManifestEntry const& entry = *job->entry;
+    // letters before an invalid character are still written out
+    if (job->res == NO_ERROR || job->res == INVALID_INPUT_CHARACTER) {
+      ofstream out(entry.out_file, ios::binary | ios::trunc);
+      out.write(job->output.data(), job->output_length);
+      out.close();
+      if (!out) {
+        cerr << "Error writing output file " << entry.out_file << endl;
+        if (job->res == NO_ERROR)
+          job->res = ERROR_OPENING_CONFIGURATION_FILE;
+      }
+    }
+    if (job->res == INVALID_INPUT_CHARACTER)
+      cerr << entry.in_file << ": " << job->error_input << " is not a valid input character "
+        << "(input characters must be upper case letters A-Z)!\n";
+    if (job->res != NO_ERROR) {
+      cerr << "manifest line " << entry.line << " (" << entry.in_file << ") failed with error " << job->res << endl;
+      stats.failed++;
+      if (first_error == NO_ERROR)
+        first_error = job->res;
+    }
+    stats.files++;
+    stats.bytes_in += job->input.size();
+    stats.letters += job->output_length;
+  }
+
+  reader.join();
+  for (thread& encryptor : encryptors)
+    encryptor.join();
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+  return first_error;
+}
+
+int batch_command(int argc, char** argv) {
+  int num_of_threads = 0, queue_size = DEFAULT_BATCH_QUEUE_SIZE;
+  bool options_ok = true;
+  // skip "batch", then the options
+  argv++;
+  argc--;
+  while (argc > 1 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--threads") == 0)
+      num_of_threads = atoi(argv[1]);
+    else if (strcmp(argv[0], "--queue-size") == 0)
+      queue_size = atoi(argv[1]);
+    else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+  if (!options_ok || argc != 1 || queue_size <= 0) {
+    cerr << "usage: enigma batch [--threads N] [--queue-size Q] manifest-file\n"
+      << "(manifest lines: input-file output-file (plugboard-file reflector-file (<rotor-file>)* rotor-positions | --key key-file))\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  vector<ManifestEntry> entries;
+  int res = read_manifest(argv[0], entries);
+  if (res != NO_ERROR)
+    return res;
+  BatchStats stats;
+  res = encrypt_batch_files(entries, num_of_threads, queue_size, stats);
+  cerr << stats.files << " files (" << stats.failed << " failed, " << stats.keys << " keys), " 
+    << stats.bytes_in << " bytes in " << stats.seconds << " s ("
+    << (stats.seconds > 0 ? stats.files / stats.seconds : 0) << " files/s, "
+    << (stats.seconds > 0 ? stats.bytes_in / stats.seconds / 1e6 : 0) << " MB/s)\n";
+  return res;
+}
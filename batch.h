@@ -0,0 +1,67 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+using namespace std;
+
+/* Number of files each queue between the stages holds unless specified otherwise */
+int const DEFAULT_BATCH_QUEUE_SIZE = 16;
+
+/* 
+  One line of a batch manifest: input file, output file, then the key, either as the
+  configuration files of the enigma command or as "--key key-file"
+    in.txt out.txt plugboards/I.pb reflectors/I.rf rotors/I.rot rotors/II.rot rotors/I.pos
+    in2.txt out2.txt --key day1.key
+*/
+struct ManifestEntry {
+  string in_file, out_file;
+  /* The key's files, as in the manifest ("--key" and the key file for a compiled key) */
+  vector<string> key_files;
+  /* Line of the manifest (for error messages) */
+  int line = 0;
+};
+
+/* Counters filled in by encrypt_batch_files */
+struct BatchStats {
+  long long files = 0;
+  long long failed = 0;
+  /* Number of different keys parsed */
+  long long keys = 0;
+  long long bytes_in = 0;
+  long long letters = 0;
+  double seconds = 0;
+};
+
+/* 
+  This function reads a batch manifest
+  - parameters: manifest file, entries
+  - blank lines and lines starting with '#' are skipped
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int read_manifest(char * manifest_file, vector<ManifestEntry>& entries);
+
+/* 
+  This function encodes / decodes every file of a manifest through a pipeline of three stages
+  - parameters: entries, num_of_threads (encryptor threads, if <= 0 one per hardware thread), queue_size, stats
+  - reader (one thread): parses each key once (entries naming the same files share it) and reads the input files;
+    a key used on a file longer than BLOCK_SIZE is compiled into a Keystream, which later entries share too
+  - encryptors (num_of_threads): encode / decode from the key's starting positions
+  - writer (one thread): writes the output files
+  - the stages are connected by bounded lock-free queues of queue_size files, so reading a file overlaps 
+    with encrypting the previous ones and the memory held is bounded
+  - a file that fails (unreadable, invalid character...) is reported on stderr and counted in stats.failed,
+    the others go on; as in stream mode, the letters before an invalid character are still written
+  - returns an integer: 0 if NO _ERROR, the error code of the first failed file otherwise
+*/
+int encrypt_batch_files(vector<ManifestEntry> const& entries, int num_of_threads, int queue_size, BatchStats& stats);
+
+/* 
+  This function runs the "batch" subcommand
+  - usage: enigma batch [--threads N] [--queue-size Q] manifest-file
+  - parameters: argc, argv (argv[0] is "batch")
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int batch_command(int argc, char** argv);
+
+#endif
@@ -0,0 +1,316 @@
+// Benchmark suite covering every stage of the machine.
+//
+// usage: enigma_bench [--quick] [--corpus bytes] [--output results.json] [--baseline old.json [--tolerance percent]]
+//        enigma_bench --generate bytes [--seed N] [--spaces]
+//
+// Results are written as JSON (one result per line) so that runs of two
+// releases can be compared with --baseline: the exit code is non-zero if
+// any result is more than --tolerance percent (default 10) slower.
+// Must be run from the repository root (it reads plugboards/, reflectors/ and rotors/).
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "enigma.h"
+#include "errors.h"
+#include "keyfile.h"
+#include "keystream.h"
+#include "lanes.h"
+#include "machine.h"
+using namespace std;
+
+/* Gives the benchmarks access to Rotor::rotate */
+struct RotorBenchmark {
+  static bool rotate(Rotor& rotor) {
+    return rotor.rotate();
+  }
+};
+
+static char const* const ROTOR_FILES[] = {"rotors/I.rot", "rotors/II.rot", "rotors/III.rot", "rotors/IV.rot", "rotors/V.rot", "rotors/VI.rot", "rotors/VII.rot", "rotors/VIII.rot"};
+static char const* const PLUGBOARD_FILE = "plugboards/V.pb";
+static char const* const REFLECTOR_FILE = "reflectors/I.rf";
+static char const* const POSITION_FILE = "rotors/III.pos";
+
+/* One measurement: value is always a rate (higher is better) */
+struct Result {
+  string name;
+  double value;
+  string unit;
+};
+
+/* Keeps the compiler from optimising the measured work away */
+static volatile long long sink;
+
+/* 
+  Generates a deterministic corpus of letters (64-bit LCG, so the same on every platform)
+  - with_spaces: a space every 5 letters and a newline every 12 groups, like real traffic
+*/
+static string generate_corpus(size_t bytes, uint64_t seed, bool with_spaces) {
+  string corpus;
+  corpus.reserve(bytes);
+  uint64_t state = seed * 6364136223846793005ull + 1442695040888963407ull;
+  for (size_t letters = 0; corpus.size() < bytes; letters++) {
+    if (with_spaces && letters > 0 && letters % 5 == 0)
+      corpus += letters % 60 == 0 ? '\n' : ' ';
+    if (corpus.size() == bytes)
+      break;
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    corpus += 'A' + (state >> 33) % TOTAL_ALPHABET_COUNT;
+  }
+  return corpus;
+}
+
+/* 
+  Runs body (which processes 'units' items per call) repeatedly for at least min_seconds, 
+  three times, and returns the best rate in items per second
+*/
+static double measure(double min_seconds, double units, function<void()> const& body) {
+  double best = 0;
+  for (int repeat = 0; repeat < 3; repeat++) {
+    long long calls = 0;
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    do {
+      body();
+      calls++;
+      elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < min_seconds);
+    best = max(best, calls * units / elapsed);
+  }
+  return best;
+}
+
+// rotors I, II, ... set up from their files at position 0
+static void load_rotors(int num_of_rotors, vector<Rotor>& rotors, vector<Rotor*>& rotors_ptr) {
+  rotors.clear();
+  rotors_ptr.clear();
+  rotors.reserve(num_of_rotors);
+  for (int i = 0; i < num_of_rotors; i++) {
+    rotors.push_back(Rotor((char *) ROTOR_FILES[i]));
+    rotors.back().setup();
+    rotors_ptr.push_back(&rotors.back());
+  }
+}
+
+static void run_benchmarks(size_t corpus_bytes, double min_seconds, vector<Result>& results) {
+  int const rotor_counts[] = {0, 1, 3, 5, 8};
+  string corpus = generate_corpus(corpus_bytes, 1, false);
+  string traffic = generate_corpus(corpus_bytes, 2, true);
+
+  Plugboard pb((char *) PLUGBOARD_FILE);
+  Reflector rf((char *) REFLECTOR_FILE);
+  pb.setup();
+  rf.setup();
+  vector<Rotor> rotors;
+  vector<Rotor*> rotors_ptr;
+
+  // whole machine, through process_inputs (lines of MAX_LENGTH - 1 letters, as from cin.getline)
+  for (int num_of_rotors : rotor_counts) {
+    load_rotors(num_of_rotors, rotors, rotors_ptr);
+    size_t line_length = MAX_LENGTH - 1, num_of_lines = corpus.size() / line_length;
+    vector<string> lines;
+    for (size_t l = 0; l < num_of_lines; l++)
+      lines.push_back(corpus.substr(l * line_length, line_length));
+    double rate = measure(min_seconds, num_of_lines * line_length, [&]() {
+      char output[MAX_LENGTH], error_input;
+      for (string const& line : lines) {
+        int output_length = 0;
+        process_inputs(line.c_str(), output, output_length, num_of_rotors, pb, rotors_ptr.data(), rf, error_input);
+        sink += output[0];
+      }
+    });
+    results.push_back({"process_inputs/rotors=" + to_string(num_of_rotors), rate, "chars/s"});
+  }
+
+  // whole machine, through process_block, on traffic with whitespace
+  for (int num_of_rotors : rotor_counts) {
+    load_rotors(num_of_rotors, rotors, rotors_ptr);
+    vector<char> output(traffic.size());
+    double rate = measure(min_seconds, traffic.size(), [&]() {
+      int output_length = 0;
+      char error_input;
+      process_block(traffic.data(), traffic.size(), output.data(), output_length, num_of_rotors, pb, rotors_ptr.data(), rf, error_input);
+      sink += output_length;
+    });
+    results.push_back({"process_block/rotors=" + to_string(num_of_rotors), rate, "bytes/s"});
+  }
+
+  // whole machine, through a compiled keystream
+  {
+    load_rotors(3, rotors, rotors_ptr);
+    Keystream keystream;
+    keystream.compile(pb, rf, 3, rotors_ptr.data());
+    vector<char> output(traffic.size());
+    long long step = 0;
+    double rate = measure(min_seconds, traffic.size(), [&]() {
+      int output_length = 0;
+      char error_input;
+      keystream.process_block(traffic.data(), traffic.size(), output.data(), output_length, step, error_input);
+      sink += output_length;
+    });
+    results.push_back({"keystream/rotors=3", rate, "bytes/s"});
+    rate = measure(min_seconds, 1, [&]() {
+      Keystream compiled;
+      sink += compiled.compile(pb, rf, 3, rotors_ptr.data());
+    });
+    results.push_back({"keystream_compile/rotors=3", rate, "calls/s"});
+  }
+
+  // single stages, on the letters of the corpus
+  vector<int> letters(corpus.size());
+  for (size_t i = 0; i < corpus.size(); i++)
+    letters[i] = corpus[i] - 'A';
+  auto stage = [&](string const& name, function<void(int&)> const& function) {
+    double rate = measure(min_seconds, letters.size(), [&]() {
+      long long sum = 0;
+      for (int letter : letters) {
+        function(letter);
+        sum += letter;
+      }
+      sink += sum;
+    });
+    results.push_back({name, rate, "calls/s"});
+  };
+  load_rotors(1, rotors, rotors_ptr);
+  Rotor& rotor = rotors[0];
+  stage("Plugboard::process_input", [&](int& letter) { pb.process_input(letter); });
+  stage("Reflector::process_input", [&](int& letter) { rf.process_input(letter); });
+  stage("Rotor::process_input/forward", [&](int& letter) { rotor.process_input(letter); });
+  stage("Rotor::process_input/backward", [&](int& letter) { rotor.process_input(letter, false, true); });
+  stage("Rotor::process_input/rotate+forward", [&](int& letter) { rotor.process_input(letter, true); });
+  stage("Rotor::rotate", [&](int& letter) { letter += RotorBenchmark::rotate(rotor); });
+
+  // parsers
+  auto parser = [&](string const& name, function<int()> const& function) {
+    double rate = measure(min_seconds, 1, [&]() { sink += function(); });
+    results.push_back({name, rate, "calls/s"});
+  };
+  parser("Plugboard::setup", [&]() { Plugboard parsed((char *) PLUGBOARD_FILE); return parsed.setup(); });
+  parser("Reflector::setup", [&]() { Reflector parsed((char *) REFLECTOR_FILE); return parsed.setup(); });
+  parser("Rotor::setup", [&]() { Rotor parsed((char *) ROTOR_FILES[0]); return parsed.setup(); });
+  parser("get_starting_pos", [&]() { int starting_pos[3]; return get_starting_pos((char *) POSITION_FILE, 3, starting_pos); });
+  char* rot_files[3] = {(char *) ROTOR_FILES[0], (char *) ROTOR_FILES[1], (char *) ROTOR_FILES[2]};
+  parser("Machine::load/rotors=3", [&]() { Machine machine; return machine.load((char *) PLUGBOARD_FILE, (char *) REFLECTOR_FILE, 3, rot_files, (char *) POSITION_FILE); });
+  {
+    Machine machine;
+    machine.load((char *) PLUGBOARD_FILE, (char *) REFLECTOR_FILE, 3, rot_files, (char *) POSITION_FILE);
+    char key_file[] = "/tmp/enigma_bench.key";
+    write_key_file(key_file, machine);
+    parser("read_key_file/rotors=3", [&]() { Machine loaded; return read_key_file(key_file, loaded); });
+    remove(key_file);
+  }
+}
+
+static void write_results(ostream& out, size_t corpus_bytes, vector<Result> const& results) {
+  out << "{\n  \"benchmark\": \"enigma\",\n  \"version\": 1,\n  \"corpus_bytes\": " << corpus_bytes << ",\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    out << "    {\"name\": \"" << results[i].name << "\", \"value\": " << results[i].value 
+      << ", \"unit\": \"" << results[i].unit << "\"}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "  ]\n}\n";
+}
+
+// reads the name and value of every result written by write_results
+static bool read_results(char const* file, map<string, double>& values) {
+  ifstream in(file);
+  if (!in)
+    return false;
+  string line;
+  while (getline(in, line)) {
+    size_t name = line.find("\"name\": \""), value = line.find("\"value\": ");
+    if (name == string::npos || value == string::npos)
+      continue;
+    name += 9;
+    values[line.substr(name, line.find('"', name) - name)] = atof(line.c_str() + value + 9);
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  size_t corpus_bytes = 1 << 20, generate_bytes = 0;
+  double min_seconds = 0.2, tolerance = 10;
+  uint64_t seed = 1;
+  bool spaces = false;
+  char const* output_file = NULL;
+  char const* baseline_file = NULL;
+  for (int i = 1; i < argc; i++) {
+    bool has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--quick") == 0) {
+      corpus_bytes = 1 << 16;
+      min_seconds = 0.02;
+    } else if (strcmp(argv[i], "--corpus") == 0 && has_value)
+      corpus_bytes = atoll(argv[++i]);
+    else if (strcmp(argv[i], "--output") == 0 && has_value)
+      output_file = argv[++i];
+    else if (strcmp(argv[i], "--baseline") == 0 && has_value)
+      baseline_file = argv[++i];
+    else if (strcmp(argv[i], "--tolerance") == 0 && has_value)
+      tolerance = atof(argv[++i]);
+    else if (strcmp(argv[i], "--generate") == 0 && has_value)
+      generate_bytes = atoll(argv[++i]);
+    else if (strcmp(argv[i], "--seed") == 0 && has_value)
+      seed = atoll(argv[++i]);
+    else if (strcmp(argv[i], "--spaces") == 0)
+      spaces = true;
+    else {
+      cerr << "usage: enigma_bench [--quick] [--corpus bytes] [--output results.json] [--baseline old.json [--tolerance percent]]\n"
+        << "       enigma_bench --generate bytes [--seed N] [--spaces]\n";
+      return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+    }
+  }
+
+  // corpus generator only, in blocks so that any size can be generated
+  if (generate_bytes > 0) {
+    size_t const block = 1 << 20;
+    for (size_t done = 0, part = 0; done < generate_bytes; done += block, part++) {
+      string corpus = generate_corpus(min(block, generate_bytes - done), seed * 1000003 + part, spaces);
+      cout.write(corpus.data(), corpus.size());
+    }
+    return NO_ERROR;
+  }
+
+  ifstream check((char *) ROTOR_FILES[0]);
+  if (!check) {
+    cerr << "run enigma_bench from the repository root (configuration files not found)\n";
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+
+  vector<Result> results;
+  run_benchmarks(corpus_bytes, min_seconds, results);
+  for (Result const& result : results)
+    cerr << result.name << ": " << result.value / 1e6 << " M " << result.unit << "\n";
+
+  if (output_file) {
+    ofstream out(output_file);
+    write_results(out, corpus_bytes, results);
+  } else
+    write_results(cout, corpus_bytes, results);
+
+  if (baseline_file) {
+    map<string, double> baseline;
+    if (!read_results(baseline_file, baseline)) {
+      cerr << "Error opening baseline " << baseline_file << endl;
+      return ERROR_OPENING_CONFIGURATION_FILE;
+    }
+    int regressions = 0;
+    for (Result const& result : results) {
+      auto old = baseline.find(result.name);
+      if (old == baseline.end() || old->second <= 0)
+        continue;
+      double change = (result.value / old->second - 1) * 100;
+      if (change < -tolerance) {
+        cerr << "REGRESSION " << result.name << ": " << change << "%\n";
+        regressions++;
+      }
+    }
+    cerr << regressions << " regression(s) beyond " << tolerance << "%\n";
+    return regressions > 0 ? 1 : NO_ERROR;
+  }
+  return NO_ERROR;
+}
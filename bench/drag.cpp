@@ -0,0 +1,96 @@
+// Measures the word scan of crib dragging on its own: one pass of the
+// Aho-Corasick automaton over random letters against one pass per word (the
+// text re-scanned for every word), for word lists of a few sizes, in MB/s.
+// Both ways must count the same number of hits.
+//
+// usage: bench_drag [num_of_letters]
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "drag.h"
+#include "errors.h"
+using namespace std;
+
+static int const NUM_OF_RUNS = 3;
+
+/* This function returns the best time (in seconds) of NUM_OF_RUNS runs of run */
+template <class Run>
+static double best_of_runs(Run run) {
+  double best = 0;
+  for (int i = 0; i < NUM_OF_RUNS; i++) {
+    auto start = chrono::steady_clock::now();
+    run();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (i == 0 || secs < best)
+      best = secs;
+  }
+  return best;
+}
+
+/* This function counts the hits of all the words in one pass of the automaton */
+static long long scan_automaton(CribAutomaton const& automaton, vector<int> const& letters) {
+  long long hits = 0;
+  int state = 0;
+  for (int letter : letters) {
+    state = automaton.next(state, letter);
+    for (int match = automaton.match(state); match >= 0; hits++)
+      automaton.word_at(match);
+  }
+  return hits;
+}
+
+/* This function counts the hits of all the words, scanning the text once per word */
+static long long scan_per_word(vector<string> const& words, string const& text) {
+  long long hits = 0;
+  for (string const& word : words)
+    for (size_t at = text.find(word); at != string::npos; at = text.find(word, at + 1))
+      hits++;
+  return hits;
+}
+
+int main(int argc, char** argv) {
+  size_t num_of_letters = argc > 1 ? atoll(argv[1]) : 1 << 22;
+  if (num_of_letters == 0) {
+    cerr << "usage: bench_drag [num_of_letters]\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  srand(1);
+  vector<int> letters(num_of_letters);
+  string text(num_of_letters, 'A');
+  for (size_t i = 0; i < num_of_letters; i++) {
+    letters[i] = rand() % TOTAL_ALPHABET_COUNT;
+    text[i] = 'A' + letters[i];
+  }
+
+  for (int num_of_words : {10, 100, 1000, 5000}) {
+    // words of 4 to 10 letters, so that the short ones have hits in random text
+    vector<string> words(num_of_words);
+    for (string& word : words)
+      for (int length = 4 + rand() % 7; (int) word.size() < length; )
+        word += 'A' + rand() % TOTAL_ALPHABET_COUNT;
+    CribAutomaton automaton;
+    if (automaton.build(words) != NO_ERROR)
+      return INVALID_WORD_LIST;
+
+    // the automaton drops duplicate words, so the per-word scan takes its words
+    vector<string> distinct;
+    for (int w = 0; w < automaton.get_num_of_words(); w++)
+      distinct.push_back(automaton.get_word(w));
+
+    long long automaton_hits = 0, per_word_hits = 0;
+    double automaton_secs = best_of_runs([&]() { automaton_hits = scan_automaton(automaton, letters); });
+    double per_word_secs = best_of_runs([&]() { per_word_hits = scan_per_word(distinct, text); });
+    cout << num_of_words << " words (" << automaton.get_num_of_states() << " states): automaton "
+      << num_of_letters / automaton_secs / 1e6 << " MB/s, per word " << num_of_letters / per_word_secs / 1e6
+      << " MB/s (" << automaton_hits << " hits)\n";
+    if (automaton_hits != per_word_hits) {
+      cerr << "the automaton found " << automaton_hits << " hits, the per-word scan " << per_word_hits << '\n';
+      return 1;
+    }
+  }
+  return NO_ERROR;
+}
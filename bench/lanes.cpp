@@ -0,0 +1,118 @@
+// Compares encrypt_batch (scalar and AVX2 lanes) with the per-character
+// process_inputs loop on many short messages, each under its own key.
+//
+// usage: bench_lanes [num_of_messages] [message_length] [num_of_keys]
+// (message m is encrypted under key m % num_of_keys)
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "enigma.h"
+#include "errors.h"
+#include "lanes.h"
+using namespace std;
+
+static char const* const PLUGBOARDS[] = {"plugboards/null.pb", "plugboards/I.pb", "plugboards/II.pb", "plugboards/III.pb", "plugboards/IV.pb", "plugboards/V.pb"};
+static char const* const REFLECTORS[] = {"reflectors/I.rf", "reflectors/II.rf", "reflectors/III.rf", "reflectors/IV.rf", "reflectors/V.rf"};
+static char const* const ROTORS[] = {"rotors/I.rot", "rotors/II.rot", "rotors/III.rot", "rotors/IV.rot", "rotors/V.rot", "rotors/VI.rot", "rotors/VII.rot", "rotors/VIII.rot"};
+static int const NUM_OF_KEY_ROTORS = 3;
+
+/* A key whose configurations are set up once and shared by the benchmarked runs */
+struct Key {
+  Plugboard* pb;
+  Reflector* rf;
+  Rotor* rotors[NUM_OF_KEY_ROTORS];
+  BatchKey batch_key;
+};
+
+static double seconds_since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void report(char const* name, long long letters, double secs) {
+  cout << name << ": " << letters / secs / 1e6 << " M chars/s (" << secs * 1e3 << " ms)\n";
+}
+
+int main(int argc, char** argv) {
+  int num_of_messages = argc > 1 ? atoi(argv[1]) : 20000;
+  // process_inputs stops at MAX_LENGTH - 1 letters (the length cin.getline allows)
+  int message_length = argc > 2 ? atoi(argv[2]) : MAX_LENGTH - 1;
+  int num_of_keys = argc > 3 ? atoi(argv[3]) : 1024;
+  if (num_of_messages <= 0 || message_length <= 0 || message_length >= MAX_LENGTH || num_of_keys <= 0) {
+    cerr << "usage: bench_lanes [num_of_messages] [message_length < " << MAX_LENGTH << "] [num_of_keys]\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+  srand(1);
+
+  // keys drawn from the standard configuration files
+  vector<Key> keys(num_of_keys);
+  for (Key& key : keys) {
+    key.pb = new Plugboard((char *) PLUGBOARDS[rand() % 6]);
+    key.rf = new Reflector((char *) REFLECTORS[rand() % 5]);
+    int res = key.pb->setup();
+    if (res == NO_ERROR)
+      res = key.rf->setup();
+    for (int r = 0; r < NUM_OF_KEY_ROTORS && res == NO_ERROR; r++) {
+      key.rotors[r] = new Rotor((char *) ROTORS[rand() % 8]);
+      res = key.rotors[r]->setup();
+      key.rotors[r]->set_starting_position(rand() % TOTAL_ALPHABET_COUNT);
+    }
+    if (res != NO_ERROR) {
+      cerr << "run bench_lanes from the repository root (configuration files not found)\n";
+      return res;
+    }
+    key.batch_key.pb = key.pb;
+    key.batch_key.rf = key.rf;
+    key.batch_key.num_of_rotors = NUM_OF_KEY_ROTORS;
+    key.batch_key.rotors_ptr = key.rotors;
+  }
+
+  vector<string> messages(num_of_messages);
+  for (string& message : messages) {
+    for (int i=0; i < message_length; i++)
+      message += 'A' + rand() % TOTAL_ALPHABET_COUNT;
+  }
+  long long total_letters = (long long) num_of_messages * message_length;
+
+  // per-character loop: fresh copies of the rotors for every message
+  vector<string> expected(num_of_messages);
+  auto start = chrono::steady_clock::now();
+  for (int m = 0; m < num_of_messages; m++) {
+    Key& key = keys[m % num_of_keys];
+    Rotor rotors[NUM_OF_KEY_ROTORS] = {*key.rotors[0], *key.rotors[1], *key.rotors[2]};
+    Rotor* rotors_ptr[NUM_OF_KEY_ROTORS] = {&rotors[0], &rotors[1], &rotors[2]};
+    char output[MAX_LENGTH], error_input;
+    int output_length = 0;
+    process_inputs(messages[m].c_str(), output, output_length, NUM_OF_KEY_ROTORS, *key.pb, rotors_ptr, *key.rf, error_input);
+    expected[m].assign(output, output_length);
+  }
+  report("process_inputs", total_letters, seconds_since(start));
+
+  vector<char> outputs((size_t) num_of_messages * message_length);
+  vector<BatchMessage> batch(num_of_messages);
+  for (int simd = 0; simd <= 1; simd++) {
+    if (simd && !batch_simd_supported()) {
+      cout << "encrypt_batch (avx2): not supported on this CPU\n";
+      continue;
+    }
+    for (int m = 0; m < num_of_messages; m++) {
+      batch[m].key = &keys[m % num_of_keys].batch_key;
+      batch[m].input = messages[m].c_str();
+      batch[m].input_length = message_length;
+      batch[m].output = &outputs[(size_t) m * message_length];
+    }
+    start = chrono::steady_clock::now();
+    encrypt_batch(batch.data(), num_of_messages, simd);
+    report(simd ? "encrypt_batch (avx2)" : "encrypt_batch (scalar)", total_letters, seconds_since(start));
+
+    for (int m = 0; m < num_of_messages; m++) {
+      if (expected[m].compare(0, string::npos, batch[m].output, batch[m].output_length) != 0) {
+        cerr << "encrypt_batch output differs from process_inputs for message " << m << endl;
+        return 1;
+      }
+    }
+  }
+  return NO_ERROR;
+}
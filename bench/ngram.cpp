@@ -0,0 +1,92 @@
+// Measures NgramTable::score_batch on candidates of one message length, with
+// the scalar rolling index and with AVX2, for bigram to quadgram tables.
+// The tables are built from the counts of a random text with English letter
+// frequencies (the speed does not depend on where the counts come from).
+//
+// usage: bench_ngram [num_of_candidates] [candidate_length]
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "ngram.h"
+#include "errors.h"
+using namespace std;
+
+static int const NUM_OF_RUNS = 3;
+
+/* English letter frequencies (per thousand letters) */
+static double const FREQUENCIES[TOTAL_ALPHABET_COUNT] = {
+  82, 15, 28, 43, 127, 22, 20, 61, 70, 2, 8, 40, 24, 67, 75, 19, 1, 60, 63, 91, 28, 10, 24, 2, 20, 1
+};
+
+/* This function returns the best time (in seconds) of NUM_OF_RUNS runs of score */
+template <class Score>
+static double best_of_runs(Score score) {
+  double best = 0;
+  for (int run = 0; run < NUM_OF_RUNS; run++) {
+    auto start = chrono::steady_clock::now();
+    score();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (run == 0 || secs < best)
+      best = secs;
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+  int num_of_candidates = argc > 1 ? atoi(argv[1]) : 1 << 16;
+  int candidate_length = argc > 2 ? atoi(argv[2]) : 250;
+  if (num_of_candidates <= 0 || candidate_length < MAX_NGRAM_LENGTH) {
+    cerr << "usage: bench_ngram [num_of_candidates] [candidate_length]\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  mt19937 random(1);
+  discrete_distribution<int> english(FREQUENCIES, FREQUENCIES + TOTAL_ALPHABET_COUNT);
+  vector<int> corpus(1 << 22);
+  for (int& letter : corpus)
+    letter = english(random);
+  vector<int> letters((size_t) num_of_candidates * candidate_length);
+  for (int& letter : letters)
+    letter = english(random);
+  vector<double> scalar_scores(num_of_candidates), simd_scores(num_of_candidates);
+
+  for (int length = MIN_NGRAM_LENGTH; length <= MAX_NGRAM_LENGTH; length++) {
+    int size = 1;
+    for (int i = 0; i < length; i++)
+      size *= TOTAL_ALPHABET_COUNT;
+    vector<long long> counts(size, 0);
+    for (size_t i = 0; i + length <= corpus.size(); i++) {
+      int index = 0;
+      for (int k = 0; k < length; k++)
+        index = index * TOTAL_ALPHABET_COUNT + corpus[i + k];
+      counts[index]++;
+    }
+    NgramTable table;
+    table.build(length, counts);
+
+    double scalar_secs = best_of_runs([&]() {
+      table.score_batch(letters.data(), candidate_length, num_of_candidates, scalar_scores.data(), false);
+    });
+    cout << length << "-grams, scalar: " << num_of_candidates / scalar_secs << " candidates/s ("
+      << candidate_length << " letters each)\n";
+    if (!ngram_simd_supported())
+      continue;
+
+    double simd_secs = best_of_runs([&]() {
+      table.score_batch(letters.data(), candidate_length, num_of_candidates, simd_scores.data(), true);
+    });
+    cout << length << "-grams, avx2: " << num_of_candidates / simd_secs << " candidates/s ("
+      << scalar_secs / simd_secs << "x scalar)\n";
+    // the vector lanes add up in float, the scalar loop in double
+    for (int c = 0; c < num_of_candidates; c++) {
+      if (fabs(simd_scores[c] - scalar_scores[c]) > 1e-4 * fabs(scalar_scores[c])) {
+        cerr << "avx2 score of candidate " << c << " differs from the scalar score\n";
+        return 1;
+      }
+    }
+  }
+  return NO_ERROR;
+}
@@ -0,0 +1,117 @@
+// Measures the normalization stage ahead of the rotors: normalize_letters
+// (report mode) and restore_non_letters (pass mode), scalar and AVX2, on
+// clean text (upper case letters and spaces) and on noisy text (mixed case,
+// digits, punctuation and newlines), in GB/s of input. The AVX2 results are
+// checked against the scalar ones, and the compiled machine is timed on the
+// same letters for comparison.
+//
+// usage: bench_normalize [num_of_bytes]
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "machine.h"
+#include "normalize.h"
+#include "errors.h"
+using namespace std;
+
+static int const NUM_OF_RUNS = 3;
+
+/* This function returns the best time (in seconds) of NUM_OF_RUNS runs of run */
+template <class Run>
+static double best_of_runs(Run run) {
+  double best = 0;
+  for (int i = 0; i < NUM_OF_RUNS; i++) {
+    auto start = chrono::steady_clock::now();
+    run();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (i == 0 || secs < best)
+      best = secs;
+  }
+  return best;
+}
+
+/* This function fills input with words of letters, separated as described by noisy */
+static void make_text(vector<char>& input, bool noisy) {
+  char const punctuation[] = "0123456789.,;:!?'-()\n";
+  for (size_t i = 0; i < input.size(); i++) {
+    int r = rand() % 100;
+    if (r < 15)
+      input[i] = noisy && r < 5 ? punctuation[rand() % (sizeof(punctuation) - 1)] : noisy && r < 8 ? '\n' : ' ';
+    else
+      input[i] = (noisy && r < 60 ? 'a' : 'A') + rand() % TOTAL_ALPHABET_COUNT;
+  }
+}
+
+/* This function times one input both ways, and returns false if AVX2 and scalar differ */
+static bool bench_input(char const* name, vector<char> const& input, Machine& machine) {
+  size_t num_of_bytes = input.size();
+  vector<char> letters(num_of_bytes), expected(num_of_bytes), output(num_of_bytes), encrypted(num_of_bytes);
+  NormalizeOptions report, pass;
+  pass.non_letters = NON_LETTERS_PASS;
+  bool simd = normalize_simd_supported();
+
+  NormalizeStats scalar_stats, simd_stats;
+  size_t num_of_letters = normalize_letters(input.data(), num_of_bytes, expected.data(), report, scalar_stats, false);
+  size_t simd_letters = normalize_letters(input.data(), num_of_bytes, letters.data(), report, simd_stats, simd);
+  bool same = simd_letters == num_of_letters && memcmp(letters.data(), expected.data(), num_of_letters) == 0
+    && simd_stats.num_of_errors == scalar_stats.num_of_errors && simd_stats.non_letters == scalar_stats.non_letters;
+  for (size_t e = 0; same && e < scalar_stats.errors.size(); e++)
+    same = simd_stats.errors[e].position == scalar_stats.errors[e].position;
+
+  restore_non_letters(input.data(), num_of_bytes, letters.data(), expected.data(), pass, false);
+  restore_non_letters(input.data(), num_of_bytes, letters.data(), output.data(), pass, simd);
+  same = same && output == expected;
+
+  cout << name << " (" << num_of_bytes / 1e6 << " MB, " << num_of_letters * 100.0 / num_of_bytes << "% letters, "
+    << scalar_stats.num_of_errors << " invalid):\n";
+  for (int use_simd = 0; use_simd <= (simd ? 1 : 0); use_simd++) {
+    double normalize_secs = best_of_runs([&]() {
+      NormalizeStats stats;
+      normalize_letters(input.data(), num_of_bytes, letters.data(), report, stats, use_simd);
+    });
+    double restore_secs = best_of_runs([&]() {
+      restore_non_letters(input.data(), num_of_bytes, letters.data(), output.data(), pass, use_simd);
+    });
+    cout << "  " << (use_simd ? "avx2  " : "scalar") << ": normalize " << num_of_bytes / normalize_secs / 1e9
+      << " GB/s, restore " << num_of_bytes / restore_secs / 1e9 << " GB/s\n";
+  }
+
+  double machine_secs = best_of_runs([&]() {
+    char error_input;
+    size_t output_length;
+    machine.reset();
+    machine.encrypt(letters.data(), num_of_letters, encrypted.data(), output_length, error_input);
+  });
+  cout << "  compiled machine on its letters: " << num_of_bytes / machine_secs / 1e9 << " GB/s of input\n";
+  return same;
+}
+
+int main(int argc, char** argv) {
+  size_t num_of_bytes = argc > 1 ? atoll(argv[1]) : 1 << 27;
+  if (num_of_bytes == 0) {
+    cerr << "usage: bench_normalize [num_of_bytes]\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  char pb_file[] = "plugboards/I.pb", rf_file[] = "reflectors/I.rf", pos_file[] = "rotors/I.pos";
+  char rotor_1[] = "rotors/I.rot", rotor_2[] = "rotors/II.rot", rotor_3[] = "rotors/III.rot";
+  char* rot_files[] = {rotor_1, rotor_2, rotor_3};
+  Machine machine;
+  if (machine.load(pb_file, rf_file, 3, rot_files, pos_file) != NO_ERROR) {
+    cerr << "run bench_normalize from the repository root (configuration files not found)\n";
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  machine.compile();
+
+  srand(1);
+  vector<char> clean(num_of_bytes), noisy(num_of_bytes);
+  make_text(clean, false);
+  make_text(noisy, true);
+  if (!bench_input("clean text", clean, machine) || !bench_input("noisy text", noisy, machine)) {
+    cerr << "AVX2 normalization differs from the scalar one\n";
+    return 1;
+  }
+  return NO_ERROR;
+}
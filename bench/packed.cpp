@@ -0,0 +1,71 @@
+// Measures the packed letter codec: pack_letters and unpack_letters over
+// random letters, in GB/s of letters, with pext/pdep (where BMI2 is
+// available) and with the shift-and-or fallback. Every run is checked to
+// unpack back to its input.
+//
+// usage: bench_packed [num_of_letters]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "packed.h"
+#include "errors.h"
+using namespace std;
+
+static int const NUM_OF_RUNS = 3;
+
+/* This function returns the best time (in seconds) of NUM_OF_RUNS runs of run */
+template <class Run>
+static double best_of_runs(Run run) {
+  double best = 0;
+  for (int i = 0; i < NUM_OF_RUNS; i++) {
+    auto start = chrono::steady_clock::now();
+    run();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (i == 0 || secs < best)
+      best = secs;
+  }
+  return best;
+}
+
+/* This function times packing and unpacking letters one way, and returns false if they do not round-trip */
+static bool bench_codec(char const* name, vector<char> const& letters, bool use_bmi2) {
+  size_t num_of_letters = letters.size();
+  vector<unsigned char> packed(packed_size(num_of_letters));
+  vector<char> unpacked(num_of_letters);
+  bool valid = true;
+
+  double pack_secs = best_of_runs([&]() {
+    pack_letters(letters.data(), num_of_letters, packed.data(), use_bmi2);
+  });
+  double unpack_secs = best_of_runs([&]() {
+    valid = unpack_letters(packed.data(), num_of_letters, unpacked.data(), use_bmi2);
+  });
+  cout << name << ": pack " << num_of_letters / pack_secs / 1e9 << " GB/s, unpack "
+    << num_of_letters / unpack_secs / 1e9 << " GB/s (" << num_of_letters / 1e6 << " M letters -> "
+    << packed.size() / 1e6 << " MB)\n";
+  return valid && unpacked == letters;
+}
+
+int main(int argc, char** argv) {
+  size_t num_of_letters = argc > 1 ? atoll(argv[1]) : 1 << 28;
+  if (num_of_letters == 0) {
+    cerr << "usage: bench_packed [num_of_letters]\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  srand(1);
+  vector<char> letters(num_of_letters);
+  for (char& letter : letters)
+    letter = 'A' + rand() % TOTAL_ALPHABET_COUNT;
+
+  if (packing_bmi2_supported() && !bench_codec("pext/pdep (bmi2)", letters, true)) {
+    cerr << "unpacking with bmi2 does not give back the letters\n";
+    return 1;
+  }
+  if (!bench_codec("shifts (scalar)", letters, false)) {
+    cerr << "unpacking without bmi2 does not give back the letters\n";
+    return 1;
+  }
+  return NO_ERROR;
+}
@@ -0,0 +1,149 @@
+// Load generator for enigma serve: opens many connections, sends messages
+// one line at a time on each and reports the latency percentiles of the
+// replies and the aggregate throughput.
+//
+// usage: serve_load socket-path [--connections C] [--threads T] [--requests R] [--length L]
+// (each of the T threads drives C / T connections in turn, R messages of L letters per connection)
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "errors.h"
+using namespace std;
+
+struct LoadOptions {
+  int connections = 1000;
+  int threads = 4;
+  int requests = 20;
+  int length = 64;
+};
+
+/* This function connects to the server, returns the socket or -1 */
+static int connect_to(char const* socket_path) {
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd >= 0 && connect(fd, (sockaddr*) &address, sizeof(address)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* 
+  This function sends one message and reads its reply, up to the newline
+  - returns false if the connection failed or the reply is not length letters
+*/
+static bool request(int fd, string const& message, int length, vector<char>& reply) {
+  for (size_t sent = 0; sent < message.size(); ) {
+    ssize_t written = send(fd, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+    if (written <= 0)
+      return false;
+    sent += written;
+  }
+  reply.clear();
+  char buffer[4096];
+  while (reply.empty() || reply.back() != '\n') {
+    ssize_t received = read(fd, buffer, sizeof(buffer));
+    if (received <= 0)
+      return false;
+    reply.insert(reply.end(), buffer, buffer + received);
+  }
+  return (int) reply.size() == length + 1 && reply[0] != '!';
+}
+
+/* This function drives a share of the connections, and records the latency (in seconds) of every request */
+static void drive(char const* socket_path, LoadOptions const& options, int thread_index, vector<double>& latencies, long long& failures) {
+  vector<int> fds;
+  for (int c = thread_index; c < options.connections; c += options.threads) {
+    int fd = connect_to(socket_path);
+    if (fd < 0)
+      failures++;
+    else
+      fds.push_back(fd);
+  }
+
+  srand(thread_index + 1);
+  string message;
+  for (int i=0; i < options.length; i++)
+    message += 'A' + rand() % 26;
+  message += '\n';
+
+  vector<char> reply;
+  for (int r = 0; r < options.requests; r++) {
+    for (int fd : fds) {
+      auto start = chrono::steady_clock::now();
+      if (request(fd, message, options.length, reply))
+        latencies.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+      else
+        failures++;
+    }
+  }
+  for (int fd : fds)
+    close(fd);
+}
+
+static double percentile(vector<double> const& sorted, double fraction) {
+  if (sorted.empty())
+    return 0;
+  size_t index = (size_t) (fraction * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+int main(int argc, char** argv) {
+  LoadOptions options;
+  bool ok = argc >= 2 && strncmp(argv[1], "--", 2) != 0;
+  for (int i=2; ok && i < argc; i += 2) {
+    int value = i + 1 < argc ? atoi(argv[i + 1]) : 0;
+    if (strcmp(argv[i], "--connections") == 0)
+      options.connections = value;
+    else if (strcmp(argv[i], "--threads") == 0)
+      options.threads = value;
+    else if (strcmp(argv[i], "--requests") == 0)
+      options.requests = value;
+    else if (strcmp(argv[i], "--length") == 0)
+      options.length = value;
+    else
+      ok = false;
+    ok = ok && value > 0;
+  }
+  if (!ok) {
+    cerr << "usage: serve_load socket-path [--connections C] [--threads T] [--requests R] [--length L]\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+  options.threads = min(options.threads, options.connections);
+
+  vector<vector<double>> latencies(options.threads);
+  vector<long long> failures(options.threads);
+  auto start = chrono::steady_clock::now();
+  vector<thread> threads;
+  for (int t = 0; t < options.threads; t++)
+    threads.push_back(thread(drive, argv[1], cref(options), t, ref(latencies[t]), ref(failures[t])));
+  for (thread& t : threads)
+    t.join();
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  vector<double> all;
+  long long total_failures = 0;
+  for (int t = 0; t < options.threads; t++) {
+    all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+    total_failures += failures[t];
+  }
+  sort(all.begin(), all.end());
+
+  cout << "connections: " << options.connections << ", threads: " << options.threads
+    << ", requests: " << all.size() << " (" << total_failures << " failed)\n"
+    << "latency (us): p50 " << percentile(all, 0.50) * 1e6 << ", p90 " << percentile(all, 0.90) * 1e6
+    << ", p99 " << percentile(all, 0.99) * 1e6 << ", p99.9 " << percentile(all, 0.999) * 1e6
+    << ", max " << (all.empty() ? 0 : all.back() * 1e6) << "\n"
+    << "throughput: " << all.size() / secs << " requests/s, " 
+    << all.size() * (double) options.length / secs / 1e6 << " M letters/s\n";
+  return total_failures ? 1 : NO_ERROR;
+}
@@ -0,0 +1,113 @@
+// Compares the compile-time machine of static_machine.h with the runtime
+// machine (per-letter process_block, and a compiled Keystream) on the
+// common 3-rotor configuration: reflector I, rotors I II III. Machine::encrypt
+// is timed before it is compiled too, as it runs on the StaticMachine then.
+//
+// usage: bench_static [num_of_letters]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "enigma.h"
+#include "machine.h"
+#include "static_machine.h"
+#include "errors.h"
+using namespace std;
+
+typedef StaticMachine<wirings::Reflector_I, wirings::Rotor_I, wirings::Rotor_II, wirings::Rotor_III> StandardMachine;
+
+static int const NUM_OF_RUNS = 3;
+
+/* This function returns the best time (in seconds) of NUM_OF_RUNS runs of encrypt */
+template <class Encrypt>
+static double best_of_runs(Encrypt encrypt) {
+  double best = 0;
+  for (int run = 0; run < NUM_OF_RUNS; run++) {
+    auto start = chrono::steady_clock::now();
+    encrypt();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (run == 0 || secs < best)
+      best = secs;
+  }
+  return best;
+}
+
+static void report(char const* name, size_t letters, double secs, double baseline_secs) {
+  cout << name << ": " << letters / secs / 1e6 << " M chars/s (" << secs * 1e3 << " ms, "
+    << baseline_secs / secs << "x process_block)\n";
+}
+
+int main(int argc, char** argv) {
+  size_t num_of_letters = argc > 1 ? atoll(argv[1]) : 1 << 24;
+  if (num_of_letters == 0) {
+    cerr << "usage: bench_static [num_of_letters]\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  char pb_file[] = "plugboards/I.pb", rf_file[] = "reflectors/I.rf", pos_file[] = "rotors/I.pos";
+  char rotor_1[] = "rotors/I.rot", rotor_2[] = "rotors/II.rot", rotor_3[] = "rotors/III.rot";
+  char* rot_files[] = {rotor_1, rotor_2, rotor_3};
+  Machine machine;
+  if (machine.load(pb_file, rf_file, 3, rot_files, pos_file) != NO_ERROR) {
+    cerr << "run bench_static from the repository root (configuration files not found)\n";
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  if (!StandardMachine::matches(machine)) {
+    cerr << "wirings.h does not match the configuration files (make wirings.h)\n";
+    return INVALID_ROTOR_MAPPING;
+  }
+  StandardMachine standard(machine);
+
+  srand(1);
+  vector<char> input(num_of_letters), expected(num_of_letters), output(num_of_letters);
+  for (char& c : input)
+    c = 'A' + rand() % TOTAL_ALPHABET_COUNT;
+  char error_input;
+  size_t output_length = 0;
+
+  double runtime_secs = best_of_runs([&]() {
+    machine.reset();
+    output_length = 0;
+    // process_block takes int lengths, so the letters are fed in blocks
+    for (size_t begin = 0; begin < num_of_letters; begin += BLOCK_SIZE) {
+      int length = min(num_of_letters - begin, (size_t) BLOCK_SIZE), written = 0;
+      process_block(input.data() + begin, length, expected.data() + output_length, written, machine.get_num_of_rotors(),
+        machine.get_plugboard(), machine.get_rotors(), machine.get_reflector(), error_input);
+      output_length += written;
+    }
+  });
+  report("process_block", num_of_letters, runtime_secs, runtime_secs);
+
+  double static_secs = best_of_runs([&]() {
+    standard.reset();
+    output_length = 0;
+    standard.encrypt(input.data(), num_of_letters, output.data(), output_length, error_input);
+  });
+  report("StaticMachine", num_of_letters, static_secs, runtime_secs);
+  if (output != expected) {
+    cerr << "StaticMachine output differs from process_block\n";
+    return 1;
+  }
+
+  double machine_secs = best_of_runs([&]() {
+    machine.reset();
+    output_length = 0;
+    machine.encrypt(input.data(), num_of_letters, output.data(), output_length, error_input);
+  });
+  report("Machine::encrypt (not compiled)", num_of_letters, machine_secs, runtime_secs);
+  if (output != expected) {
+    cerr << "Machine::encrypt output differs from process_block\n";
+    return 1;
+  }
+
+  if (machine.compile()) {
+    double keystream_secs = best_of_runs([&]() {
+      machine.reset();
+      output_length = 0;
+      machine.encrypt(input.data(), num_of_letters, output.data(), output_length, error_input);
+    });
+    report("Keystream", num_of_letters, keystream_secs, runtime_secs);
+  }
+  return NO_ERROR;
+}
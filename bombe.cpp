@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include "bombe.h"
+#include "scheduler.h"
+#include "search.h"
+#include "errors.h"
+using namespace std;
+
+/* A link of the menu: the letter at the other end, and the crib letter (step) it comes from */
+struct MenuLink {
+  int other;
+  int step;
+};
+
+/* The part of the menu the bombe runs on */
+struct Menu {
+  /* links[x] are the links of letter x (empty for letters outside the menu) */
+  vector<MenuLink> links[TOTAL_ALPHABET_COUNT];
+  /* The letter with the most links, whose plugboard connection is hypothesised */
+  int centre = 0;
+  int num_of_letters = 0, num_of_links = 0;
+};
+
+/* This function builds the menu of a crib, and keeps its connected part with the most links */
+static void build_menu(int const cipher[], int const crib[], int crib_length, Menu& menu) {
+  int parent[TOTAL_ALPHABET_COUNT];
+  iota(parent, parent + TOTAL_ALPHABET_COUNT, 0);
+  auto root = [&](int x) {
+    while (parent[x] != x)
+      x = parent[x] = parent[parent[x]];
+    return x;
+  };
+  for (int j = 0; j < crib_length; j++)
+    parent[root(crib[j])] = root(cipher[j]);
+
+  int component_links[TOTAL_ALPHABET_COUNT] = {};
+  for (int j = 0; j < crib_length; j++)
+    component_links[root(crib[j])]++;
+  int best = max_element(component_links, component_links + TOTAL_ALPHABET_COUNT) - component_links;
+
+  for (int j = 0; j < crib_length; j++) {
+    if (root(crib[j]) != best)
+      continue;
+    menu.links[crib[j]].push_back(MenuLink{cipher[j], j});
+    menu.links[cipher[j]].push_back(MenuLink{crib[j], j});
+    menu.num_of_links++;
+  }
+  for (int x = 0; x < TOTAL_ALPHABET_COUNT; x++) {
+    if (!menu.links[x].empty())
+      menu.num_of_letters++;
+    if (menu.links[x].size() > menu.links[menu.centre].size())
+      menu.centre = x;
+  }
+}
+
+/* 
+  This function propagates the hypothesis "the centre is connected to value" through the menu
+  - parameters: menu, scramblers (scramblers[j] is the scrambler permutation at crib letter j), value, live
+  - live[x] gets bit v set for every "x is connected to v" that follows, through the menu links 
+    (x-v and a link x to y at step j give y-scrambler_j(v)) and the diagonal board (x-v gives v-x)
+  - stops at the first letter connected to two values: a wrong hypothesis usually does within a few links
+  - returns true if the hypothesis holds (no letter is connected to two values)
+*/
+static bool propagate(Menu const& menu, unsigned char const* const scramblers[], int value, uint32_t live[]) {
+  int pending[TOTAL_ALPHABET_COUNT * TOTAL_ALPHABET_COUNT][2];
+  int num_pending = 0;
+  memset(live, 0, TOTAL_ALPHABET_COUNT * sizeof(uint32_t));
+
+  // returns false if x is now connected to two values
+  auto light = [&](int x, int v) {
+    if ((live[x] >> v) & 1u)
+      return true;
+    live[x] |= 1u << v;
+    pending[num_pending][0] = x;
+    pending[num_pending][1] = v;
+    num_pending++;
+    return (live[x] & (live[x] - 1)) == 0;
+  };
+
+  light(menu.centre, value);
+  while (num_pending > 0) {
+    num_pending--;
+    int x = pending[num_pending][0], v = pending[num_pending][1];
+    if (!light(v, x))
+      return false;
+    for (MenuLink const& link : menu.links[x])
+      if (!light(link.other, scramblers[link.step][v]))
+        return false;
+  }
+  return true;
+}
+
+/* 
+  This function fills the scrambler (rotors and reflector, no plugboard) permutation of every position of a rotor order
+  - table[state * 26 + x] is the letter x is mapped to, state being the rotor offsets in base 26 (leftmost first)
+*/
+static void build_scramblers(Reflector const& rf, vector<Rotor const*> const& rotors, WorkStealingPool& pool, vector<unsigned char>& table) {
+  int num_of_rotors = rotors.size();
+  long long states_per_task = 1;
+  for (int i = 1; i < num_of_rotors; i++)
+    states_per_task *= TOTAL_ALPHABET_COUNT;
+  table.resize(states_per_task * TOTAL_ALPHABET_COUNT * TOTAL_ALPHABET_COUNT);
+  int const* rf_map = rf.get_mapping();
+
+  // one task per offset of the leftmost rotor
+  pool.run(TOTAL_ALPHABET_COUNT, [&](long long task, int) {
+    vector<int> offsets(num_of_rotors, 0);
+    offsets[0] = task;
+    for (long long s = 0; s < states_per_task; s++) {
+      unsigned char* scrambler = &table[(task * states_per_task + s) * TOTAL_ALPHABET_COUNT];
+      memset(scrambler, 0xff, TOTAL_ALPHABET_COUNT);
+      // the scrambler is an involution: each letter computed gives its partner too
+      for (int x = 0; x < TOTAL_ALPHABET_COUNT; x++) {
+        if (scrambler[x] != 0xff)
+          continue;
+        int y = x;
+        for (int r = num_of_rotors - 1; r >= 0; r--)
+          y = rotors[r]->map(y, offsets[r], false);
+        y = rf_map[y];
+        for (int r = 0; r < num_of_rotors; r++)
+          y = rotors[r]->map(y, offsets[r], true);
+        scrambler[x] = y;
+        scrambler[y] = x;
+      }
+      for (int i = num_of_rotors - 1; i > 0; i--) {
+        if (++offsets[i] < TOTAL_ALPHABET_COUNT)
+          break;
+        offsets[i] = 0;
+      }
+    }
+  });
+}
+
+void bombe_search(Reflector const& rf, vector<Rotor> const& rotor_set, int num_of_rotors, int const ciphertext[], int const crib[], 
+  int crib_length, long long crib_offset, int num_of_threads, vector<BombeStop>& stops, BombeStats& stats) {
+  auto start_time = chrono::steady_clock::now();
+  int const* cipher = ciphertext + crib_offset;
+  Menu menu;
+  build_menu(cipher, crib, crib_length, menu);
+  stats.menu_letters = menu.num_of_letters;
+  stats.menu_links = menu.num_of_links;
+
+  vector<vector<int>> orders;
+  rotor_orders(rotor_set.size(), num_of_rotors, orders);
+
+  WorkStealingPool pool(num_of_threads);
+  int num_of_workers = pool.get_num_of_workers();
+  vector<vector<BombeStop>> worker_stops(num_of_workers);
+  vector<long long> worker_settings(num_of_workers, 0);
+  vector<unsigned char> table;
+
+  for (vector<int> const& order : orders) {
+    vector<Rotor const*> order_rotors;
+    for (int r : order)
+      order_rotors.push_back(&rotor_set[r]);
+    build_scramblers(rf, order_rotors, pool, table);
+
+    // one task per starting position of the leftmost rotor
+    pool.run(TOTAL_ALPHABET_COUNT, [&](long long task, int worker) {
+      vector<unsigned char const*> scramblers(crib_length);
+      vector<int> offsets(num_of_rotors);
+      uint32_t live[TOTAL_ALPHABET_COUNT];
+
+      // the rotor copies are set to the crib
+      worker_settings[worker] += for_each_setting(rotor_set, order, task, crib_offset, [&](Rotor** rotors_ptr, vector<int> const& starting_pos) {
+        // the scrambler of every crib letter, from the precomputed table
+        for (int i = 0; i < num_of_rotors; i++)
+          offsets[i] = rotors_ptr[i]->get_offset();
+        for (int j = 0; j < crib_length; j++) {
+          for (int r = num_of_rotors - 1; r >= 0 && order_rotors[r]->step(offsets[r]); r--)
+            ;
+          long long state = 0;
+          for (int i = 0; i < num_of_rotors; i++)
+            state = state * TOTAL_ALPHABET_COUNT + offsets[i];
+          scramblers[j] = &table[state * TOTAL_ALPHABET_COUNT];
+        }
+
+        // every hypothesis for the centre's cable, each dropped at its first contradiction
+        for (int h = 0; h < TOTAL_ALPHABET_COUNT; h++) {
+          if (!propagate(menu, scramblers.data(), h, live))
+            continue;
+
+          // a stop: read the cables off the menu and decrypt the crib with them
+          BombeStop stop;
+          stop.rotor_order = order;
+          stop.starting_pos = starting_pos;
+          for (int x = 0; x < TOTAL_ALPHABET_COUNT; x++)
+            stop.pb_map[x] = live[x] ? __builtin_ctz(live[x]) : -1;
+          for (int x = 0; x < TOTAL_ALPHABET_COUNT; x++)
+            if (stop.pb_map[x] < 0)
+              stop.pb_map[x] = x;
+          for (int j = 0; j < crib_length; j++)
+            stop.matches += stop.pb_map[scramblers[j][stop.pb_map[cipher[j]]]] == crib[j];
+          worker_stops[worker].push_back(stop);
+        }
+      });
+    });
+  }
+
+  stops.clear();
+  stats.settings = 0;
+  for (int w = 0; w < num_of_workers; w++) {
+    stops.insert(stops.end(), worker_stops[w].begin(), worker_stops[w].end());
+    stats.settings += worker_settings[w];
+  }
+  stats.stops = stops.size();
+  stable_sort(stops.begin(), stops.end(), [](BombeStop const& a, BombeStop const& b) {
+    if (a.matches != b.matches)
+      return a.matches > b.matches;
+    return a.rotor_order != b.rotor_order ? a.rotor_order < b.rotor_order : a.starting_pos < b.starting_pos;
+  });
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+int bombe_command(int argc, char** argv) {
+  int num_of_threads = 0;
+  long long crib_offset = 0;
+  bool options_ok = true;
+  // skip "bombe", then the options
+  argv++;
+  argc--;
+  while (argc > 1 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--threads") == 0)
+      num_of_threads = atoi(argv[1]);
+    else if (strcmp(argv[0], "--crib-offset") == 0)
+      crib_offset = atoll(argv[1]);
+    else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+
+  int const min_parameters = 4;
+  int num_of_rotors = argc >= min_parameters ? atoi(argv[1]) : 0;
+  int num_of_rotor_files = argc - 3;
+  if (!options_ok || argc < min_parameters || num_of_rotors < 1 || num_of_rotors > num_of_rotor_files 
+      || num_of_rotors > MAX_BOMBE_ROTORS || crib_offset < 0 || argv[2][0] == '\0') {
+    cerr << "usage: enigma bombe [--threads N] [--crib-offset K] reflector-file num-of-rotors CRIB (<rotor-file>)+ < ciphertext\n"
+      << "(num-of-rotors must be between 1 and the number of rotor files, and at most " << MAX_BOMBE_ROTORS 
+      << "; CRIB must be at least one letter)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  Reflector rf(argv[0]);
+  int res = rf.setup();
+  if (res != NO_ERROR)
+    return res;
+
+  char* crib_text = argv[2];
+  vector<int> crib;
+  for (int i = 0; crib_text[i] != '\0'; i++) {
+    if (crib_text[i] < 'A' || crib_text[i] > 'Z') {
+      cerr << crib_text[i] << " is not a valid crib character "
+        << "(input characters must be upper case letters A-Z)!\n";
+      return INVALID_INPUT_CHARACTER;
+    }
+    crib.push_back(crib_text[i] - 'A');
+  }
+
+  char** rot_files = argv + 3;
+  vector<Rotor> rotor_set;
+  for (int i = 0; i < num_of_rotor_files; i++) {
+    rotor_set.push_back(Rotor(rot_files[i]));
+    if ((res = rotor_set.back().setup()) != NO_ERROR)
+      return res;
+  }
+
+  vector<int> ciphertext;
+  char error_input;
+  ios::sync_with_stdio(false);
+  if ((res = read_letters(cin, ciphertext, error_input)) != NO_ERROR) {
+    cerr << error_input << " is not a valid input character "
+      << "(input characters must be upper case letters A-Z)!\n";
+    return res;
+  }
+  if ((long long) ciphertext.size() < crib_offset + (long long) crib.size()) {
+    cerr << "The ciphertext is shorter than the crib (" << ciphertext.size() << " letters)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+  // the reflector never maps a letter to itself, so neither does the machine
+  for (size_t j = 0; j < crib.size(); j++) {
+    if (crib[j] == ciphertext[crib_offset + j]) {
+      cerr << "The crib cannot be at this position: letter " << j << " (" << crib_text[j] << ") would be encrypted to itself\n";
+      return INVALID_INPUT_CHARACTER;
+    }
+  }
+
+  vector<BombeStop> stops;
+  BombeStats stats;
+  bombe_search(rf, rotor_set, num_of_rotors, ciphertext.data(), crib.data(), crib.size(), crib_offset, num_of_threads, stops, stats);
+
+  for (BombeStop const& stop : stops) {
+    for (int r : stop.rotor_order)
+      cout << rot_files[r] << ' ';
+    cout << "positions:";
+    for (int p : stop.starting_pos)
+      cout << ' ' << p;
+    cout << " plugboard:";
+    for (int i = 0; i < TOTAL_ALPHABET_COUNT; i++) {
+      if (stop.pb_map[i] > i)
+        cout << ' ' << i << ' ' << stop.pb_map[i];
+    }
+    cout << " crib: " << stop.matches << '/' << crib.size() << '\n';
+  }
+  cout.flush();
+
+  cerr << "menu: " << stats.menu_letters << " letters, " << stats.menu_links << " links\n"
+    << "tested " << stats.settings << " settings in " << stats.seconds << " s ("
+    << (stats.seconds > 0 ? stats.settings / stats.seconds : 0) << " settings/s), "
+    << stats.stops << " stops decrypted\n";
+  return NO_ERROR;
+}
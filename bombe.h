@@ -0,0 +1,63 @@
+#ifndef BOMBE_H
+#define BOMBE_H
+
+#include <vector>
+#include "enigma.h"
+using namespace std;
+
+/* Largest number of rotors the bombe precomputes scrambler tables for (26^4 * 26 bytes per rotor order) */
+int const MAX_BOMBE_ROTORS = 4;
+
+/* A setting at which the bombe stopped, with the plugboard deduced from the menu */
+struct BombeStop {
+  /* Indices into the rotor set, leftmost rotor first */
+  vector<int> rotor_order;
+  /* Starting position of each rotor, leftmost rotor first */
+  vector<int> starting_pos;
+  /* 
+    Plugboard as a lookup table: the cables deduced from the menu, every other letter 
+    connected to itself
+  */
+  int pb_map[TOTAL_ALPHABET_COUNT];
+  /* Number of crib letters the decryption with this plugboard gets right */
+  int matches = 0;
+};
+
+/* Counters filled in by bombe_search */
+struct BombeStats {
+  /* Number of (rotor order, starting positions) settings tested */
+  long long settings = 0;
+  /* Number of settings that survived the menu and were decrypted in full */
+  long long stops = 0;
+  /* Number of letters and links in the part of the menu the bombe runs on */
+  int menu_letters = 0, menu_links = 0;
+  double seconds = 0;
+};
+
+/* 
+  This function runs a bombe: a crib search that does not need the plugboard
+  - parameters: reflector, rotor_set (rotors set up once from their files), num_of_rotors, ciphertext (letters 0-25),
+    crib (letters 0-25), crib_length, crib_offset (letter position of the crib in the ciphertext), num_of_threads, stops, stats
+  - the menu links crib letter j and ciphertext letter crib_offset + j through the scrambler (rotors and reflector)
+    at that step; the bombe runs on the connected part of the menu with the most links
+  - for each rotor order the scrambler permutation of every rotor position is precomputed once, so testing
+    a setting is table lookups and bit operations: each of the 26 plugboard hypotheses for the most connected
+    letter is propagated through the menu (and the "diagonal board": x-y implies y-x) as 26-bit sets, and
+    dropped at its first contradiction; a setting with no hypothesis left is rejected
+  - settings that survive are decrypted over the crib with the deduced plugboard (stats.stops)
+  - the starting positions of each rotor order are spread over num_of_threads workers with a WorkStealingPool
+  - stops is filled with the surviving settings, most crib matches first
+*/
+void bombe_search(Reflector const& rf, vector<Rotor> const& rotor_set, int num_of_rotors, int const ciphertext[], int const crib[], 
+  int crib_length, long long crib_offset, int num_of_threads, vector<BombeStop>& stops, BombeStats& stats);
+
+/* 
+  This function runs the "bombe" subcommand
+  - usage: enigma bombe [--threads N] [--crib-offset K] reflector-file num-of-rotors CRIB (<rotor-file>)+ < ciphertext
+  - parameters: argc, argv (argv[0] is "bombe")
+  - prints the stops to stdout (the plugboard in the plugboard file format) and the rates to stderr
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int bombe_command(int argc, char** argv);
+
+#endif
@@ -0,0 +1,364 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include "bytemode.h"
+#include "errors.h"
+using namespace std;
+
+ByteMachine::ByteMachine (int alphabet_count) : alphabet_count(alphabet_count) {
+  for (int i=0; i < MAX_ALPHABET_COUNT; i++) {
+    pb_map[i] = i;
+    rf_map[i] = i;
+    inner[i] = i;
+  }
+}
+
+int ByteMachine::read_config(char * file, char const* kind, vector<int>& values) const {
+  ifstream in(file);
+  if (!in) {
+    cerr << "Error opening " << kind << " file " << file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  values.clear();
+  int value;
+  while (in >> ws && in.peek() != char_traits<char>::eof()) {
+    if (!isdigit(in.peek())) {
+      cerr << "Non-numeric character in " << kind << " file " << file << endl;
+      return NON_NUMERIC_CHARACTER;
+    }
+    if (!(in >> value)) {
+      cerr << "Error reading " << kind << " file " << file << endl;
+      return ERROR_OPENING_CONFIGURATION_FILE;
+    }
+    values.push_back(value);
+  }
+  for (int v : values) {
+    if (v >= alphabet_count) {
+      cerr << "Invalid index in " << kind << " file " << file
+        << " (number should be between 0-" << alphabet_count - 1 << ")\n";
+      return INVALID_INDEX;
+    }
+  }
+  return NO_ERROR;
+}
+
+int ByteMachine::load(char * pb_file, char * rf_file, int num_of_rotors, char** rot_files, char * pos_file) {
+  int const n = alphabet_count;
+  if (n < 2 || n > MAX_ALPHABET_COUNT || n % 2) {
+    cerr << "Invalid alphabet size " << n << " (should be even, between 2-" << MAX_ALPHABET_COUNT << ")\n";
+    return INVALID_INDEX;
+  }
+
+  // plugboard: pairs of symbols, each symbol used at most once
+  vector<int> values;
+  vector<bool> used(n);
+  int res = read_config(pb_file, "plugboard", values);
+  if (res != NO_ERROR)
+    return res;
+  if (values.size() % 2) {
+    cerr << "Incorrect number of parameters in plugboard file " << pb_file << endl;
+    return INCORRECT_NUMBER_OF_PLUGBOARD_PARAMETERS;
+  }
+  for (int i=0; i < n; i++)
+    pb_map[i] = i;
+  for (size_t i=0; i < values.size(); i += 2) {
+    if (used[values[i]] || used[values[i+1]] || values[i] == values[i+1]) {
+      cerr << "Impossible plugboard configuration. There is more than one attempt to make contact with "
+        << (used[values[i]] ? values[i] : values[i+1]) << endl;
+      return IMPOSSIBLE_PLUGBOARD_CONFIGURATION;
+    }
+    used[values[i]] = used[values[i+1]] = true;
+    pb_map[values[i]] = values[i+1];
+    pb_map[values[i+1]] = values[i];
+  }
+
+  // reflector: alphabet_count / 2 pairs covering every symbol
+  res = read_config(rf_file, "reflector", values);
+  if (res != NO_ERROR)
+    return res;
+  if ((int) values.size() != n) {
+    cerr << "Incorrect number of mappings in reflector file " << rf_file
+      << " (" << values.size() << " instead of " << n << ")\n";
+    return INCORRECT_NUMBER_OF_REFLECTOR_PARAMETERS;
+  }
+  used.assign(n, false);
+  for (int i=0; i < n; i += 2) {
+    if (used[values[i]] || used[values[i+1]] || values[i] == values[i+1]) {
+      cerr << "Invalid reflector mapping: duplicated mapping of "
+        << (used[values[i]] ? values[i] : values[i+1]) << endl;
+      return INVALID_REFLECTOR_MAPPING;
+    }
+    used[values[i]] = used[values[i+1]] = true;
+    rf_map[values[i]] = values[i+1];
+    rf_map[values[i+1]] = values[i];
+  }
+
+  // rotors: a permutation of the alphabet, then the notches
+  vector<ByteRotor> loaded(num_of_rotors);
+  for (int r=0; r < num_of_rotors; r++) {
+    res = read_config(rot_files[r], "rotor", values);
+    if (res != NO_ERROR)
+      return res;
+    if ((int) values.size() < n) {
+      cerr << "Not all inputs mapped in rotor file: " << rot_files[r] << endl;
+      return INVALID_ROTOR_MAPPING;
+    }
+    used.assign(n, false);
+    for (int i=0; i < n; i++) {
+      if (used[values[i]]) {
+        cerr << "Invalid mapping of input " << i << " to output " << values[i]
+          << " (output is already mapped to) in rotor file: " << rot_files[r] << endl;
+        return INVALID_ROTOR_MAPPING;
+      }
+      used[values[i]] = true;
+    }
+    ByteRotor& rotor = loaded[r];
+    rotor.notch.assign(n, false);
+    for (size_t i=n; i < values.size(); i++) {
+      if (rotor.notch[values[i]]) {
+        cerr << "Invalid mapping of notches: duplicated mapping of " << values[i] << endl;
+        return INVALID_ROTOR_MAPPING;
+      }
+      rotor.notch[values[i]] = true;
+    }
+
+    // one row per offset: the contact at index i of the rotated rotor is the contact
+    // at index i + offset of the unrotated wiring, and the output is shifted back by offset
+    rotor.forward.resize(n * n);
+    rotor.backward.resize(n * n);
+    vector<int> inverse(n);
+    for (int i=0; i < n; i++)
+      inverse[values[i]] = i;
+    for (int offset=0; offset < n; offset++) {
+      for (int i=0; i < n; i++) {
+        int shifted = (i + offset) % n;
+        rotor.forward[offset * n + i] = (values[shifted] - offset + n) % n;
+        rotor.backward[offset * n + i] = (inverse[shifted] - offset + n) % n;
+      }
+    }
+  }
+
+  // one starting position per rotor
+  vector<int> positions;
+  if (num_of_rotors > 0) {
+    res = read_config(pos_file, "rotor positions", positions);
+    if (res != NO_ERROR)
+      return res;
+    if ((int) positions.size() < num_of_rotors) {
+      cerr << "No starting position for " << num_of_rotors - positions.size()
+        << " rotor(s) in rotor position file: " << pos_file << endl;
+      return NO_ROTOR_STARTING_POSITION;
+    }
+    positions.resize(num_of_rotors);
+  }
+
+  this->num_of_rotors = num_of_rotors;
+  rotors.swap(loaded);
+  starting_pos.swap(positions);
+  build_tables();
+  reset();
+  return NO_ERROR;
+}
+
+void ByteMachine::build_tables() {
+  int const n = alphabet_count;
+  if (num_of_rotors == 0) {
+    // plugboard -> reflector -> plugboard: a single row, nothing steps
+    entry.assign(pb_map, pb_map + n);
+    exit.assign(pb_map, pb_map + n);
+    steady.clear();
+    return;
+  }
+
+  ByteRotor const& right = rotors.back();
+  entry.resize(n * n);
+  exit.resize(n * n);
+  for (int offset=0; offset < n; offset++) {
+    for (int i=0; i < n; i++) {
+      entry[offset * n + i] = right.forward[offset * n + pb_map[i]];
+      exit[offset * n + i] = pb_map[right.backward[offset * n + i]];
+    }
+  }
+
+  steady.assign(n, 0);
+  for (int offset=n - 2; offset >= 0; offset--)
+    steady[offset] = right.notch[offset + 1] ? 0 : steady[offset + 1] + 1;
+}
+
+void ByteMachine::build_inner(int first) {
+  int const n = alphabet_count;
+  if (num_of_rotors < 2) {
+    for (int i=0; i < n; i++)
+      inner[i] = rf_map[i];
+    return;
+  }
+  composite.resize((num_of_rotors - 1) * n);
+  for (int r=first; r <= num_of_rotors - 2; r++) {
+    unsigned char const* forward = rotors[r].forward.data() + rotors[r].offset * n;
+    unsigned char const* backward = rotors[r].backward.data() + rotors[r].offset * n;
+    unsigned char const* left = r == 0 ? rf_map : composite.data() + (r - 1) * n;
+    unsigned char* table = composite.data() + r * n;
+    for (int i=0; i < n; i++)
+      table[i] = backward[left[forward[i]]];
+  }
+  memcpy(inner, composite.data() + (num_of_rotors - 2) * n, n);
+}
+
+void ByteMachine::step() {
+  int const n = alphabet_count;
+  ByteRotor& right = rotors.back();
+  right.offset = right.offset == n - 1 ? 0 : right.offset + 1;
+  // a rotor that landed on a notch rotates the one on its left
+  int first = num_of_rotors - 1;
+  for (; first > 0 && rotors[first].notch[rotors[first].offset]; first--) {
+    ByteRotor& left = rotors[first - 1];
+    left.offset = left.offset == n - 1 ? 0 : left.offset + 1;
+  }
+  if (first < num_of_rotors - 1)
+    build_inner(first);
+}
+
+void ByteMachine::reset() {
+  for (int r=0; r < num_of_rotors; r++)
+    rotors[r].offset = starting_pos[r] % alphabet_count;
+  position = 0;
+  build_inner();
+}
+
+long long ByteMachine::get_position() const {
+  return position;
+}
+
+int ByteMachine::get_alphabet_count() const {
+  return alphabet_count;
+}
+
+int ByteMachine::encrypt(unsigned char const input[], size_t input_length, unsigned char output[], size_t& output_length) {
+  int const n = alphabet_count;
+  int res = NO_ERROR;
+  size_t length = input_length;
+  // every byte is a symbol of the 256-symbol alphabet, smaller alphabets stop at the first byte out of range
+  if (n < MAX_ALPHABET_COUNT) {
+    for (size_t i=0; i < input_length; i++) {
+      if (input[i] >= n) {
+        length = i;
+        res = INVALID_INPUT_CHARACTER;
+        break;
+      }
+    }
+  }
+
+  if (num_of_rotors == 0) {
+    for (size_t i=0; i < length; i++)
+      output[i] = exit[inner[entry[input[i]]]];
+  } else {
+    ByteRotor& right = rotors.back();
+    size_t i = 0;
+    while (i < length) {
+      // the symbols up to the next notch (or the end of the tables) only step the rightmost rotor,
+      // so inner stays the same and the rows of entry / exit follow one another
+      size_t run = min((size_t) steady[right.offset], length - i);
+      unsigned char const* entry_row = entry.data() + right.offset * n;
+      unsigned char const* exit_row = exit.data() + right.offset * n;
+      for (size_t k=0; k < run; k++) {
+        entry_row += n;
+        exit_row += n;
+        output[i + k] = exit_row[inner[entry_row[input[i + k]]]];
+      }
+      right.offset += run;
+      i += run;
+
+      // the next symbol lands on a notch or wraps around
+      if (i < length) {
+        step();
+        int row = right.offset * n;
+        output[i] = exit[row + inner[entry[row + input[i]]]];
+        i++;
+      }
+    }
+  }
+
+  position += length;
+  output_length = length;
+  return res;
+}
+
+/**************************** Stream ****************************/
+
+int encrypt_byte_stream(istream& in, ostream& out, ByteMachine& machine, StreamStats& stats) {
+  vector<unsigned char> input(BYTE_BLOCK_SIZE), output(BYTE_BLOCK_SIZE);
+  int res = NO_ERROR;
+  while (res == NO_ERROR && in) {
+    in.read((char*) input.data(), BYTE_BLOCK_SIZE);
+    size_t input_length = in.gcount(), output_length = 0;
+    if (input_length == 0)
+      break;
+    long long position = machine.get_position();
+    res = machine.encrypt(input.data(), input_length, output.data(), output_length);
+    if (res == INVALID_INPUT_CHARACTER)
+      cerr << "Byte " << (int) input[output_length] << " at offset " << position + output_length
+        << " is not a symbol of the " << machine.get_alphabet_count() << "-symbol alphabet\n";
+    out.write((char const*) output.data(), output_length);
+    stats.bytes_in += input_length;
+    stats.letters += output_length;
+  }
+  out.flush();
+  return res;
+}
+
+/**************************** Subcommand ****************************/
+
+int bytes_command(int argc, char** argv) {
+  int alphabet_count = MAX_ALPHABET_COUNT;
+  bool print_stats = false;
+  bool options_ok = true;
+  // skip "bytes", then the options
+  argv++;
+  argc--;
+  while (argc > 0 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--stats") == 0) {
+      print_stats = true;
+      argv++;
+      argc--;
+    } else if (strcmp(argv[0], "--alphabet") == 0 && argc > 1) {
+      alphabet_count = atoi(argv[1]);
+      argv += 2;
+      argc -= 2;
+    } else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+  }
+  // plugboard, reflector, rotors, positions (as enigma without its program name)
+  if (!options_ok || argc < MIN_PARAMETERS - 1) {
+    cerr << "usage: enigma bytes [--alphabet N] [--stats] plugboard-file reflector-file (<rotor-file>)* rotor-positions < input > output\n"
+      << "(N symbols, 256 by default: every byte of the input is one symbol)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  auto start_time = chrono::steady_clock::now();
+  ByteMachine machine(alphabet_count);
+  int res = machine.load(argv[0], argv[1], argc - 3, argv + 2, argv[argc - 1]);
+  if (res != NO_ERROR)
+    return res;
+
+  auto setup_time = chrono::steady_clock::now();
+  ios::sync_with_stdio(false);
+  StreamStats stats;
+  res = encrypt_byte_stream(cin, cout, machine, stats);
+
+  if (print_stats) {
+    auto end_time = chrono::steady_clock::now();
+    double setup_secs = chrono::duration<double>(setup_time - start_time).count();
+    double run_secs = chrono::duration<double>(end_time - setup_time).count();
+    cerr << "setup: " << setup_secs * 1e3 << " ms\n"
+      << "input: " << stats.bytes_in << " bytes, " << stats.letters << " symbols\n"
+      << "run: " << run_secs << " s ("
+      << (run_secs > 0 ? stats.bytes_in / run_secs / 1e9 : 0) << " GB/s)\n";
+  }
+  return res;
+}
@@ -0,0 +1,132 @@
+#ifndef BYTEMODE_H
+#define BYTEMODE_H
+
+#include <iostream>
+#include <vector>
+#include "enigma.h"
+using namespace std;
+
+/* Largest alphabet of a ByteMachine: every value of a byte is a symbol */
+int const MAX_ALPHABET_COUNT = 256;
+/* Size (in bytes) of the blocks read / written by encrypt_byte_stream */
+int const BYTE_BLOCK_SIZE = 1 << 20;
+
+/*
+  A machine over an alphabet of any size up to MAX_ALPHABET_COUNT symbols (0 to alphabet_count - 1),
+  with the same architecture as the letter machine: plugboard -> rotors -> reflector -> rotors(backwards) -> plugboard,
+  the rightmost rotor stepping on every symbol and each rotor stepping the one on its left when it lands on a notch.
+  The configuration files are those of the letter machine with alphabet_count mappings instead of 26
+  (e.g. bytes/I.rot has 256 numbers, then the notches), and the input is not text: each byte is one symbol,
+  nothing is skipped. With the 256-symbol alphabet any binary data can be encoded / decoded.
+
+  encrypt is table-driven: the wirings are expanded into one table per rotor offset, the plugboard is folded into
+  the tables of the rightmost rotor, and the other rotors and the reflector into a single table that only changes
+  on a turnover, so a symbol costs three lookups.
+*/
+class ByteMachine {
+  struct ByteRotor {
+    /* forward[offset * alphabet_count + i]: symbol i mapped R-L through the rotor turned to offset (backward: L-R) */
+    vector<unsigned char> forward, backward;
+    /* notch[i] is true if there is a notch at position i */
+    vector<bool> notch;
+    int offset = 0;
+  };
+
+  int alphabet_count;
+  int num_of_rotors = 0;
+  unsigned char pb_map[MAX_ALPHABET_COUNT];
+  unsigned char rf_map[MAX_ALPHABET_COUNT];
+  /* Rotors, leftmost first */
+  vector<ByteRotor> rotors;
+  vector<int> starting_pos;
+  /*
+    Tables of the rightmost rotor with the plugboard folded in, one row per offset:
+    entry[offset * alphabet_count + i] is symbol i after the plugboard and the rightmost rotor,
+    exit[offset * alphabet_count + i] is symbol i after the rightmost rotor (backwards) and the plugboard
+  */
+  vector<unsigned char> entry, exit;
+  /*
+    steady[offset]: number of steps the rightmost rotor can take from offset without landing on a notch
+    nor wrapping around to offset 0 (the symbols that can be processed without touching the other rotors)
+  */
+  vector<int> steady;
+  /*
+    composite[r * alphabet_count + i]: symbol i through rotors r..0 (forward), the reflector and rotors 0..r (backwards)
+    at their current offsets, for every rotor r but the rightmost one: a rotor that turns only invalidates its own
+    table and those on its right, each rebuilt from the one on its left in one lookup per symbol and table
+  */
+  vector<unsigned char> composite;
+  /* The other rotors (forward), the reflector and the other rotors (backwards) at their current offsets */
+  unsigned char inner[MAX_ALPHABET_COUNT];
+  /* Number of symbols processed since the last reset() */
+  long long position = 0;
+
+  /*
+    This function reads all the integers of a configuration file
+    - parameters: file, kind of file (for error messages), values
+    - returns an integer: 0 if NO _ERROR, > 0 otherwise
+  */
+  int read_config(char * file, char const* kind, vector<int>& values) const;
+  /* This function builds the tables of the rightmost rotor (entry, exit, steady) */
+  void build_tables();
+  /* 
+    This function rebuilds inner from the current offsets of the rotors other than the rightmost one
+    - parameter: first (leftmost rotor whose offset changed: the composite tables on its left are kept)
+  */
+  void build_inner(int first = 0);
+  /*
+    This function steps the rotors for one symbol, as rotors_processing does
+    - the rightmost rotor always rotates, and each rotor landing on a notch rotates the one on its left
+    - inner is rebuilt (from the leftmost rotor that rotated) if any rotor other than the rightmost one rotated
+  */
+  void step();
+
+  public:
+    /*
+      ByteMachine constructor: an empty machine (no cables, no rotors) until load() is called
+      - parameter: alphabet_count (2 to MAX_ALPHABET_COUNT, even so that the reflector can pair every symbol)
+    */
+    ByteMachine (int alphabet_count = MAX_ALPHABET_COUNT);
+    /*
+      This function loads the configuration files and sets the rotors to their starting positions
+      - parameters: plugboard file, reflector file, num_of_rotors, rotor files (leftmost first), rotor position file
+      - the files are checked against alphabet_count (indices between 0 and alphabet_count - 1)
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int load(char * pb_file, char * rf_file, int num_of_rotors, char** rot_files, char * pos_file);
+    /* This function sets the rotors back to their starting positions */
+    void reset();
+    /* This function returns the number of symbols processed since the last reset() */
+    long long get_position() const;
+    /* This function returns the number of symbols of the alphabet */
+    int get_alphabet_count() const;
+    /*
+      This function encodes / decodes a buffer of symbols from the current position
+      - parameters: input array, input_length, output array (with room for input_length symbols), output_length
+      - output_length is set to the number of symbols written: input_length unless a byte is not a symbol
+        of the alphabet (>= alphabet_count), in which case the symbols before it are still written
+      - the rotors keep their positions after returning, so consecutive blocks of one message can be
+        processed by consecutive calls
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int encrypt(unsigned char const input[], size_t input_length, unsigned char output[], size_t& output_length);
+};
+
+/*
+  This function encodes / decodes a whole binary stream
+  - parameters: input stream, output stream, machine, stats
+  - input is read and output is written in blocks of BYTE_BLOCK_SIZE bytes
+  - stats is updated with the number of bytes read and symbols written
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int encrypt_byte_stream(istream& in, ostream& out, ByteMachine& machine, StreamStats& stats);
+
+/*
+  This function runs the "bytes" subcommand
+  - usage: enigma bytes [--alphabet N] [--stats] plugboard-file reflector-file (<rotor-file>)* rotor-positions < input > output
+  - parameters: argc, argv (argv[0] is "bytes")
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int bytes_command(int argc, char** argv);
+
+#endif
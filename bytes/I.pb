@@ -0,0 +1,3 @@
+72 138 136 59 201 44 107 213 130 243 38 119 232 26 24 183
+157 21 145 202 115 229 169 84 127 25 255 14 158 185 140 85
+168 109 41 65 161 83 245 177
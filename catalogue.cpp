@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "catalogue.h"
+#include "fileheader.h"
+#include "machine.h"
+#include "scheduler.h"
+#include "search.h"
+#include "errors.h"
+using namespace std;
+
+/**************************** Signatures ****************************/
+
+// a product of two involutions is a partition of 13 (one part per pair of cycles)
+static int const HALF_ALPHABET_COUNT = TOTAL_ALPHABET_COUNT / 2;
+
+/* The partitions of 13 (parts in decreasing order), in a fixed order, and their indices */
+struct Partitions {
+  vector<vector<int>> list;
+  map<vector<int>, uint32_t> index;
+
+  Partitions () {
+    vector<int> parts;
+    add(HALF_ALPHABET_COUNT, HALF_ALPHABET_COUNT, parts);
+  }
+
+  void add(int remaining, int largest, vector<int>& parts) {
+    if (remaining == 0) {
+      index[parts] = list.size();
+      list.push_back(parts);
+      return;
+    }
+    for (int part = min(remaining, largest); part >= 1; part--) {
+      parts.push_back(part);
+      add(remaining - part, part, parts);
+      parts.pop_back();
+    }
+  }
+};
+
+static Partitions const& partitions() {
+  static Partitions const all;
+  return all;
+}
+
+/* 
+  This function turns the cycle lengths of a product into the index of its partition
+  - returns false if the lengths do not come in pairs of equal length adding up to 26
+*/
+static bool partition_index(vector<int> lengths, uint32_t& index) {
+  sort(lengths.rbegin(), lengths.rend());
+  vector<int> half;
+  int total = 0;
+  for (size_t i = 0; i < lengths.size(); i += 2) {
+    if (i + 1 >= lengths.size() || lengths[i] != lengths[i + 1] || lengths[i] <= 0)
+      return false;
+    half.push_back(lengths[i]);
+    total += 2 * lengths[i];
+  }
+  if (total != TOTAL_ALPHABET_COUNT)
+    return false;
+  index = partitions().index.at(half);
+  return true;
+}
+
+bool products_signature(int const products[NUM_OF_PRODUCTS][TOTAL_ALPHABET_COUNT], uint32_t& signature) {
+  uint32_t const num_of_partitions = partitions().list.size();
+  signature = 0;
+  for (int p = 0; p < NUM_OF_PRODUCTS; p++) {
+    // a permutation first, so that following the cycles terminates
+    unsigned mapped = 0;
+    for (int x = 0; x < TOTAL_ALPHABET_COUNT; x++) {
+      if (products[p][x] < 0 || products[p][x] >= TOTAL_ALPHABET_COUNT)
+        return false;
+      mapped |= 1u << products[p][x];
+    }
+    if (mapped != (1u << TOTAL_ALPHABET_COUNT) - 1)
+      return false;
+
+    vector<int> lengths;
+    bool visited[TOTAL_ALPHABET_COUNT] = {};
+    for (int x = 0; x < TOTAL_ALPHABET_COUNT; x++) {
+      int length = 0;
+      for (int y = x; !visited[y]; y = products[p][y]) {
+        visited[y] = true;
+        length++;
+      }
+      if (length > 0)
+        lengths.push_back(length);
+    }
+    uint32_t index;
+    if (!partition_index(lengths, index))
+      return false;
+    signature = signature * num_of_partitions + index;
+  }
+  return true;
+}
+
+uint32_t cycle_signature(Reflector const& rf, Rotor const* const rotors[], int num_of_rotors, int const starting_pos[]) {
+  vector<int> offsets(num_of_rotors);
+  for (int r = 0; r < num_of_rotors; r++)
+    offsets[r] = starting_pos[r] % TOTAL_ALPHABET_COUNT;
+  int const* rf_map = rf.get_mapping();
+
+  // the substitutions of the first six letters (each one an involution, so half of it is enough)
+  int substitutions[2 * NUM_OF_PRODUCTS][TOTAL_ALPHABET_COUNT];
+  for (int s = 0; s < 2 * NUM_OF_PRODUCTS; s++) {
+    for (int r = num_of_rotors - 1; r >= 0 && rotors[r]->step(offsets[r]); r--)
+      ;
+    int* substitution = substitutions[s];
+    fill(substitution, substitution + TOTAL_ALPHABET_COUNT, -1);
+    for (int x = 0; x < TOTAL_ALPHABET_COUNT; x++) {
+      if (substitution[x] >= 0)
+        continue;
+      int y = x;
+      for (int r = num_of_rotors - 1; r >= 0; r--)
+        y = rotors[r]->map(y, offsets[r], false);
+      y = rf_map[y];
+      for (int r = 0; r < num_of_rotors; r++)
+        y = rotors[r]->map(y, offsets[r], true);
+      substitution[x] = y;
+      substitution[y] = x;
+    }
+  }
+
+  int products[NUM_OF_PRODUCTS][TOTAL_ALPHABET_COUNT];
+  for (int p = 0; p < NUM_OF_PRODUCTS; p++)
+    for (int x = 0; x < TOTAL_ALPHABET_COUNT; x++)
+      products[p][x] = substitutions[p + NUM_OF_PRODUCTS][substitutions[p][x]];
+  uint32_t signature = 0;
+  products_signature(products, signature);
+  return signature;
+}
+
+bool parse_signature(char const* text, uint32_t& signature) {
+  uint32_t const num_of_partitions = partitions().list.size();
+  signature = 0;
+  char const* c = text;
+  for (int p = 0; p < NUM_OF_PRODUCTS; p++) {
+    vector<int> lengths;
+    while (isdigit((unsigned char) *c)) {
+      char* end;
+      lengths.push_back(strtol(c, &end, 10));
+      c = end;
+      if (*c == ',')
+        c++;
+    }
+    uint32_t index;
+    if (!partition_index(lengths, index))
+      return false;
+    signature = signature * num_of_partitions + index;
+    if (p < NUM_OF_PRODUCTS - 1 && *c++ != '/')
+      return false;
+  }
+  return *c == '\0';
+}
+
+string format_signature(uint32_t signature) {
+  uint32_t const num_of_partitions = partitions().list.size();
+  uint32_t indices[NUM_OF_PRODUCTS];
+  for (int p = NUM_OF_PRODUCTS - 1; p >= 0; p--) {
+    indices[p] = signature % num_of_partitions;
+    signature /= num_of_partitions;
+  }
+  string text;
+  for (int p = 0; p < NUM_OF_PRODUCTS; p++) {
+    if (p > 0)
+      text += '/';
+    bool first = true;
+    for (int part : partitions().list[indices[p]]) {
+      for (int copy = 0; copy < 2; copy++) {
+        text += (first ? "" : ",") + to_string(part);
+        first = false;
+      }
+    }
+  }
+  return text;
+}
+
+/**************************** Building ****************************/
+
+int build_catalogue(char * index_file, char * rf_file, Reflector const& rf, char** rot_files, vector<Rotor> const& rotor_set, 
+  int num_of_rotors, int num_of_threads, CatalogueStats& stats) {
+  auto start_time = chrono::steady_clock::now();
+  vector<vector<int>> orders;
+  rotor_orders(rotor_set.size(), num_of_rotors, orders);
+  long long positions = 1;
+  for (int i = 0; i < num_of_rotors; i++)
+    positions *= TOTAL_ALPHABET_COUNT;
+  long long num_of_settings = (long long) orders.size() * positions;
+  if (orders.empty() || num_of_settings > (long long) UINT32_MAX) {
+    cerr << "Too many settings for a catalogue (" << num_of_settings << ")\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  // one task per rotor order and starting position of the leftmost rotor; 
+  // every setting has its own entry, so the workers never share a slot
+  vector<CatalogueEntry> entries(num_of_settings);
+  long long positions_per_task = positions / TOTAL_ALPHABET_COUNT;
+  WorkStealingPool pool(num_of_threads);
+  pool.run((long long) orders.size() * TOTAL_ALPHABET_COUNT, [&](long long task, int) {
+    uint32_t setting = task * positions_per_task;
+    for_each_setting(rotor_set, orders[task / TOTAL_ALPHABET_COUNT], task % TOTAL_ALPHABET_COUNT, 0,
+      [&](Rotor** rotors_ptr, vector<int> const& starting_pos) {
+        entries[setting].signature = cycle_signature(rf, rotors_ptr, num_of_rotors, starting_pos.data());
+        entries[setting].setting = setting;
+        setting++;
+      });
+  });
+
+  sort(entries.begin(), entries.end(), [](CatalogueEntry const& a, CatalogueEntry const& b) {
+    return a.signature != b.signature ? a.signature < b.signature : a.setting < b.setting;
+  });
+  stats.settings = num_of_settings;
+  stats.signatures = 0;
+  for (size_t i = 0; i < entries.size(); i++)
+    if (i == 0 || entries[i].signature != entries[i - 1].signature)
+      stats.signatures++;
+
+  string names = string(rf_file) + '\0';
+  for (size_t i = 0; i < rotor_set.size(); i++)
+    names += string(rot_files[i]) + '\0';
+  names.resize((names.size() + 7) / 8 * 8, '\0');
+
+  CatalogueHeader header = {};
+  memcpy(header.magic, CATALOGUE_MAGIC, sizeof(header.magic));
+  header.version = CATALOGUE_VERSION;
+  header.num_of_rotors = num_of_rotors;
+  header.num_of_rotor_files = rotor_set.size();
+  header.num_of_entries = entries.size();
+  header.names_size = names.size();
+
+  ofstream out(index_file, ios::binary | ios::trunc);
+  if (!out) {
+    cerr << "Error opening catalogue file " << index_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  out.write((char const*) &header, sizeof(header));
+  out.write(names.data(), names.size());
+  out.write((char const*) entries.data(), entries.size() * sizeof(CatalogueEntry));
+  out.close();
+  if (!out) {
+    cerr << "Error writing catalogue file " << index_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+  return NO_ERROR;
+}
+
+/**************************** Catalogue ****************************/
+
+Catalogue::~Catalogue () {
+  if (mapped)
+    munmap(mapped, size);
+}
+
+int Catalogue::open(char * index_file) {
+  int fd = ::open(index_file, O_RDONLY);
+  struct stat file_stat;
+  if (fd < 0 || fstat(fd, &file_stat) != 0) {
+    cerr << "Error opening catalogue file " << index_file << endl;
+    if (fd >= 0)
+      close(fd);
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  size = file_stat.st_size;
+  mapped = size >= sizeof(CatalogueHeader) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    mapped = NULL;
+    cerr << "Invalid catalogue file " << index_file << " (too short)\n";
+    return INVALID_INDEX_FILE;
+  }
+
+  header = (CatalogueHeader const*) mapped;
+  char const* names_start = (char const*) mapped + sizeof(CatalogueHeader);
+  int res = check_file_header(header->magic, header->version, CATALOGUE_MAGIC, CATALOGUE_VERSION, "catalogue file", index_file, INVALID_INDEX_FILE);
+  if (res != NO_ERROR)
+    return res;
+  if (header->names_size % 8 != 0 || sizeof(CatalogueHeader) + header->names_size > size
+      || (size - sizeof(CatalogueHeader) - header->names_size) / sizeof(CatalogueEntry) != header->num_of_entries
+      || (size - sizeof(CatalogueHeader) - header->names_size) % sizeof(CatalogueEntry) != 0) {
+    cerr << "Invalid catalogue file " << index_file << " (bad header)\n";
+    return INVALID_INDEX_FILE;
+  }
+  names.clear();
+  for (char const* name = names_start; name < names_start + header->names_size && *name; name += strlen(name) + 1)
+    names.push_back(name);
+  if (names.size() != header->num_of_rotor_files + 1) {
+    cerr << "Invalid catalogue file " << index_file << " (bad file names)\n";
+    return INVALID_INDEX_FILE;
+  }
+  entries = (CatalogueEntry const*) (names_start + header->names_size);
+  rotor_orders(header->num_of_rotor_files, header->num_of_rotors, orders);
+  return NO_ERROR;
+}
+
+CatalogueEntry const* Catalogue::find(uint32_t signature, size_t& count) const {
+  auto by_signature = [](CatalogueEntry const& a, CatalogueEntry const& b) { return a.signature < b.signature; };
+  CatalogueEntry key = {signature, 0};
+  auto range = equal_range(entries, entries + header->num_of_entries, key, by_signature);
+  count = range.second - range.first;
+  return range.first;
+}
+
+void Catalogue::decode(uint32_t setting, vector<string>& rotor_files, vector<int>& starting_pos) const {
+  int num_of_rotors = header->num_of_rotors;
+  starting_pos.assign(num_of_rotors, 0);
+  for (int i = num_of_rotors - 1; i >= 0; i--) {
+    starting_pos[i] = setting % TOTAL_ALPHABET_COUNT;
+    setting /= TOTAL_ALPHABET_COUNT;
+  }
+  rotor_files.clear();
+  for (int r : orders[setting])
+    rotor_files.push_back(names[r + 1]);
+}
+
+string const& Catalogue::get_reflector_file() const {
+  return names[0];
+}
+
+uint64_t Catalogue::get_num_of_entries() const {
+  return header->num_of_entries;
+}
+
+/**************************** Subcommand ****************************/
+
+/* This function reads doubled indicators (6 letters each) and computes the signature of their products */
+static int indicators_signature(istream& in, uint32_t& signature) {
+  vector<int> letters;
+  char error_input;
+  int res = read_letters(in, letters, error_input);
+  if (res != NO_ERROR) {
+    cerr << error_input << " is not a valid input character "
+      << "(input characters must be upper case letters A-Z)!\n";
+    return res;
+  }
+  if (letters.empty() || letters.size() % (2 * NUM_OF_PRODUCTS) != 0) {
+    cerr << "The indicators must be groups of " << 2 * NUM_OF_PRODUCTS << " letters\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  // letter i and letter i + 3 of an indicator are linked by product i
+  int products[NUM_OF_PRODUCTS][TOTAL_ALPHABET_COUNT];
+  for (int p = 0; p < NUM_OF_PRODUCTS; p++)
+    fill(products[p], products[p] + TOTAL_ALPHABET_COUNT, -1);
+  for (size_t g = 0; g < letters.size(); g += 2 * NUM_OF_PRODUCTS) {
+    for (int p = 0; p < NUM_OF_PRODUCTS; p++) {
+      int from = letters[g + p], to = letters[g + p + NUM_OF_PRODUCTS];
+      if (products[p][from] >= 0 && products[p][from] != to) {
+        cerr << "Inconsistent indicators: product " << p + 1 << " maps " << char('A' + from) << " to both "
+          << char('A' + products[p][from]) << " and " << char('A' + to) << endl;
+        return INVALID_INPUT_CHARACTER;
+      }
+      products[p][from] = to;
+    }
+  }
+  for (int p = 0; p < NUM_OF_PRODUCTS; p++) {
+    string missing;
+    for (int x = 0; x < TOTAL_ALPHABET_COUNT; x++)
+      if (products[p][x] < 0)
+        missing += 'A' + x;
+    if (!missing.empty()) {
+      cerr << "Not enough indicators: product " << p + 1 << " is unknown for " << missing << endl;
+      return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+    }
+  }
+  if (!products_signature(products, signature)) {
+    cerr << "The indicators do not give products of two involutions\n";
+    return INVALID_INPUT_CHARACTER;
+  }
+  return NO_ERROR;
+}
+
+static int catalogue_usage() {
+  cerr << "usage: enigma catalogue build [--threads N] index-file reflector-file num-of-rotors (<rotor-file>)+\n"
+    << "       enigma catalogue query index-file SIGNATURE (e.g. 13,13/10,10,2,2,1,1/7,7,6,6)\n"
+    << "       enigma catalogue signature plugboard-file reflector-file (<rotor-file>)* rotor-positions\n"
+    << "       enigma catalogue indicators < doubled-indicators\n";
+  return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+}
+
+int catalogue_command(int argc, char** argv) {
+  // skip "catalogue": argv[0] is the action
+  argv++;
+  argc--;
+  if (argc < 1)
+    return catalogue_usage();
+  int res = NO_ERROR;
+
+  if (strcmp(argv[0], "build") == 0) {
+    int num_of_threads = 0;
+    if (argc > 2 && strcmp(argv[1], "--threads") == 0) {
+      num_of_threads = atoi(argv[2]);
+      argv += 2;
+      argc -= 2;
+    }
+    int num_of_rotors = argc >= 5 ? atoi(argv[3]) : 0;
+    int num_of_rotor_files = argc - 4;
+    if (argc < 5 || num_of_rotors < 1 || num_of_rotors > num_of_rotor_files)
+      return catalogue_usage();
+    Reflector rf(argv[2]);
+    if ((res = rf.setup()) != NO_ERROR)
+      return res;
+    char** rot_files = argv + 4;
+    vector<Rotor> rotor_set;
+    for (int i = 0; i < num_of_rotor_files; i++) {
+      rotor_set.push_back(Rotor(rot_files[i]));
+      if ((res = rotor_set.back().setup()) != NO_ERROR)
+        return res;
+    }
+    CatalogueStats stats;
+    res = build_catalogue(argv[1], argv[2], rf, rot_files, rotor_set, num_of_rotors, num_of_threads, stats);
+    if (res == NO_ERROR)
+      cerr << "catalogued " << stats.settings << " settings (" << stats.signatures << " signatures) in "
+        << stats.seconds << " s (" << stats.settings / stats.seconds << " settings/s)\n";
+    return res;
+  }
+
+  if (strcmp(argv[0], "query") == 0) {
+    uint32_t signature;
+    if (argc != 3)
+      return catalogue_usage();
+    if (!parse_signature(argv[2], signature)) {
+      cerr << "Invalid signature " << argv[2] << " (cycle lengths in pairs, adding up to 26, for each of 3 products)\n";
+      return INVALID_INPUT_CHARACTER;
+    }
+    auto start_time = chrono::steady_clock::now();
+    Catalogue catalogue;
+    if ((res = catalogue.open(argv[1])) != NO_ERROR)
+      return res;
+    size_t count;
+    CatalogueEntry const* found = catalogue.find(signature, count);
+    vector<string> rotor_files;
+    vector<int> starting_pos;
+    for (size_t i = 0; i < count; i++) {
+      catalogue.decode(found[i].setting, rotor_files, starting_pos);
+      for (string const& file : rotor_files)
+        cout << file << ' ';
+      cout << "positions:";
+      for (int p : starting_pos)
+        cout << ' ' << p;
+      cout << '\n';
+    }
+    cout.flush();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    cerr << count << " of " << catalogue.get_num_of_entries() << " settings (reflector " << catalogue.get_reflector_file()
+      << ") in " << seconds * 1e3 << " ms\n";
+    return NO_ERROR;
+  }
+
+  if (strcmp(argv[0], "signature") == 0) {
+    Machine machine;
+    if ((res = machine.load(argc, argv)) != NO_ERROR)
+      return res;
+    vector<Rotor const*> rotors;
+    for (int r = 0; r < machine.get_num_of_rotors(); r++)
+      rotors.push_back(&machine.get_rotor(r));
+    cout << format_signature(cycle_signature(machine.get_reflector(), rotors.data(), rotors.size(), machine.get_starting_pos())) << endl;
+    return NO_ERROR;
+  }
+
+  if (strcmp(argv[0], "indicators") == 0) {
+    uint32_t signature;
+    if ((res = indicators_signature(cin, signature)) == NO_ERROR)
+      cout << format_signature(signature) << endl;
+    return res;
+  }
+
+  return catalogue_usage();
+}
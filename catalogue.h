@@ -0,0 +1,130 @@
+#ifndef CATALOGUE_H
+#define CATALOGUE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "enigma.h"
+using namespace std;
+
+/* 
+  Catalogue of cycle structures ("characteristics", after Rejewski): for a rotor order and 
+  starting positions, E1..E6 are the substitutions of the first six letters of a message, and 
+  the characteristic is the cycle lengths of the three products E4E1, E5E2 and E6E3. The 
+  plugboard only conjugates these products, so the characteristic does not depend on it.
+  Each product of two involutions without fixed points has its cycles in pairs of equal length,
+  so a product is a partition of 13 and the characteristic fits in a 32-bit signature.
+
+  Index file format (host byte order, see fileheader.h: the file is mapped as it is):
+  - CatalogueHeader
+  - names: the reflector file then the rotor files, each terminated by '\0', padded to 8 bytes
+  - num_of_entries CatalogueEntry, sorted by signature then setting
+*/
+char const CATALOGUE_MAGIC[4] = {'E', 'N', 'G', 'X'};
+uint32_t const CATALOGUE_VERSION = 1;
+/* Number of products in a characteristic (E4E1, E5E2, E6E3) */
+int const NUM_OF_PRODUCTS = 3;
+
+struct CatalogueHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_of_rotors;
+  uint32_t num_of_rotor_files;
+  uint64_t num_of_entries;
+  uint32_t names_size;
+  uint32_t reserved;
+};
+
+struct CatalogueEntry {
+  uint32_t signature;
+  /* Rotor order (index in rotor_orders) * 26^num_of_rotors + starting positions (base 26, leftmost first) */
+  uint32_t setting;
+};
+
+/* Counters filled in by build_catalogue */
+struct CatalogueStats {
+  long long settings = 0;
+  /* Number of different signatures among the settings */
+  long long signatures = 0;
+  double seconds = 0;
+};
+
+/* 
+  This function computes the signature of a setting
+  - parameters: reflector, rotors (leftmost first, only read), num_of_rotors, starting_pos
+  - returns the signature
+*/
+uint32_t cycle_signature(Reflector const& rf, Rotor const* const rotors[], int num_of_rotors, int const starting_pos[]);
+
+/* 
+  This function computes a signature from the three products
+  - parameters: products (products[i][x] is where the product i maps letter x), signature
+  - returns false if a product is not a permutation whose cycles come in pairs of equal length
+*/
+bool products_signature(int const products[NUM_OF_PRODUCTS][TOTAL_ALPHABET_COUNT], uint32_t& signature);
+
+/* 
+  These functions convert a signature from / to text: the cycle lengths of the three products, 
+  separated by '/', e.g. "13,13/10,10,2,2,1,1/7,7,6,6"
+  - parse_signature returns false if the text is not a valid characteristic
+*/
+bool parse_signature(char const* text, uint32_t& signature);
+string format_signature(uint32_t signature);
+
+/* 
+  This function builds the catalogue of every rotor order and starting positions and writes its index file
+  - parameters: index_file, reflector file and reflector, rotor files and rotor_set (set up from them),
+    num_of_rotors, num_of_threads, stats
+  - the settings are spread over num_of_threads workers with a WorkStealingPool
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int build_catalogue(char * index_file, char * rf_file, Reflector const& rf, char** rot_files, vector<Rotor> const& rotor_set, 
+  int num_of_rotors, int num_of_threads, CatalogueStats& stats);
+
+/* A catalogue index file, memory-mapped for lookups */
+class Catalogue {
+  void* mapped = NULL;
+  size_t size = 0;
+  CatalogueHeader const* header = NULL;
+  vector<string> names;
+  CatalogueEntry const* entries = NULL;
+  vector<vector<int>> orders;
+
+  public:
+    Catalogue () = default;
+    Catalogue (Catalogue const&) = delete;
+    Catalogue& operator= (Catalogue const&) = delete;
+    ~Catalogue ();
+    /* 
+      This function maps and checks an index file
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int open(char * index_file);
+    /* 
+      This function finds the settings with a signature (binary search over the mapped entries)
+      - parameters: signature, count (set to the number of settings found)
+      - returns a pointer to the first of them (in the mapped file)
+    */
+    CatalogueEntry const* find(uint32_t signature, size_t& count) const;
+    /* 
+      This function decodes the setting of an entry
+      - parameters: setting, rotor_files (filled with the rotor file names, leftmost first), starting_pos
+    */
+    void decode(uint32_t setting, vector<string>& rotor_files, vector<int>& starting_pos) const;
+    /* These functions return the reflector file and the number of settings of the catalogue */
+    string const& get_reflector_file() const;
+    uint64_t get_num_of_entries() const;
+};
+
+/* 
+  This function runs the "catalogue" subcommand
+  - usage: enigma catalogue build [--threads N] index-file reflector-file num-of-rotors (<rotor-file>)+
+           enigma catalogue query index-file SIGNATURE
+           enigma catalogue signature plugboard-file reflector-file (<rotor-file>)* rotor-positions
+           enigma catalogue indicators < doubled-indicators (6 letters each)
+  - parameters: argc, argv (argv[0] is "catalogue")
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int catalogue_command(int argc, char** argv);
+
+#endif
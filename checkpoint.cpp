@@ -0,0 +1,182 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "checkpoint.h"
+#include "fileheader.h"
+#include "parallel.h"
+#include "errors.h"
+using namespace std;
+
+static void fnv1a(uint32_t& hash, unsigned char const data[], size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+}
+
+/* This function hashes what a checkpoint does not save: the wiring */
+static uint32_t key_fingerprint(Machine const& machine) {
+  uint32_t hash = 2166136261u;
+  int const TAC = TOTAL_ALPHABET_COUNT;
+  fnv1a(hash, (unsigned char const*) machine.get_plugboard().get_mapping(), TAC * sizeof(int));
+  fnv1a(hash, (unsigned char const*) machine.get_reflector().get_mapping(), TAC * sizeof(int));
+  for (int r = 0; r < machine.get_num_of_rotors(); r++) {
+    Rotor const& rotor = machine.get_rotor(r);
+    unsigned notch_mask = rotor.get_notch_mask();
+    fnv1a(hash, (unsigned char const*) rotor.get_mapping(), TAC * sizeof(int));
+    fnv1a(hash, (unsigned char const*) &notch_mask, sizeof(notch_mask));
+  }
+  return hash;
+}
+
+static uint32_t checkpoint_checksum(MachineCheckpoint const& checkpoint) {
+  uint32_t hash = 2166136261u;
+  fnv1a(hash, (unsigned char const*) &checkpoint, offsetof(MachineCheckpoint, checksum));
+  return hash;
+}
+
+int take_checkpoint(Machine const& machine, StreamStats const& stats, MachineCheckpoint& checkpoint) {
+  int num_of_rotors = machine.get_num_of_rotors();
+  if (num_of_rotors > MAX_CHECKPOINT_ROTORS) {
+    cerr << "Cannot checkpoint a machine with more than " << MAX_CHECKPOINT_ROTORS << " rotors\n";
+    return INVALID_CHECKPOINT;
+  }
+  memset(&checkpoint, 0, sizeof(checkpoint));
+  memcpy(checkpoint.magic, CHECKPOINT_MAGIC, sizeof(checkpoint.magic));
+  checkpoint.version = CHECKPOINT_VERSION;
+  checkpoint.num_of_rotors = num_of_rotors;
+  checkpoint.key_fingerprint = key_fingerprint(machine);
+  checkpoint.position = machine.get_position();
+  checkpoint.bytes_in = stats.bytes_in;
+  checkpoint.letters_out = stats.letters;
+  int offsets[MAX_CHECKPOINT_ROTORS];
+  machine.get_offsets(offsets);
+  for (int i=0; i < num_of_rotors; i++) {
+    checkpoint.offsets[i] = offsets[i];
+    checkpoint.starting_pos[i] = machine.get_starting_pos()[i];
+  }
+  checkpoint.checksum = checkpoint_checksum(checkpoint);
+  return NO_ERROR;
+}
+
+int restore_checkpoint(Machine& machine, MachineCheckpoint const& checkpoint, StreamStats& stats, bool check_starting_pos) {
+  if ((int) checkpoint.num_of_rotors != machine.get_num_of_rotors() || checkpoint.key_fingerprint != key_fingerprint(machine)) {
+    cerr << "The checkpoint was taken with another configuration\n";
+    return INVALID_CHECKPOINT;
+  }
+  int offsets[MAX_CHECKPOINT_ROTORS];
+  vector<int> starting_pos(checkpoint.num_of_rotors);
+  for (uint32_t i=0; i < checkpoint.num_of_rotors; i++) {
+    if (checkpoint.offsets[i] >= TOTAL_ALPHABET_COUNT || checkpoint.starting_pos[i] >= TOTAL_ALPHABET_COUNT) {
+      cerr << "Invalid rotor offset in checkpoint\n";
+      return INVALID_CHECKPOINT;
+    }
+    offsets[i] = checkpoint.offsets[i];
+    starting_pos[i] = checkpoint.starting_pos[i];
+    if (check_starting_pos && starting_pos[i] != machine.get_starting_pos()[i]) {
+      cerr << "The checkpoint was taken with other starting positions\n";
+      return INVALID_CHECKPOINT;
+    }
+  }
+  if (!check_starting_pos) {
+    // the wiring is kept, the rotors are set up again from the checkpoint's starting positions
+    vector<Rotor> rotors;
+    for (uint32_t i=0; i < checkpoint.num_of_rotors; i++)
+      rotors.push_back(machine.get_rotor(i));
+    Plugboard pb = machine.get_plugboard();
+    Reflector rf = machine.get_reflector();
+    machine.load(pb, rf, rotors, starting_pos);
+  }
+  machine.restore(offsets, checkpoint.position);
+  stats.bytes_in = checkpoint.bytes_in;
+  stats.letters = checkpoint.letters_out;
+  return NO_ERROR;
+}
+
+int write_checkpoint(char * checkpoint_file, MachineCheckpoint const& checkpoint) {
+  string temporary = string(checkpoint_file) + ".tmp";
+  ofstream out(temporary, ios::binary | ios::trunc);
+  out.write((char const*) &checkpoint, sizeof(checkpoint));
+  out.close();
+  if (!out || rename(temporary.c_str(), checkpoint_file) != 0) {
+    cerr << "Error writing checkpoint file " << checkpoint_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  return NO_ERROR;
+}
+
+int read_checkpoint(char * checkpoint_file, MachineCheckpoint& checkpoint) {
+  ifstream in(checkpoint_file, ios::binary);
+  if (!in) {
+    cerr << "Error opening checkpoint file " << checkpoint_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  if (!in.read((char*) &checkpoint, sizeof(checkpoint)) || in.peek() != char_traits<char>::eof()) {
+    cerr << "Invalid checkpoint file " << checkpoint_file << " (wrong size)\n";
+    return INVALID_CHECKPOINT;
+  }
+  int res = check_file_header(checkpoint.magic, checkpoint.version, CHECKPOINT_MAGIC, CHECKPOINT_VERSION, "checkpoint", checkpoint_file, INVALID_CHECKPOINT);
+  if (res == NO_ERROR && (checkpoint.checksum != checkpoint_checksum(checkpoint) || checkpoint.num_of_rotors > MAX_CHECKPOINT_ROTORS)) {
+    cerr << "Invalid checkpoint file " << checkpoint_file << " (bad checksum)\n";
+    res = INVALID_CHECKPOINT;
+  }
+  return res;
+}
+
+/* This function flushes the output and replaces the checkpoint file with the machine's current state */
+static int save_progress(Machine const& machine, ostream& out, StreamStats const& stats, char * checkpoint_file) {
+  MachineCheckpoint checkpoint;
+  out.flush();
+  if (!out) {
+    cerr << "Error writing the output\n";
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  int res = take_checkpoint(machine, stats, checkpoint);
+  if (res == NO_ERROR)
+    res = write_checkpoint(checkpoint_file, checkpoint);
+  return res;
+}
+
+int encrypt_stream_checkpointed(Machine& machine, istream& in, ostream& out, char& error_input, StreamStats& stats, 
+  int num_of_threads, char * checkpoint_file, long long checkpoint_interval) {
+  // the same blocks as process_stream
+  bool parallel = num_of_threads > 1;
+  long long block_size = parallel ? (long long) PARALLEL_CHUNK_SIZE * num_of_threads : BLOCK_SIZE;
+  vector<char> input(block_size), output(block_size);
+  long long since_checkpoint = 0;
+  int res = NO_ERROR;
+
+  while (res == NO_ERROR && in.read(input.data(), block_size).gcount() > 0) {
+    long long input_length = in.gcount();
+    size_t output_length = 0;
+    stats.bytes_in += input_length;
+    if (parallel)
+      res = machine.encrypt_parallel(input.data(), input_length, output.data(), output_length, error_input, num_of_threads);
+    else
+      res = machine.encrypt(input.data(), input_length, output.data(), output_length, error_input);
+
+    // letters before an invalid character are still written out, but not checkpointed
+    out.write(output.data(), output_length);
+    stats.letters += output_length;
+    if (res != NO_ERROR)
+      break;
+
+    // once the input turns out to be longer than one block, the machine is compiled
+    if (input_length == block_size)
+      machine.compile();
+
+    since_checkpoint += input_length;
+    if (since_checkpoint >= checkpoint_interval) {
+      res = save_progress(machine, out, stats, checkpoint_file);
+      since_checkpoint = 0;
+    }
+  }
+
+  if (res == NO_ERROR)
+    res = save_progress(machine, out, stats, checkpoint_file);
+  out.flush();
+  return res;
+}
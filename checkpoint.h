@@ -0,0 +1,80 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <iostream>
+#include "machine.h"
+using namespace std;
+
+char const CHECKPOINT_MAGIC[4] = {'E', 'N', 'G', 'C'};
+uint32_t const CHECKPOINT_VERSION = 2;
+/* Checkpoints have a fixed size, so the number of rotors they can hold is bounded */
+int const MAX_CHECKPOINT_ROTORS = 32;
+/* Default number of input bytes between two checkpoints of a stream */
+long long const DEFAULT_CHECKPOINT_INTERVAL = 64LL << 20;
+
+/* 
+  The complete mutable state of a machine part way through a stream (host byte order, see fileheader.h).
+  The wiring is not saved: the configuration is loaded as usual and key_fingerprint checks that it 
+  is the one the checkpoint was taken with. The starting positions are saved, so that a stream can be
+  resumed without its rotor position file.
+*/
+struct MachineCheckpoint {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_of_rotors;
+  /* 32-bit FNV-1a of the wiring of the machine */
+  uint32_t key_fingerprint;
+  /* Machine position (letters since the starting positions) */
+  uint64_t position;
+  /* Input bytes consumed and letters written out by the stream up to the checkpoint */
+  uint64_t bytes_in;
+  uint64_t letters_out;
+  /* Rotor offsets, leftmost first (unused entries are 0) */
+  uint8_t offsets[MAX_CHECKPOINT_ROTORS];
+  /* Starting positions of the rotors, leftmost first (unused entries are 0) */
+  uint8_t starting_pos[MAX_CHECKPOINT_ROTORS];
+  /* 32-bit FNV-1a of everything above */
+  uint32_t checksum;
+};
+
+/* 
+  This function takes a checkpoint of a machine
+  - parameters: machine, stream stats (bytes_in and letters of the stream so far), checkpoint
+  - returns an integer: 0 if NO _ERROR, INVALID_CHECKPOINT if the machine has too many rotors
+*/
+int take_checkpoint(Machine const& machine, StreamStats const& stats, MachineCheckpoint& checkpoint);
+
+/* 
+  This function restores a machine from a checkpoint (O(1), see Machine::restore)
+  - parameters: machine (with the wiring the checkpoint was taken with), checkpoint, stream stats,
+    check_starting_pos (true if the machine was loaded with starting positions, which must then be
+    those of the checkpoint; false to take the checkpoint's)
+  - stats are set to the stream's counters at the checkpoint
+  - returns an integer: 0 if NO _ERROR, INVALID_CHECKPOINT if it is corrupt or from another configuration
+*/
+int restore_checkpoint(Machine& machine, MachineCheckpoint const& checkpoint, StreamStats& stats, bool check_starting_pos);
+
+/* 
+  These functions write / read a checkpoint file
+  - the file is written next to its final name and renamed over it, so a crash leaves either the
+    previous checkpoint or the new one, never a partial one
+  - the header and checksum are checked on reading, so num_of_rotors can be used before restore_checkpoint
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int write_checkpoint(char * checkpoint_file, MachineCheckpoint const& checkpoint);
+int read_checkpoint(char * checkpoint_file, MachineCheckpoint& checkpoint);
+
+/* 
+  This function encodes / decodes a whole stream from the current position, writing a checkpoint 
+  every checkpoint_interval input bytes and at the end of the stream
+  - parameters: machine, input and output streams, error_input, stats, num_of_threads, checkpoint_file, checkpoint_interval
+  - the output is flushed before each checkpoint, so everything the checkpoint counts has been written;
+    to resume, skip stats.bytes_in of the input and keep stats.letters of the output
+  - stats must hold the counters the stream starts from (0, or those of restore_checkpoint)
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int encrypt_stream_checkpointed(Machine& machine, istream& in, ostream& out, char& error_input, StreamStats& stats, 
+  int num_of_threads, char * checkpoint_file, long long checkpoint_interval);
+
+#endif
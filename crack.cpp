@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include "crack.h"
+#include "keystream.h"
+#include "scheduler.h"
+#include "search.h"
+#include "errors.h"
+using namespace std;
+
+double index_of_coincidence(int const letters[], int length) {
+  if (length < 2)
+    return 0;
+  long long counts[TOTAL_ALPHABET_COUNT] = {};
+  for (int i = 0; i < length; i++)
+    counts[letters[i]]++;
+  long long sum = 0;
+  for (int c = 0; c < TOTAL_ALPHABET_COUNT; c++)
+    sum += counts[c] * (counts[c] - 1);
+  return (double) sum / ((double) length * (length - 1));
+}
+
+// orders settings best first
+static bool better(CrackCandidate const& a, CrackCandidate const& b) {
+  return a.score > b.score;
+}
+
+/* 
+  Decrypts a ciphertext under one rotor setting for any plugboard: the rotors and 
+  reflector are compiled once into a table of substitutions without plugboard, so 
+  a plugboard costs two lookups per letter.
+*/
+class PlugboardScorer {
+  Keystream scrambler;
+  int const* ciphertext;
+  int length;
+  vector<int> plaintext;
+  NgramTable const* ngrams;
+
+  public:
+    PlugboardScorer (Reflector& rf, int num_of_rotors, Rotor** rotors_ptr, int const ciphertext[], int length, NgramTable const* ngrams = NULL) 
+      : ciphertext(ciphertext), length(length), plaintext(length), ngrams(ngrams) {
+      Plugboard no_cables(NULL);
+      scrambler.compile_steps(no_cables, rf, num_of_rotors, rotors_ptr, length);
+    }
+
+    int const* decrypt(int const pb_map[]) {
+      for (int t = 0; t < length; t++)
+        plaintext[t] = pb_map[scrambler.substitution(t)[pb_map[ciphertext[t]]]];
+      return plaintext.data();
+    }
+
+    double score(int const pb_map[]) {
+      // the plaintext is scored as letter codes, where it was decrypted
+      if (ngrams)
+        return ngrams->score(decrypt(pb_map), length);
+      return index_of_coincidence(decrypt(pb_map), length);
+    }
+};
+
+// connects a and b, first disconnecting whatever they were connected to
+static void connect(int pb_map[], int a, int b) {
+  if (pb_map[a] != a)
+    pb_map[pb_map[a]] = pb_map[a];
+  if (pb_map[b] != b)
+    pb_map[pb_map[b]] = pb_map[b];
+  pb_map[a] = b;
+  pb_map[b] = a;
+}
+
+static int count_pairs(int const pb_map[]) {
+  int pairs = 0;
+  for (int i = 0; i < TOTAL_ALPHABET_COUNT; i++)
+    pairs += pb_map[i] > i;
+  return pairs;
+}
+
+// climbs from pb_map to a local maximum, connecting or disconnecting one pair at a time
+static double hill_climb(PlugboardScorer& scorer, int pb_map[], int max_pairs, long long& evaluations) {
+  int const TAC = TOTAL_ALPHABET_COUNT;
+  double score = scorer.score(pb_map);
+  evaluations++;
+  bool improved = true;
+  int trial[TAC];
+  while (improved) {
+    improved = false;
+    for (int a = 0; a < TAC; a++) {
+      for (int b = a + 1; b < TAC; b++) {
+        copy(pb_map, pb_map + TAC, trial);
+        if (trial[a] == b) {
+          trial[a] = a;
+          trial[b] = b;
+        } else {
+          connect(trial, a, b);
+          if (count_pairs(trial) > max_pairs)
+            continue;
+        }
+        double trial_score = scorer.score(trial);
+        evaluations++;
+        if (trial_score > score + 1e-12) {
+          copy(trial, trial + TAC, pb_map);
+          score = trial_score;
+          improved = true;
+        }
+      }
+    }
+  }
+  return score;
+}
+
+void crack(Reflector& rf, vector<Rotor> const& rotor_set, int num_of_rotors, int const ciphertext[], int length, CrackOptions const& options, vector<CrackCandidate>& best, CrackStats& stats) {
+  int const TAC = TOTAL_ALPHABET_COUNT;
+  vector<vector<int>> orders;
+  rotor_orders(rotor_set.size(), num_of_rotors, orders);
+
+  WorkStealingPool pool(options.num_of_threads);
+  int num_of_workers = pool.get_num_of_workers();
+  size_t num_of_candidates = max(1, options.num_of_candidates);
+
+  // first stage: index of coincidence of every rotor setting without plugboard
+  auto start_time = chrono::steady_clock::now();
+  vector<vector<CrackCandidate>> worker_best(num_of_workers);
+  vector<long long> worker_count(num_of_workers, 0);
+  pool.run((long long) orders.size() * TAC, [&](long long task, int worker) {
+    vector<int> const& order = orders[task / TAC];
+    Plugboard no_cables(NULL);
+    vector<CrackCandidate>& kept = worker_best[worker];
+
+    CrackCandidate candidate;
+    candidate.rotor_order = order;
+    for (int i = 0; i < TAC; i++)
+      candidate.pb_map[i] = i;
+
+    worker_count[worker] += for_each_setting(rotor_set, order, task % TAC, 0, [&](Rotor** rotors_ptr, vector<int> const& starting_pos) {
+      long long counts[TAC] = {};
+      for (int t = 0; t < length; t++) {
+        int letter = ciphertext[t];
+        process_letter(letter, num_of_rotors, no_cables, rotors_ptr, rf);
+        counts[letter]++;
+      }
+      long long sum = 0;
+      for (int c = 0; c < TAC; c++)
+        sum += counts[c] * (counts[c] - 1);
+      candidate.starting_pos = starting_pos;
+      candidate.score = length > 1 ? (double) sum / ((double) length * (length - 1)) : 0;
+
+      // kept is a min-heap of the worker's best settings
+      if (kept.size() < num_of_candidates || candidate.score > kept.front().score) {
+        kept.push_back(candidate);
+        push_heap(kept.begin(), kept.end(), better);
+        if (kept.size() > num_of_candidates) {
+          pop_heap(kept.begin(), kept.end(), better);
+          kept.pop_back();
+        }
+      }
+    });
+  });
+
+  vector<CrackCandidate> settings;
+  stats.settings = 0;
+  for (int w = 0; w < num_of_workers; w++) {
+    settings.insert(settings.end(), worker_best[w].begin(), worker_best[w].end());
+    stats.settings += worker_count[w];
+  }
+  sort(settings.begin(), settings.end(), better);
+  if (settings.size() > num_of_candidates)
+    settings.resize(num_of_candidates);
+  auto first_stage_end = chrono::steady_clock::now();
+  stats.first_stage_seconds = chrono::duration<double>(first_stage_end - start_time).count();
+
+  // second stage: hill-climb the plugboard of every kept setting from several starts
+  int num_of_restarts = max(1, options.num_of_restarts);
+  vector<CrackCandidate> results(settings.size() * num_of_restarts);
+  vector<long long> worker_evaluations(num_of_workers, 0);
+  pool.run(results.size(), [&](long long task, int worker) {
+    CrackCandidate& result = results[task];
+    result = settings[task / num_of_restarts];
+    int restart = task % num_of_restarts;
+
+    vector<Rotor> rotors;
+    vector<Rotor*> rotors_ptr;
+    rotors.reserve(num_of_rotors);
+    for (int i = 0; i < num_of_rotors; i++) {
+      rotors.push_back(rotor_set[result.rotor_order[i]]);
+      rotors_ptr.push_back(&rotors[i]);
+    }
+    seek_rotors(num_of_rotors, rotors_ptr.data(), result.starting_pos.data(), 0);
+    PlugboardScorer scorer(rf, num_of_rotors, rotors_ptr.data(), ciphertext, length, options.ngrams);
+
+    // restart 0 climbs from no cables, the others from a few random ones
+    mt19937 random(task + 1);
+    int initial_pairs = restart == 0 ? 0 : random() % (options.max_pairs / 2 + 1);
+    for (int i = 0; i < initial_pairs; i++) {
+      int a = random() % TAC, b = random() % TAC;
+      if (a != b)
+        connect(result.pb_map, a, b);
+    }
+    result.score = hill_climb(scorer, result.pb_map, options.max_pairs, worker_evaluations[worker]);
+  });
+
+  // best restart of every setting
+  best.clear();
+  for (size_t s = 0; s < settings.size(); s++) {
+    auto first = results.begin() + s * num_of_restarts;
+    best.push_back(*max_element(first, first + num_of_restarts, [](CrackCandidate const& a, CrackCandidate const& b) {
+      return a.score < b.score;
+    }));
+  }
+  sort(best.begin(), best.end(), better);
+
+  stats.plugboards = 0;
+  for (long long evaluations : worker_evaluations)
+    stats.plugboards += evaluations;
+  stats.second_stage_seconds = chrono::duration<double>(chrono::steady_clock::now() - first_stage_end).count();
+}
+
+int crack_command(int argc, char** argv) {
+  CrackOptions options;
+  NgramTable ngrams;
+  char * ngrams_file = NULL;
+  bool options_ok = true;
+  // skip "crack", then the options
+  argv++;
+  argc--;
+  while (argc > 1 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--threads") == 0)
+      options.num_of_threads = atoi(argv[1]);
+    else if (strcmp(argv[0], "--candidates") == 0)
+      options.num_of_candidates = atoi(argv[1]);
+    else if (strcmp(argv[0], "--restarts") == 0)
+      options.num_of_restarts = atoi(argv[1]);
+    else if (strcmp(argv[0], "--max-pairs") == 0)
+      options.max_pairs = atoi(argv[1]);
+    else if (strcmp(argv[0], "--ngrams") == 0)
+      ngrams_file = argv[1];
+    else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+
+  int const min_parameters = 3;
+  int num_of_rotors = argc >= min_parameters ? atoi(argv[1]) : 0;
+  int num_of_rotor_files = argc - 2;
+  if (!options_ok || argc < min_parameters || num_of_rotors < 1 || num_of_rotors > num_of_rotor_files 
+      || options.max_pairs < 0 || options.max_pairs > TOTAL_ALPHABET_COUNT / 2) {
+    cerr << "usage: enigma crack [--threads N] [--candidates K] [--restarts R] [--max-pairs P] [--ngrams table-file] reflector-file num-of-rotors (<rotor-file>)+ < ciphertext\n"
+      << "(num-of-rotors must be between 1 and the number of rotor files, P between 0 and 13)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  Reflector rf(argv[0]);
+  int res = rf.setup();
+  if (res != NO_ERROR)
+    return res;
+  if (ngrams_file) {
+    if ((res = ngrams.load(ngrams_file)) != NO_ERROR)
+      return res;
+    options.ngrams = &ngrams;
+  }
+  char** rot_files = argv + 2;
+  vector<Rotor> rotor_set;
+  for (int i = 0; i < num_of_rotor_files; i++) {
+    rotor_set.push_back(Rotor(rot_files[i]));
+    if ((res = rotor_set.back().setup()) != NO_ERROR)
+      return res;
+  }
+
+  vector<int> ciphertext;
+  char error_input;
+  ios::sync_with_stdio(false);
+  if ((res = read_letters(cin, ciphertext, error_input)) != NO_ERROR) {
+    cerr << error_input << " is not a valid input character "
+      << "(input characters must be upper case letters A-Z)!\n";
+    return res;
+  }
+
+  vector<CrackCandidate> best;
+  CrackStats stats;
+  crack(rf, rotor_set, num_of_rotors, ciphertext.data(), ciphertext.size(), options, best, stats);
+
+  for (CrackCandidate const& candidate : best) {
+    cout << "rotors:";
+    for (int r : candidate.rotor_order)
+      cout << ' ' << rot_files[r];
+    cout << "\npositions:";
+    for (int p : candidate.starting_pos)
+      cout << ' ' << p;
+    cout << "\nplugboard:";
+    for (int i = 0; i < TOTAL_ALPHABET_COUNT; i++) {
+      if (candidate.pb_map[i] > i)
+        cout << ' ' << i << ' ' << candidate.pb_map[i];
+    }
+    cout << "\nscore: " << candidate.score << "\nplaintext: ";
+
+    vector<Rotor> rotors;
+    vector<Rotor*> rotors_ptr;
+    rotors.reserve(num_of_rotors);
+    for (int i = 0; i < num_of_rotors; i++) {
+      rotors.push_back(rotor_set[candidate.rotor_order[i]]);
+      rotors_ptr.push_back(&rotors[i]);
+    }
+    seek_rotors(num_of_rotors, rotors_ptr.data(), candidate.starting_pos.data(), 0);
+    PlugboardScorer scorer(rf, num_of_rotors, rotors_ptr.data(), ciphertext.data(), ciphertext.size());
+    int const* plaintext = scorer.decrypt(candidate.pb_map);
+    for (size_t t = 0; t < ciphertext.size(); t++)
+      cout << (char) (plaintext[t] + 'A');
+    cout << "\n\n";
+  }
+  cout.flush();
+
+  cerr << "first stage: " << stats.settings << " settings in " << stats.first_stage_seconds << " s ("
+    << (stats.first_stage_seconds > 0 ? stats.settings / stats.first_stage_seconds : 0) << " settings/s)\n"
+    << "second stage: " << stats.plugboards << " plugboards in " << stats.second_stage_seconds << " s ("
+    << (stats.second_stage_seconds > 0 ? stats.plugboards / stats.second_stage_seconds : 0) << " plugboards/s)\n";
+  return NO_ERROR;
+}
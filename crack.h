@@ -0,0 +1,79 @@
+#ifndef CRACK_H
+#define CRACK_H
+
+#include <vector>
+#include "enigma.h"
+#include "ngram.h"
+using namespace std;
+
+/* Number of rotor settings kept from the first stage unless specified otherwise */
+int const DEFAULT_CRACK_CANDIDATES = 8;
+/* Number of hill-climbing restarts per setting unless specified otherwise */
+int const DEFAULT_CRACK_RESTARTS = 16;
+/* Maximum number of plugboard cables unless specified otherwise */
+int const DEFAULT_CRACK_MAX_PAIRS = 10;
+
+/* A rotor setting and plugboard found by crack */
+struct CrackCandidate {
+  /* Indices into the rotor set, leftmost rotor first */
+  vector<int> rotor_order;
+  /* Starting position of each rotor, leftmost rotor first */
+  vector<int> starting_pos;
+  /* Plugboard as a lookup table (pb_map[i] is the letter i is connected to) */
+  int pb_map[TOTAL_ALPHABET_COUNT];
+  /* Fitness of the decryption (higher is better) */
+  double score = 0;
+};
+
+/* Settings of a ciphertext-only attack */
+struct CrackOptions {
+  int num_of_threads = 0;
+  /* Number of best rotor settings passed from the first to the second stage */
+  int num_of_candidates = DEFAULT_CRACK_CANDIDATES;
+  /* Number of hill-climbing runs (from different random plugboards) per setting */
+  int num_of_restarts = DEFAULT_CRACK_RESTARTS;
+  /* Maximum number of plugboard cables tried */
+  int max_pairs = DEFAULT_CRACK_MAX_PAIRS;
+  /* n-gram table scoring the second stage (the index of coincidence if NULL) */
+  NgramTable const* ngrams = NULL;
+};
+
+/* Counters filled in by crack */
+struct CrackStats {
+  /* Number of rotor settings scored in the first stage */
+  long long settings = 0;
+  /* Number of plugboards scored in the second stage */
+  long long plugboards = 0;
+  double first_stage_seconds = 0, second_stage_seconds = 0;
+};
+
+/* 
+  This function returns the index of coincidence of a text
+  - parameters: letters (0-25), length
+*/
+double index_of_coincidence(int const letters[], int length);
+
+/* 
+  This function recovers rotor order, starting positions and plugboard from a ciphertext alone
+  - parameters: reflector, rotor_set (rotors set up once from their files), num_of_rotors, 
+    ciphertext (letters 0-25), length, options, best, stats
+  - first stage: every rotor order and starting position is scored by the index of coincidence 
+    of its decryption without plugboard; the best options.num_of_candidates are kept
+  - second stage: for each kept setting, plugboard pairings are hill-climbed from 
+    options.num_of_restarts random starts to maximise the index of coincidence (or the n-gram fitness
+    of the decryption if options.ngrams is set)
+  - both stages run on a WorkStealingPool; no Plugboard or Rotor is constructed per candidate
+  - best is filled with the best result of each kept setting, best first
+*/
+void crack(Reflector& rf, vector<Rotor> const& rotor_set, int num_of_rotors, int const ciphertext[], int length, CrackOptions const& options, vector<CrackCandidate>& best, CrackStats& stats);
+
+/* 
+  This function runs the "crack" subcommand
+  - usage: enigma crack [--threads N] [--candidates K] [--restarts R] [--max-pairs P] [--ngrams table-file] reflector-file num-of-rotors (<rotor-file>)+ < ciphertext
+  - parameters: argc, argv (argv[0] is "crack")
+  - prints the best settings (the plugboard in the plugboard file format) and decryption to stdout, the rates to stderr
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int crack_command(int argc, char** argv);
+
+#endif
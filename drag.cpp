@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "drag.h"
+#include "search.h"
+#include "scheduler.h"
+#include "errors.h"
+using namespace std;
+
+/**************************** CribAutomaton ****************************/
+
+int CribAutomaton::build(vector<string> const& new_words) {
+  int const TAC = TOTAL_ALPHABET_COUNT;
+  for (string const& w : new_words) {
+    bool valid = !w.empty();
+    for (char ch : w)
+      valid = valid && ch >= 'A' && ch <= 'Z';
+    if (!valid) {
+      cerr << "Invalid word \"" << w << "\" (words must be upper case letters A-Z)\n";
+      return INVALID_WORD_LIST;
+    }
+  }
+
+  // the trie of the words, -1 for the letters that lead nowhere yet
+  transitions.assign(TAC, -1);
+  word.assign(1, -1);
+  words.clear();
+  for (string const& w : new_words) {
+    int state = 0;
+    for (char ch : w) {
+      int& child = transitions[state * TAC + (ch - 'A')];
+      if (child < 0) {
+        child = word.size();
+        transitions.resize(transitions.size() + TAC, -1);
+        word.push_back(-1);
+      }
+      state = transitions[state * TAC + (ch - 'A')];
+    }
+    if (word[state] < 0) {
+      word[state] = words.size();
+      words.push_back(w);
+    }
+  }
+
+  // breadth first, so that the failure state of a state (a shorter suffix) is complete before it:
+  // the letters that lead nowhere take the transition of the failure state instead
+  int num_of_states = word.size();
+  vector<int> failure(num_of_states, 0), queue;
+  word_link.assign(num_of_states, -1);
+  first_word.assign(num_of_states, -1);
+  queue.reserve(num_of_states);
+  queue.push_back(0);
+  for (size_t q = 0; q < queue.size(); q++) {
+    int state = queue[q];
+    for (int letter = 0; letter < TAC; letter++) {
+      int& child = transitions[state * TAC + letter];
+      int fallback = state == 0 ? 0 : transitions[failure[state] * TAC + letter];
+      if (child < 0) {
+        child = fallback;
+        continue;
+      }
+      failure[child] = fallback;
+      word_link[child] = word[fallback] >= 0 ? fallback : word_link[fallback];
+      first_word[child] = word[child] >= 0 ? child : word_link[child];
+      queue.push_back(child);
+    }
+  }
+  return NO_ERROR;
+}
+
+int CribAutomaton::read_words(char * words_file, vector<string>& words) {
+  ifstream in(words_file);
+  if (!in) {
+    cerr << "Error opening word list " << words_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  words.clear();
+  string line;
+  for (int line_number = 1; getline(in, line); line_number++) {
+    string w;
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == string::npos || line[first] == '#')
+      continue;
+    for (char ch : line) {
+      if (isspace((unsigned char) ch))
+        continue;
+      ch = toupper(ch);
+      if (ch < 'A' || ch > 'Z') {
+        cerr << "Invalid word \"" << line << "\" in word list " << words_file << " (line " << line_number
+          << ": words must be letters A-Z)\n";
+        return INVALID_WORD_LIST;
+      }
+      w += ch;
+    }
+    words.push_back(w);
+  }
+  if (words.empty()) {
+    cerr << "No word in word list " << words_file << endl;
+    return INVALID_WORD_LIST;
+  }
+  return NO_ERROR;
+}
+
+int CribAutomaton::get_num_of_states() const {
+  return word.size();
+}
+
+int CribAutomaton::get_num_of_words() const {
+  return words.size();
+}
+
+string const& CribAutomaton::get_word(int index) const {
+  return words[index];
+}
+
+/**************************** Dragging ****************************/
+
+// true if a hit of a setting at an offset sorts before hit, so that a hit is only copied if it is kept
+static bool sorts_before(vector<int> const& rotor_order, vector<int> const& starting_pos, long long offset, int word, DragHit const& hit) {
+  if (rotor_order != hit.rotor_order)
+    return rotor_order < hit.rotor_order;
+  if (starting_pos != hit.starting_pos)
+    return starting_pos < hit.starting_pos;
+  return offset != hit.offset ? offset < hit.offset : word < hit.word;
+}
+
+// the order in which hits are sorted (and the first max_hits of them kept)
+static bool earlier(DragHit const& a, DragHit const& b) {
+  return sorts_before(a.rotor_order, a.starting_pos, a.offset, a.word, b);
+}
+
+void crib_drag(Plugboard& pb, Reflector& rf, vector<Rotor> const& rotor_set, int num_of_rotors, int const ciphertext[], int length, CribAutomaton const& automaton, long long max_hits, int num_of_threads, vector<DragHit>& hits, DragStats& stats) {
+  auto start_time = chrono::steady_clock::now();
+  vector<vector<int>> orders;
+  rotor_orders(rotor_set.size(), num_of_rotors, orders);
+
+  WorkStealingPool pool(num_of_threads);
+  int num_of_workers = pool.get_num_of_workers();
+  // each worker keeps its first max_hits hits as a heap, the latest hit on top
+  vector<vector<DragHit>> worker_hits(num_of_workers);
+  vector<DragStats> worker_stats(num_of_workers);
+
+  // one task per rotor order and starting position of the leftmost rotor
+  pool.run((long long) orders.size() * TOTAL_ALPHABET_COUNT, [&](long long task, int worker) {
+    vector<int> const& order = orders[task / TOTAL_ALPHABET_COUNT];
+    DragStats& counts = worker_stats[worker];
+    vector<DragHit>& kept = worker_hits[worker];
+    counts.settings += for_each_setting(rotor_set, order, task % TOTAL_ALPHABET_COUNT, 0, [&](Rotor** rotors_ptr, vector<int> const& starting_pos) {
+      // the decryption is never stored: each letter moves the automaton on as soon as it is out of the machine
+      int state = 0;
+      long long setting_hits = 0;
+      for (int t = 0; t < length; t++) {
+        int letter = ciphertext[t];
+        process_letter(letter, num_of_rotors, pb, rotors_ptr, rf);
+        state = automaton.next(state, letter);
+        for (int match = automaton.match(state); match >= 0; ) {
+          DragHit hit;
+          hit.word = automaton.word_at(match);
+          hit.offset = t + 1 - (long long) automaton.get_word(hit.word).size();
+          setting_hits++;
+          if ((long long) kept.size() >= max_hits
+              && (max_hits == 0 || !sorts_before(order, starting_pos, hit.offset, hit.word, kept.front())))
+            continue;
+          hit.rotor_order = order;
+          hit.starting_pos = starting_pos;
+          kept.push_back(hit);
+          push_heap(kept.begin(), kept.end(), earlier);
+          if ((long long) kept.size() > max_hits) {
+            pop_heap(kept.begin(), kept.end(), earlier);
+            kept.pop_back();
+          }
+        }
+      }
+      counts.hits += setting_hits;
+      counts.settings_with_hits += setting_hits > 0;
+    });
+  });
+
+  hits.clear();
+  stats = DragStats();
+  for (int w = 0; w < num_of_workers; w++) {
+    hits.insert(hits.end(), worker_hits[w].begin(), worker_hits[w].end());
+    stats.settings += worker_stats[w].settings;
+    stats.hits += worker_stats[w].hits;
+    stats.settings_with_hits += worker_stats[w].settings_with_hits;
+  }
+  sort(hits.begin(), hits.end(), earlier);
+  if ((long long) hits.size() > max_hits)
+    hits.resize(max_hits);
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+/**************************** Subcommand ****************************/
+
+int drag_command(int argc, char** argv) {
+  int num_of_threads = 0;
+  long long max_hits = DEFAULT_MAX_DRAG_HITS;
+  bool options_ok = true;
+  // skip "drag", then the options
+  argv++;
+  argc--;
+  while (argc > 1 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--threads") == 0)
+      num_of_threads = atoi(argv[1]);
+    else if (strcmp(argv[0], "--max-hits") == 0 && isdigit(argv[1][0]))
+      max_hits = atoll(argv[1]);
+    else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+
+  int const min_parameters = 5;
+  int num_of_rotors = argc >= min_parameters ? atoi(argv[2]) : 0;
+  int num_of_rotor_files = argc - 4;
+  if (!options_ok || argc < min_parameters || num_of_rotors < 1 || num_of_rotors > num_of_rotor_files) {
+    cerr << "usage: enigma drag [--threads N] [--max-hits H] plugboard-file reflector-file num-of-rotors words-file (<rotor-file>)+ < ciphertext\n"
+      << "(num-of-rotors must be between 1 and the number of rotor files; words-file: one word per line)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  Plugboard pb(argv[0]);
+  int res = pb.setup();
+  if (res != NO_ERROR)
+    return res;
+  Reflector rf(argv[1]);
+  if ((res = rf.setup()) != NO_ERROR)
+    return res;
+
+  // the automaton is built once, whatever the number of settings
+  vector<string> words;
+  CribAutomaton automaton;
+  if ((res = CribAutomaton::read_words(argv[3], words)) != NO_ERROR || (res = automaton.build(words)) != NO_ERROR)
+    return res;
+
+  char** rot_files = argv + 4;
+  vector<Rotor> rotor_set;
+  for (int i = 0; i < num_of_rotor_files; i++) {
+    rotor_set.push_back(Rotor(rot_files[i]));
+    if ((res = rotor_set.back().setup()) != NO_ERROR)
+      return res;
+  }
+
+  vector<int> ciphertext;
+  char error_input;
+  ios::sync_with_stdio(false);
+  if ((res = read_letters(cin, ciphertext, error_input)) != NO_ERROR) {
+    cerr << error_input << " is not a valid input character "
+      << "(input characters must be upper case letters A-Z)!\n";
+    return res;
+  }
+
+  vector<DragHit> hits;
+  DragStats stats;
+  crib_drag(pb, rf, rotor_set, num_of_rotors, ciphertext.data(), ciphertext.size(), automaton, max_hits, num_of_threads, hits, stats);
+
+  for (DragHit const& hit : hits) {
+    for (int r : hit.rotor_order)
+      cout << rot_files[r] << ' ';
+    cout << "positions:";
+    for (int p : hit.starting_pos)
+      cout << ' ' << p;
+    cout << " offset: " << hit.offset << ' ' << automaton.get_word(hit.word) << '\n';
+  }
+  cout.flush();
+
+  // the scan rate: every setting decrypts (and scans) the whole ciphertext
+  double setting_megabytes = stats.settings * (double) ciphertext.size() / 1e6;
+  cerr << "decrypted " << stats.settings << " settings x " << ciphertext.size() << " letters against "
+    << automaton.get_num_of_words() << " words (" << automaton.get_num_of_states() << " states) in " << stats.seconds << " s ("
+    << (stats.seconds > 0 ? setting_megabytes / stats.seconds : 0) << " settings x MB/s, "
+    << (stats.seconds > 0 ? stats.settings / stats.seconds : 0) << " settings/s), "
+    << stats.hits << " hits in " << stats.settings_with_hits << " settings";
+  if (stats.hits > (long long) hits.size())
+    cerr << " (first " << hits.size() << " printed)";
+  cerr << '\n';
+  return NO_ERROR;
+}
@@ -0,0 +1,107 @@
+#ifndef DRAG_H
+#define DRAG_H
+
+#include <string>
+#include <vector>
+#include "enigma.h"
+using namespace std;
+
+/* Number of hits kept (and printed) by crib_drag unless specified otherwise (all are counted) */
+long long const DEFAULT_MAX_DRAG_HITS = 10000;
+
+/*
+  An Aho-Corasick automaton over the 26 letters, built once from a word list so that a text is scanned
+  for all the words at once, one table lookup per letter whatever the number of words.
+  The failure links are folded into the transition table, so that scanning never backtracks.
+*/
+class CribAutomaton {
+  /* next[state * 26 + letter]: the state after reading letter (state 0 is the root) */
+  vector<int> transitions;
+  /* Index of the word ending at each state, -1 if none */
+  vector<int> word;
+  /* Nearest state with a word among the proper suffixes of each state, -1 if none */
+  vector<int> word_link;
+  /* First state with a word among a state and its suffixes, -1 if none: the only test made per letter */
+  vector<int> first_word;
+  vector<string> words;
+
+  public:
+    /*
+      This function builds the automaton
+      - parameters: words (upper case letters A-Z, at least one letter each; duplicates are ignored)
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int build(vector<string> const& words);
+    /*
+      This function reads a word list: one word per line, in upper or lower case (whitespace within a word is
+      dropped, as in Enigma plaintext), empty lines and lines starting with '#' are skipped
+      - parameters: words_file, words
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    static int read_words(char * words_file, vector<string>& words);
+
+    /* This function returns the state after reading letter (0-25) from state */
+    int next(int state, int letter) const {
+      return transitions[state * TOTAL_ALPHABET_COUNT + letter];
+    }
+    /* This function returns the first state with a word among state and its suffixes, -1 if none */
+    int match(int state) const {
+      return first_word[state];
+    }
+    /* This function returns the word ending at a state that match() returned, and moves it to the next one (-1 at the end) */
+    int word_at(int& match_state) const {
+      int index = word[match_state];
+      match_state = word_link[match_state];
+      return index;
+    }
+
+    int get_num_of_states() const;
+    int get_num_of_words() const;
+    string const& get_word(int index) const;
+};
+
+/* A word found in the decryption of a setting by crib_drag */
+struct DragHit {
+  /* Indices into the rotor set, leftmost rotor first */
+  vector<int> rotor_order;
+  /* Starting position of each rotor, leftmost rotor first */
+  vector<int> starting_pos;
+  /* Letter position of the word in the decryption */
+  long long offset = 0;
+  /* Index of the word in the automaton */
+  int word = 0;
+};
+
+/* Counters filled in by crib_drag */
+struct DragStats {
+  /* Number of (rotor order, starting positions) settings decrypted */
+  long long settings = 0;
+  /* Number of hits found (only max_hits of them are kept) */
+  long long hits = 0;
+  /* Number of settings with at least one hit */
+  long long settings_with_hits = 0;
+  /* Wall-clock time of the search */
+  double seconds = 0;
+};
+
+/*
+  This function finds every setting whose decryption of the ciphertext contains any word of an automaton
+  - parameters: plugboard, reflector, rotor_set (rotors set up once from their files), num_of_rotors,
+    ciphertext (letters 0-25), length, automaton, max_hits, num_of_threads, hits, stats
+  - every rotor order is tested with all 26^num_of_rotors starting positions: each setting decrypts the
+    ciphertext once, its letters going straight into the automaton
+  - the work is spread over num_of_threads workers with a WorkStealingPool
+  - hits is filled with the first max_hits hits, sorted by rotor order, starting positions then offset
+*/
+void crib_drag(Plugboard& pb, Reflector& rf, vector<Rotor> const& rotor_set, int num_of_rotors, int const ciphertext[], int length, CribAutomaton const& automaton, long long max_hits, int num_of_threads, vector<DragHit>& hits, DragStats& stats);
+
+/*
+  This function runs the "drag" subcommand
+  - usage: enigma drag [--threads N] [--max-hits H] plugboard-file reflector-file num-of-rotors words-file (<rotor-file>)+ < ciphertext
+  - parameters: argc, argv (argv[0] is "drag")
+  - prints the hits to stdout (rotor files, positions, offset and word) and the scan rate to stderr
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int drag_command(int argc, char** argv);
+
+#endif
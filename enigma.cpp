@@ -1,12 +1,19 @@
 #include <iostream>
 #include <fstream>
+#include <vector>
 #include "enigma.h"
+#include "keystream.h"
+#include "parallel.h"
+#include "instrument.h"
 #include "errors.h"
 using namespace std;
 
 /**************************** Plugboard ****************************/
 
-Plugboard::Plugboard (char * config) : config_file(config) {}
+Plugboard::Plugboard (char * config) : config_file(config) {
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i++)
+    pb_map[i] = i;
+}
 
 int Plugboard::setup() {
   ifstream in(config_file);
@@ -63,21 +70,44 @@ int Plugboard::setup() {
       }
     }
   }
+
+  for (int i=0; i < num_of_parameters; i += 2) {
+    pb_map[pb_config[i]] = pb_config[i+1];
+    pb_map[pb_config[i+1]] = pb_config[i];
+  }
   in.close();
   return NO_ERROR;
 }
 
-void Plugboard::process_input(int& input) {
-  if (num_of_parameters == 0) return;
-  for (int i=0; i < num_of_parameters; i++) {
-    if (pb_config[i] == input) {
-      if (i % 2 == 0)
-        input = pb_config[i+1];
-      else
-        input = pb_config[i-1];
-      return;
+int Plugboard::setup(unsigned char const mapping[]) {
+  num_of_parameters = 0;
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i++) {
+    if (mapping[i] >= TOTAL_ALPHABET_COUNT) {
+      cerr << "Invalid index in plugboard mapping (number should be between 0-25)\n";
+      return INVALID_INDEX;
+    }
+    // a cable connects two letters both ways
+    if (mapping[mapping[i]] != i) {
+      cerr << "Impossible plugboard configuration. There is more than one "   << "attempt to make contact with " << (int) mapping[i] << endl;
+      return IMPOSSIBLE_PLUGBOARD_CONFIGURATION;
+    }
+  }
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i++) {
+    pb_map[i] = mapping[i];
+    if (mapping[i] > i) {
+      pb_config[num_of_parameters++] = i;
+      pb_config[num_of_parameters++] = mapping[i];
     }
   }
+  return NO_ERROR;
+}
+
+void Plugboard::process_input(int& input) {
+  input = pb_map[input];
+}
+
+int const* Plugboard::get_mapping() const {
+  return pb_map;
 }
 
 /**************************** Reflector ****************************/
@@ -139,20 +169,44 @@ int Reflector::setup() {
       }
     }
   }
+
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i += 2) {
+    rf_map[rf_config[i]] = rf_config[i+1];
+    rf_map[rf_config[i+1]] = rf_config[i];
+  }
   in.close();
   return NO_ERROR;
 }
 
-void Reflector::process_input(int& input) {
+int Reflector::setup(unsigned char const mapping[]) {
+  int count = 0;
   for (int i=0; i < TOTAL_ALPHABET_COUNT; i++) {
-    if (rf_config[i] == input) {
-      if (i % 2 == 0)
-        input = rf_config[i+1];
-      else
-        input = rf_config[i-1];
-      return;
+    if (mapping[i] >= TOTAL_ALPHABET_COUNT) {
+      cerr << "Invalid index in reflector mapping (number should be between 0-25)\n";
+      return INVALID_INDEX;
+    }
+    // every letter is swapped with another one
+    if (mapping[i] == i || mapping[mapping[i]] != i) {
+      cerr << "Invalid reflector mapping: duplicated mapping of " << (int) mapping[i] << endl;
+      return INVALID_REFLECTOR_MAPPING;
+    }
+  }
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i++) {
+    rf_map[i] = mapping[i];
+    if (mapping[i] > i) {
+      rf_config[count++] = i;
+      rf_config[count++] = mapping[i];
     }
   }
+  return NO_ERROR;
+}
+
+void Reflector::process_input(int& input) {
+  input = rf_map[input];
+}
+
+int const* Reflector::get_mapping() const {
+  return rf_map;
 }
 
 /**************************** Rotor ****************************/
@@ -226,20 +280,49 @@ int Rotor::setup() {
         return INVALID_ROTOR_MAPPING;
       }
     }
+    notch_mask |= 1u << notch[i];
   }
+
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i++)
+    inv_config[rot_config[i]] = i;
   in.close();
   return NO_ERROR;
 }
 
-void Rotor::set_starting_position(int starting_pos) {
-  if(starting_pos == 0) 
-    return;
-  else {
-    // rotate for as many times as the specified starting_pos
-    // after N rotations the Nth position will be at the top
-    for (int i = starting_pos; i > 0; i--)
-      rotate();
+int Rotor::setup(unsigned char const mapping[], unsigned notch_mask) {
+  unsigned const all_positions = (1u << TOTAL_ALPHABET_COUNT) - 1;
+  unsigned mapped = 0;
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i++) {
+    if (mapping[i] >= TOTAL_ALPHABET_COUNT) {
+      cerr << "Invalid index in rotor configuration (number should be between 0-25)\n";
+      return INVALID_INDEX;
+    }
+    mapped |= 1u << mapping[i];
   }
+  if (mapped != all_positions) {
+    cerr << "Invalid rotor mapping: not all outputs are mapped to\n";
+    return INVALID_ROTOR_MAPPING;
+  }
+  if (notch_mask & ~all_positions) {
+    cerr << "Invalid index for turnover notches (number should be between 0-25)\n";
+    return INVALID_INDEX;
+  }
+
+  this->notch_mask = notch_mask;
+  num_of_notch = 0;
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i++) {
+    rot_config[i] = mapping[i];
+    inv_config[mapping[i]] = i;
+    if ((notch_mask >> i) & 1u)
+      notch[num_of_notch++] = i;
+  }
+  return NO_ERROR;
+}
+
+void Rotor::set_starting_position(int starting_pos) {
+  // after N rotations the Nth position is at the top, and rotating only
+  // moves the offset, so the offset can be set directly
+  offset = starting_pos % TOTAL_ALPHABET_COUNT;
 }
 
 bool Rotor::process_input(int& input, bool rotate_self, bool mapped_backwards) {
@@ -247,48 +330,71 @@ bool Rotor::process_input(int& input, bool rotate_self, bool mapped_backwards) {
   if (rotate_self)
     notch_triggered = rotate();
 
-  if (mapped_backwards) {
-    // + offset when mapped backwards
-    int target = input + offset;
-    if (target > TOTAL_ALPHABET_COUNT - 1) 
-      target -= TOTAL_ALPHABET_COUNT;
-  
-    // output (modified input) as the index where target is matched
-    for (int i=0; i<TOTAL_ALPHABET_COUNT; i++) {
-      if (rot_config[i] == target)
-        input = i;
-    }
-  } else {
-    // - offset when mapped forwards
-    // output (modified input) as the value at index == input
-    input = rot_config[input] - offset;
-    if (input < 0)
-      input = TOTAL_ALPHABET_COUNT + input;
-  }
+  // the contact at index i of the rotated rotor is the contact at index
+  // i + offset of the unrotated wiring
+  int shifted = input + offset;
+  if (shifted > TOTAL_ALPHABET_COUNT - 1) 
+    shifted -= TOTAL_ALPHABET_COUNT;
+
+  // output (modified input) is shifted back by - offset
+  if (mapped_backwards)
+    input = inv_config[shifted] - offset;
+  else
+    input = rot_config[shifted] - offset;
+  if (input < 0)
+    input += TOTAL_ALPHABET_COUNT;
+
   return notch_triggered;
 }
 
+int Rotor::map(int input, int offset, bool mapped_backwards) const {
+  // as process_input, with the offset given instead of the rotor's own
+  int shifted = input + offset;
+  if (shifted > TOTAL_ALPHABET_COUNT - 1) 
+    shifted -= TOTAL_ALPHABET_COUNT;
+
+  int output;
+  if (mapped_backwards)
+    output = inv_config[shifted] - offset;
+  else
+    output = rot_config[shifted] - offset;
+  if (output < 0)
+    output += TOTAL_ALPHABET_COUNT;
+
+  return output;
+}
+
+bool Rotor::step(int& offset) const {
+  // as rotate(), with the offset given instead of the rotor's own
+  if (offset < TOTAL_ALPHABET_COUNT - 1)
+    offset++;
+  else 
+    offset = 0;
+  return (notch_mask >> offset) & 1u;
+}
+
+int Rotor::get_offset() const {
+  return offset;
+}
+
+int const* Rotor::get_mapping(bool mapped_backwards) const {
+  return mapped_backwards ? inv_config : rot_config;
+}
+
+unsigned Rotor::get_notch_mask() const {
+  return notch_mask;
+}
+
 bool Rotor::rotate() {
   if (offset < TOTAL_ALPHABET_COUNT - 1)
     offset++;
   else 
     offset = 0;
 
-  int first = rot_config[0];
-  for (int index = 0; index < TOTAL_ALPHABET_COUNT; index++) {
-    if (index == TOTAL_ALPHABET_COUNT - 1)
-      rot_config[index] = first;
-    else rot_config[index] = rot_config[index + 1];
-  }
-  // check if a notch is triggered
-  for (int i=0; i<num_of_notch; i++) {
-    // offset indicates the number of rotations 
-    // let's say a notch is located at the Nth position
-    // after N rotations the notch will be at the top
-    if (offset == notch[i])
-      return true;
-  }
-  return false;
+  // offset indicates the number of rotations 
+  // let's say a notch is located at the Nth position
+  // after N rotations the notch will be at the top
+  return (notch_mask >> offset) & 1u;
 }
 
 /**************************** Free Functions ****************************/
@@ -310,7 +416,11 @@ int get_starting_pos(char * pos_file, int num_of_rotors, int starting_pos[]) {
       return NON_NUMERIC_CHARACTER;
     }
 
-    in >> starting_pos[count] >> ws;
+    // positions beyond the last rotor are read but not stored
+    int position;
+    in >> position >> ws;
+    if (count < num_of_rotors)
+      starting_pos[count] = position;
   }
 
   if (in.fail()) {
@@ -367,6 +477,7 @@ void rotors_processing(int& input, int const num_of_rotors, Rotor** rotors_ptr,
       else rotate_self = rotate_next;
 
       rotate_next = rotors_ptr[i]->process_input(input, rotate_self, mapped_backwards);
+      INSTRUMENT_ROTATION(i, rotate_self, rotate_next);
     }
   } else {
     rotate_self = false;
@@ -375,7 +486,63 @@ void rotors_processing(int& input, int const num_of_rotors, Rotor** rotors_ptr,
   }
 }
 
-int process_inputs(char const input[], char output[], int& output_length, int num_of_rotors, Plugboard pb, Rotor** rotors_ptr, Reflector rf, char& error_input) {
+// number of t in 1..steps for which (start + t) % 26 is a notch in notch_mask
+static long long count_notch_hits(int start, long long steps, unsigned notch_mask) {
+  unsigned const all_positions = (1u << TOTAL_ALPHABET_COUNT) - 1;
+  long long hits = (steps / TOTAL_ALPHABET_COUNT) * __builtin_popcount(notch_mask);
+  int remaining = steps % TOTAL_ALPHABET_COUNT;
+  if (remaining > 0) {
+    // rotate the mask so that bit 0 is position start + 1
+    int first = (start + 1) % TOTAL_ALPHABET_COUNT;
+    unsigned rotated = ((notch_mask >> first) | (notch_mask << (TOTAL_ALPHABET_COUNT - first))) & all_positions;
+    hits += __builtin_popcount(rotated & ((1u << remaining) - 1));
+  }
+  return hits;
+}
+
+void advance_rotors(int num_of_rotors, Rotor** rotors_ptr, long long steps) {
+  // the rightmost rotor rotates on every letter, each other rotor rotates
+  // as many times as the rotor on its right lands on one of its notches
+  for (int i = num_of_rotors - 1; i >= 0 && steps > 0; i--) {
+    int start = rotors_ptr[i]->get_offset();
+    rotors_ptr[i]->set_starting_position((start + steps) % TOTAL_ALPHABET_COUNT);
+    steps = count_notch_hits(start, steps, rotors_ptr[i]->get_notch_mask());
+  }
+}
+
+void seek_rotors(int num_of_rotors, Rotor** rotors_ptr, int const starting_pos[], long long position) {
+  for (int i=0; i < num_of_rotors; i++)
+    rotors_ptr[i]->set_starting_position(starting_pos[i]);
+  advance_rotors(num_of_rotors, rotors_ptr, position);
+}
+
+void process_letter(int& letter, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf) {
+  INSTRUMENT_CLOCK(since);
+
+  // first plugboard process: 
+  pb.process_input(letter);
+  INSTRUMENT_STAGE(STAGE_PLUGBOARD, since);
+
+  // passing through rotors R-L (forwards): 
+  if (num_of_rotors > 0) 
+    rotors_processing(letter, num_of_rotors, rotors_ptr, false);
+  INSTRUMENT_STAGE(STAGE_FORWARD_ROTORS, since);
+
+  // reflector process:
+  rf.process_input(letter); 
+  INSTRUMENT_STAGE(STAGE_REFLECTOR, since);
+
+  // passing through rotors L-R (backwards):
+  if (num_of_rotors > 0)
+    rotors_processing(letter, num_of_rotors, rotors_ptr, true);
+  INSTRUMENT_STAGE(STAGE_BACKWARD_ROTORS, since);
+
+  // second plugboard process: 
+  pb.process_input(letter);
+  INSTRUMENT_STAGE(STAGE_SECOND_PLUGBOARD, since);
+}
+
+int process_inputs(char const input[], char output[], int& output_length, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf, char& error_input) {
   for (int i=0; input[i] != '\0' && i < MAX_LENGTH; i++) {
     // ignore any whitespace
     if (input[i] == ' ')
@@ -387,29 +554,69 @@ int process_inputs(char const input[], char output[], int& output_length, int nu
     }
 
     int letter = input[i] - 'A';
+    process_letter(letter, num_of_rotors, pb, rotors_ptr, rf);
+    output[output_length++] = letter + 'A';
+  }
+  return NO_ERROR;
+}
 
-    // first plugboard process: 
-    pb.process_input(letter);
+int process_block(char const input[], int input_length, char output[], int& output_length, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf, char& error_input) {
+  for (int i=0; i < input_length; i++) {
+    // ignore any whitespace, including line breaks
+    if (isspace((unsigned char) input[i]))
+      continue;
 
-    // passing through rotors R-L (forwards): 
-    bool mapped_backwards = false;
-    if (num_of_rotors > 0) 
-      rotors_processing(letter, num_of_rotors, rotors_ptr, mapped_backwards);
+    if (input[i] < 'A' || input[i] > 'Z') {
+      error_input = input[i];
+      return INVALID_INPUT_CHARACTER;
+    }
 
-    // reflector process:
-    rf.process_input(letter); 
+    int letter = input[i] - 'A';
+    process_letter(letter, num_of_rotors, pb, rotors_ptr, rf);
+    output[output_length++] = letter + 'A';
+  }
+  return NO_ERROR;
+}
 
-    // passing through rotors L-R (backwards):
-    mapped_backwards = true;
-    if (num_of_rotors > 0)
-      rotors_processing(letter, num_of_rotors, rotors_ptr, mapped_backwards);
+int process_stream(istream& in, ostream& out, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf, char& error_input, StreamStats& stats, int num_of_threads) {
+  bool parallel = num_of_threads > 1;
+  long long block_size = parallel ? (long long) PARALLEL_CHUNK_SIZE * num_of_threads : BLOCK_SIZE;
+  vector<char> input(block_size), output(block_size);
+  int res = NO_ERROR;
+  // once the input turns out to be longer than one block, the machine is
+  // compiled into a keystream table (if its period is short enough)
+  Keystream keystream;
+  bool compiled = false;
+  long long step = 0;
+
+  while (res == NO_ERROR && in.read(input.data(), block_size).gcount() > 0) {
+    long long input_length = in.gcount(), output_length = 0;
+    stats.bytes_in += input_length;
+
+    if (parallel)
+      res = process_parallel(input.data(), input_length, output.data(), output_length, num_of_rotors, pb, rotors_ptr, rf, error_input, num_of_threads, compiled ? &keystream : NULL, step);
+    else {
+      int block_output_length = 0;
+      if (compiled)
+        res = keystream.process_block(input.data(), input_length, output.data(), block_output_length, step, error_input);
+      else
+        res = process_block(input.data(), input_length, output.data(), block_output_length, num_of_rotors, pb, rotors_ptr, rf, error_input);
+      output_length = block_output_length;
+    }
 
-    // second plugboard process: 
-    pb.process_input(letter);
+    // letters before an invalid character are still written out
+    out.write(output.data(), output_length);
+    stats.letters += output_length;
 
-    output[output_length++] = letter + 'A';
+    if (!compiled && input_length == block_size)
+      compiled = keystream.compile(pb, rf, num_of_rotors, rotors_ptr);
   }
-  return NO_ERROR;
+
+  // bring the rotors to where the keystream left off
+  if (compiled)
+    advance_rotors(num_of_rotors, rotors_ptr, step);
+  out.flush();
+  return res;
 }
 
 void check_error (int res) {
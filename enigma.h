@@ -1,8 +1,22 @@
+#ifndef ENIGMA_H
+#define ENIGMA_H
+
+#include <iostream>
 using namespace std;
 
 int const TOTAL_ALPHABET_COUNT = 26;
 int const MAX_LENGTH = 80;
 int const MIN_PARAMETERS = 4;
+/* Size (in bytes) of the blocks read from / written to the streams in stream mode */
+int const BLOCK_SIZE = 1 << 16;
+
+/* Counters filled in by process_stream (used to report throughput) */
+struct StreamStats {
+  /* Number of bytes read from the input stream */
+  long long bytes_in = 0;
+  /* Number of letters encoded / decoded (i.e. written to the output stream) */
+  long long letters = 0;
+};
 
 class Plugboard {
   /* A pointer to the plugboard configuration file */
@@ -11,6 +25,11 @@ class Plugboard {
   int pb_config[TOTAL_ALPHABET_COUNT] = {};
   /* Number of parameters (integers) contained in the config. file */
   int num_of_parameters = 0;
+  /* 
+    Lookup table built from pb_config: pb_map[i] is the letter that i is connected to
+    (letters without a cable are mapped to themselves)
+  */
+  int pb_map[TOTAL_ALPHABET_COUNT];
   
   public: 
     /* 
@@ -21,10 +40,17 @@ class Plugboard {
     Plugboard (char * config);
     /*  
       This function sets up the configuration of the plugboard
-      - assigns value to data members: pb_config, num_of_parameters
+      - assigns value to data members: pb_config, num_of_parameters, pb_map
       - returns an integer: 0 if NO _ERROR, > 0 otherwise
     */
     int setup();
+    /*  
+      This function sets up the plugboard from a lookup table instead of a config. file
+      - parameter: mapping (mapping[i] is the letter i is connected to, or i if it has no cable)
+      - assigns value to data members: pb_config, num_of_parameters, pb_map
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int setup(unsigned char const mapping[]);
     /*
       This function processes the input to the plugboard
       - parameter: input
@@ -32,6 +58,8 @@ class Plugboard {
       - input will not be modified if it's not specified in the config
     */
     void process_input(int& input);
+    /* This function returns the 26-entry lookup table of the plugboard (pb_map) */
+    int const* get_mapping() const;
 };
 
 class Reflector {
@@ -39,6 +67,8 @@ class Reflector {
   char * config_file;
   /* An array of 26 integers read out from the reflector config. file */
   int rf_config[TOTAL_ALPHABET_COUNT] = {};
+  /* Lookup table built from rf_config: rf_map[i] is the letter that i is reflected to */
+  int rf_map[TOTAL_ALPHABET_COUNT] = {};
   
   public: 
     /* 
@@ -49,33 +79,52 @@ class Reflector {
     Reflector (char * config);
     /*  
       This function sets up the configuration of the reflector
-      - assigns value to data members: rf_config
+      - assigns value to data members: rf_config, rf_map
       - returns an integer: 0 if NO _ERROR, > 0 otherwise
     */
     int setup();
+    /*  
+      This function sets up the reflector from a lookup table instead of a config. file
+      - parameter: mapping (mapping[i] is the letter i is reflected to)
+      - assigns value to data members: rf_config, rf_map
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int setup(unsigned char const mapping[]);
     /*
       This function processes the input to the reflector
       - parameter: input
       - every input will be modified to the value that it's mapped to
     */
     void process_input(int& input);
+    /* This function returns the 26-entry lookup table of the reflector (rf_map) */
+    int const* get_mapping() const;
 };
 
 class Rotor {
   /* A pointer to the rotor configuration file */
   char * config_file;
-  /* An array of 26 integers read out from the rotor config. file */
+  /* 
+    An array of 26 integers read out from the rotor config. file 
+    i.e. the forward (R-L) mapping of the rotor at offset 0
+  */
   int rot_config[TOTAL_ALPHABET_COUNT] = {};
+  /* Inverse of rot_config, used for the backward (L-R) mapping */
+  int inv_config[TOTAL_ALPHABET_COUNT] = {};
   /* An array of integers representing the positions of notches on the rotor */
   int notch[TOTAL_ALPHABET_COUNT] = {};
   /* Number of notches on the rotor */
   int num_of_notch = 0;
+  /* Bit N is set if there is a notch at position N */
+  unsigned notch_mask = 0;
   /* 
     This function rotates the rotor by shifting up 1 position
     - increment by 1 the value of the data member: offset
+    - the wiring itself is never moved, the mappings take offset into account instead
     - returns true if a notch is triggered i.e. the notch is at the top position
   */
   bool rotate();
+  /* The benchmark suite (bench/bench.cpp) times rotate() on its own */
+  friend struct RotorBenchmark;
   /* 
     offset from the initial index is incremented on each rotation 
     offset is set to 0 when it's rotated 26 times (a full cycle)  
@@ -91,14 +140,22 @@ class Rotor {
     Rotor (char * config);
     /*  
       This function sets up the configuration of the rotor
-      - assigns value to data members: rot_config, notch, num_of_notch
+      - assigns value to data members: rot_config, inv_config, notch, num_of_notch, notch_mask
       - returns an integer: 0 if NO _ERROR, > 0 otherwise
     */
     int setup();
+    /*  
+      This function sets up the rotor from its wiring instead of a config. file
+      - parameters: mapping (forward wiring at offset 0), notch_mask (bit N set if there is a notch at N)
+      - assigns value to data members: rot_config, inv_config, notch, num_of_notch, notch_mask
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int setup(unsigned char const mapping[], unsigned notch_mask);
     /* 
       This function sets the starting position of the rotor
       - parameter: starting position specified in rotor position file
-      - member function rotate() will be called until the specified position is at the top position (index 0)
+      - the offset is set so that the specified position is at the top position (index 0),
+        as if rotate() had been called starting_pos times from position 0
     */
     void set_starting_position(int starting_pos);
     /* 
@@ -108,6 +165,29 @@ class Rotor {
       - returns true if the notch of this rotor is triggered on rotation
     */
     bool process_input(int& input, bool rotate_self = false,  bool mapped_backwards = false);
+    /* 
+      This function maps input through the wiring turned to a given offset
+      - parameters: input, offset (0-25), mapped_backwards (if true, direction is L-R)
+      - the rotor's own offset is neither used nor changed, so one rotor can be shared
+        (read-only) by several machines that each keep their own offsets (see Session)
+      - returns the letter input is mapped to
+    */
+    int map(int input, int offset, bool mapped_backwards = false) const;
+    /* 
+      This function rotates a given offset by 1 position, as rotate() does with the rotor's own offset
+      - parameter: offset (0-25), incremented modulo 26
+      - returns true if a notch of this rotor is triggered
+    */
+    bool step(int& offset) const;
+    /* This function returns the current offset of the rotor (0-25) */
+    int get_offset() const;
+    /* 
+      This function returns the 26-entry wiring table of the rotor at offset 0
+      - parameter: mapped_backwards (if true, the inverse wiring is returned)
+    */
+    int const* get_mapping(bool mapped_backwards = false) const;
+    /* This function returns the notch positions as a bitmask (bit N set if there is a notch at N) */
+    unsigned get_notch_mask() const;
 };
 
 /**************************** Free Functions ****************************/
@@ -137,9 +217,33 @@ Rotor** setup_rotors(int num_of_rotors, char** const argv, int const starting_po
 */
 void rotors_processing(int& input, int const num_of_rotors, Rotor** rotors_ptr, bool mapped_backwards);
 
+/* 
+  This function moves all rotors forward as if a number of letters had been processed
+  - parameters: num_of_rotors, pointer to an array of rotors, steps (number of letters)
+  - the stepping of every rotor is computed from its current offset and the notches 
+    of the rotor on its right, so the cost does not depend on steps
+*/
+void advance_rotors(int num_of_rotors, Rotor** rotors_ptr, long long steps);
+
+/* 
+  This function sets the rotors to the positions they have after a number of letters
+  - parameters: num_of_rotors, pointer to an array of rotors, starting_pos, position
+  - position is the number of letters processed since the rotors were at starting_pos
+  - the following letter is processed exactly as letter 'position' of a message started at starting_pos
+*/
+void seek_rotors(int num_of_rotors, Rotor** rotors_ptr, int const starting_pos[], long long position);
+
+/* 
+  This function passes one letter through the whole machine
+  - parameters: letter (0-25), num_of_rotors, plugboard, pointer to an array of rotors, reflector
+  - the rotors step first, then the letter passes through plugboard -> rotors -> reflector -> rotors(backwards) -> plugboard
+  - letter will be modified to the value that it's mapped to
+*/
+void process_letter(int& letter, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf);
+
 /* 
   This function runs the whole process of encoding / decoding
-  - parameters: input array, output array, output_length, num_of_rotors, instance of plugboard, pointer to an array of rotors, instance of reflector, error_input 
+  - parameters: input array, output array, output_length, num_of_rotors, plugboard, pointer to an array of rotors, reflector, error_input (plugboard and reflector are passed by reference, not copied)
   - each input letter is processed in a loop, passing through plugboard -> rotors -> reflector -> rotors(backwards) -> plugboard
   - each modified input is stored in the output array to be printed out
   - output_length allows the assignment of a sentinel character to the end of the output array
@@ -147,7 +251,32 @@ void rotors_processing(int& input, int const num_of_rotors, Rotor** rotors_ptr,
   - if an invalid input is encountered, it will be stored in error_input to point out to user that it's invalid
   - returns an integer: 0 if NO _ERROR, > 0 otherwise
 */
-int process_inputs(char const input[], char output[], int& output_length, int num_of_rotors, Plugboard pb, Rotor** rotors_ptr, Reflector rf, char& error_input);
+int process_inputs(char const input[], char output[], int& output_length, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf, char& error_input);
+
+/* 
+  This function runs the encoding / decoding of a block of input of known length
+  - parameters: input array, input_length, output array, output_length, num_of_rotors, plugboard, pointer to an array of rotors, reflector, error_input
+  - unlike process_inputs, the input is not terminated by '\0' nor bounded by MAX_LENGTH
+  - any whitespace (including newlines) is skipped
+  - the rotors keep their positions after returning, so consecutive blocks of one message can be processed by consecutive calls
+  - output_length is incremented by the number of letters written to the output array
+  - if an invalid input is encountered, it will be stored in error_input and the letters before it are still written to the output array
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int process_block(char const input[], int input_length, char output[], int& output_length, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf, char& error_input);
+
+/* 
+  This function encodes / decodes a whole stream of input of any length
+  - parameters: input stream, output stream, num_of_rotors, plugboard, pointer to an array of rotors, reflector, error_input, stats, num_of_threads
+  - input is read and output is written in blocks of BLOCK_SIZE bytes (PARALLEL_CHUNK_SIZE bytes per thread 
+    when num_of_threads > 1), so memory use does not depend on the length of the input
+  - with num_of_threads > 1, every block is split between threads by process_parallel
+  - the rotor positions are carried over from one block to the next
+  - input longer than one block is processed with a compiled Keystream when the rotors' period allows it
+  - stats is updated with the number of bytes read and letters written
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int process_stream(istream& in, ostream& out, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf, char& error_input, StreamStats& stats, int num_of_threads = 1);
 
 /* 
   This function checks the resolved value (res) of functions that return an error code
@@ -156,3 +285,4 @@ int process_inputs(char const input[], char output[], int& output_length, int nu
 */
 void check_error (int res);
 
+#endif
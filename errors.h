@@ -10,4 +10,13 @@
 #define INVALID_REFLECTOR_MAPPING                 9
 #define INCORRECT_NUMBER_OF_REFLECTOR_PARAMETERS  10
 #define ERROR_OPENING_CONFIGURATION_FILE          11
+#define INVALID_KEY_FILE                          12
+#define SOCKET_ERROR                              13
+#define INVALID_CHECKPOINT                        14
+#define INVALID_INDEX_FILE                        15
+#define UNKNOWN_KEY_ID                            16
+#define INVALID_NGRAM_TABLE                       17
+#define INVALID_JOB_FILE                          18
+#define INVALID_PACKED_STREAM                     19
+#define INVALID_WORD_LIST                         20
 #define NO_ERROR                                  0
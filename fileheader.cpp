@@ -0,0 +1,18 @@
+#include <cstring>
+#include <iostream>
+#include "fileheader.h"
+#include "errors.h"
+using namespace std;
+
+int check_file_header(char const magic[4], uint32_t version, char const expected_magic[4], uint32_t expected_version, char const* what, char const* file, int error) {
+  if (memcmp(magic, expected_magic, 4) == 0 && version == expected_version)
+    return NO_ERROR;
+  cerr << "Invalid " << what;
+  if (file)
+    cerr << ' ' << file;
+  if (memcmp(magic, expected_magic, 4) == 0 && version == __builtin_bswap32(expected_version))
+    cerr << " (written on a host of the other byte order)\n";
+  else
+    cerr << " (not a version " << expected_version << ' ' << what << ")\n";
+  return error;
+}
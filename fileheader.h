@@ -0,0 +1,23 @@
+#ifndef FILEHEADER_H
+#define FILEHEADER_H
+
+#include <cstdint>
+using namespace std;
+
+/* 
+  The binary files of enigma (key files, checkpoints, catalogue indexes, n-gram tables) are written
+  and read (or mapped) as structs, so their integers and floats are in host byte order. 
+  Each starts with a 4-byte magic and a uint32_t version: a file written on a host of the other byte order 
+  has the right magic and its version byte-swapped, and is rejected by check_file_header.
+*/
+
+/* 
+  This function checks the magic and version read at the start of a binary file
+  - parameters: magic, version (as read), expected_magic, expected_version, 
+    what (the kind of file, e.g. "key file"), file (its name, or NULL), error (returned if the check fails)
+  - the reason (another byte order, or not a file of this version) is printed to cerr
+  - returns an integer: 0 if NO _ERROR, error otherwise
+*/
+int check_file_header(char const magic[4], uint32_t version, char const expected_magic[4], uint32_t expected_version, char const* what, char const* file, int error);
+
+#endif
@@ -0,0 +1,108 @@
+#include <cctype>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "filemode.h"
+#include "errors.h"
+using namespace std;
+
+// maps a whole file, returns NULL for an empty file or on error
+static char* map_file(int fd, size_t size, bool writable) {
+  if (size == 0)
+    return NULL;
+  void* mapped = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED)
+    return NULL;
+  madvise(mapped, size, MADV_SEQUENTIAL);
+  return (char*) mapped;
+}
+
+// finds the first input that is neither a letter nor whitespace, returns false if there is one
+static bool all_valid(char const input[], size_t size, char& error_input) {
+  for (size_t i = 0; i < size; i++)
+    if ((input[i] < 'A' || input[i] > 'Z') && !isspace((unsigned char) input[i])) {
+      error_input = input[i];
+      return false;
+    }
+  return true;
+}
+
+int encrypt_file(Machine& machine, char * in_file, char * out_file, int num_of_threads, char& error_input, StreamStats& stats) {
+  // the same file under two names (./x, a hard link...) is the same device and inode, so it is written in place
+  struct stat in_stat, out_stat;
+  bool in_place = out_file == NULL;
+  if (!in_place && stat(in_file, &in_stat) == 0 && stat(out_file, &out_stat) == 0)
+    in_place = in_stat.st_dev == out_stat.st_dev && in_stat.st_ino == out_stat.st_ino;
+
+  int in_fd = open(in_file, in_place ? O_RDWR : O_RDONLY);
+  if (in_fd < 0 || fstat(in_fd, &in_stat) != 0) {
+    cerr << "Error opening input file " << in_file << endl;
+    if (in_fd >= 0)
+      close(in_fd);
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  size_t size = in_stat.st_size;
+  char* input = map_file(in_fd, size, in_place);
+  if (size > 0 && input == NULL) {
+    cerr << "Error mapping " << in_file << endl;
+    close(in_fd);
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+
+  // the output is only truncated once it is known not to be the input (checked again on the open file,
+  // in case it was replaced since the stat above)
+  int out_fd = in_fd;
+  if (!in_place) {
+    out_fd = open(out_file, O_RDWR | O_CREAT, 0644);
+    bool aliased = out_fd >= 0 && fstat(out_fd, &out_stat) == 0
+      && out_stat.st_dev == in_stat.st_dev && out_stat.st_ino == in_stat.st_ino;
+    // the output is never longer than the input
+    if (out_fd < 0 || aliased || ftruncate(out_fd, size) != 0) {
+      cerr << "Error opening output file " << out_file << (aliased ? " (it is the input file)" : "") << endl;
+      if (input)
+        munmap(input, size);
+      close(in_fd);
+      if (out_fd >= 0)
+        close(out_fd);
+      return ERROR_OPENING_CONFIGURATION_FILE;
+    }
+  }
+
+  char* output = in_place ? input : map_file(out_fd, size, true);
+  int res = NO_ERROR;
+  size_t output_length = 0;
+  if (size > 0 && output == NULL) {
+    cerr << "Error mapping " << out_file << endl;
+    res = ERROR_OPENING_CONFIGURATION_FILE;
+  } else if (in_place && !all_valid(input, size, error_input)) {
+    // in place, the letters before an invalid input would overwrite the file: it is left as it is
+    res = INVALID_INPUT_CHARACTER;
+  } else if (size > 0) {
+    // worth compiling the keystream for anything longer than a block
+    if (size > (size_t) BLOCK_SIZE)
+      machine.compile();
+    if (num_of_threads > 1 && !in_place)
+      res = machine.encrypt_parallel(input, size, output, output_length, error_input, num_of_threads);
+    else
+      res = machine.encrypt(input, size, output, output_length, error_input);
+  }
+  stats.bytes_in += size;
+  stats.letters += output_length;
+
+  if (input)
+    munmap(input, size);
+  if (output && !in_place)
+    munmap(output, size);
+  // drop the room left by whitespace (and, in a separate output file, by anything after an invalid input)
+  bool untouched = res == ERROR_OPENING_CONFIGURATION_FILE || (in_place && res == INVALID_INPUT_CHARACTER);
+  if (!untouched && ftruncate(out_fd, output_length) != 0) {
+    cerr << "Error truncating " << (in_place ? in_file : out_file) << endl;
+    res = ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  close(in_fd);
+  if (!in_place)
+    close(out_fd);
+  return res;
+}
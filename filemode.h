@@ -0,0 +1,22 @@
+#ifndef FILEMODE_H
+#define FILEMODE_H
+
+#include "machine.h"
+using namespace std;
+
+/* 
+  This function encodes / decodes a file into another file (or into itself) through memory maps
+  - parameters: machine, input file, output file (NULL or the input file for in-place), 
+    num_of_threads, error_input, stats
+  - both files are memory-mapped and the machine runs directly over the mapped pages, 
+    with sequential-access hints; whitespace is dropped, so the output file is truncated 
+    to the number of letters written
+  - the output file is the input file (in place) when both names lead to the same inode
+  - in place, letters are always written at or before the position they were read from; 
+    threads are only used when input and output are different files
+  - in place, the whole file is checked first: a file with an invalid input is left untouched
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int encrypt_file(Machine& machine, char * in_file, char * out_file, int num_of_threads, char& error_input, StreamStats& stats);
+
+#endif
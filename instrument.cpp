@@ -0,0 +1,126 @@
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "instrument.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+using namespace std;
+
+#ifdef ENIGMA_INSTRUMENT
+
+static char const* const STAGE_NAMES[NUM_OF_STAGES] = {"plugboard", "forward_rotors", "reflector", "backward_rotors", "second_plugboard"};
+
+struct InstrumentCounters {
+  uint64_t cycles[NUM_OF_STAGES] = {};
+  uint64_t calls[NUM_OF_STAGES] = {};
+  vector<uint64_t> rotations, turnovers;
+  uint64_t keystream_letters = 0;
+
+  void add(InstrumentCounters const& other) {
+    for (int s = 0; s < NUM_OF_STAGES; s++) {
+      cycles[s] += other.cycles[s];
+      calls[s] += other.calls[s];
+    }
+    if (rotations.size() < other.rotations.size()) {
+      rotations.resize(other.rotations.size());
+      turnovers.resize(other.turnovers.size());
+    }
+    for (size_t r = 0; r < other.rotations.size(); r++) {
+      rotations[r] += other.rotations[r];
+      turnovers[r] += other.turnovers[r];
+    }
+    keystream_letters += other.keystream_letters;
+  }
+};
+
+// counters of the threads that have exited
+static mutex finished_lock;
+static InstrumentCounters finished;
+
+/* Per-thread counters, added to 'finished' when the thread exits */
+struct ThreadCounters : InstrumentCounters {
+  ~ThreadCounters() {
+    lock_guard<mutex> guard(finished_lock);
+    finished.add(*this);
+  }
+};
+static thread_local ThreadCounters counters;
+
+uint64_t instrument_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void instrument_stage(InstrumentStage stage, uint64_t& since) {
+  uint64_t now = instrument_clock();
+  counters.cycles[stage] += now - since;
+  counters.calls[stage]++;
+  since = now;
+}
+
+void instrument_rotation(int index, bool rotated, bool turnover) {
+  if ((size_t) index >= counters.rotations.size()) {
+    counters.rotations.resize(index + 1);
+    counters.turnovers.resize(index + 1);
+  }
+  counters.rotations[index] += rotated;
+  counters.turnovers[index] += turnover;
+}
+
+void instrument_keystream(long long letters) {
+  counters.keystream_letters += letters;
+}
+
+bool instrument_enabled() {
+  return true;
+}
+
+void instrument_report(ostream& out) {
+  InstrumentCounters total;
+  {
+    lock_guard<mutex> guard(finished_lock);
+    total.add(finished);
+  }
+  total.add(counters);
+
+  uint64_t all_cycles = 0;
+  for (int s = 0; s < NUM_OF_STAGES; s++)
+    all_cycles += total.cycles[s];
+
+#if defined(__x86_64__) || defined(__i386__)
+  char const* unit = "rdtsc";
+#else
+  char const* unit = "ns";
+#endif
+  out << "{\n  \"enabled\": true,\n  \"clock\": \"" << unit << "\",\n"
+    << "  \"letters\": " << total.calls[STAGE_PLUGBOARD] << ",\n"
+    << "  \"keystream_letters\": " << total.keystream_letters << ",\n  \"stages\": {\n";
+  for (int s = 0; s < NUM_OF_STAGES; s++) {
+    out << "    \"" << STAGE_NAMES[s] << "\": {\"cycles\": " << total.cycles[s] << ", \"calls\": " << total.calls[s]
+      << ", \"cycles_per_call\": " << (total.calls[s] ? (double) total.cycles[s] / total.calls[s] : 0)
+      << ", \"share\": " << (all_cycles ? (double) total.cycles[s] / all_cycles : 0) << "}"
+      << (s + 1 < NUM_OF_STAGES ? "," : "") << "\n";
+  }
+  out << "  },\n  \"rotors\": [\n";
+  for (size_t r = 0; r < total.rotations.size(); r++) {
+    out << "    {\"index\": " << r << ", \"rotations\": " << total.rotations[r] << ", \"turnovers\": " << total.turnovers[r] << "}"
+      << (r + 1 < total.rotations.size() ? "," : "") << "\n";
+  }
+  out << "  ]\n}\n";
+}
+
+#else
+
+bool instrument_enabled() {
+  return false;
+}
+
+void instrument_report(ostream& out) {
+  out << "{\"enabled\": false}\n";
+}
+
+#endif
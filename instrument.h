@@ -0,0 +1,64 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <cstdint>
+#include <iostream>
+using namespace std;
+
+/* 
+  Hot-path instrumentation. Everything below compiles to nothing unless 
+  ENIGMA_INSTRUMENT is defined (make enigma_instrumented), so the normal 
+  build pays nothing for it.
+  - cycles (rdtsc on x86, nanoseconds elsewhere) spent in each stage of process_letter
+  - rotations and notch turnovers of each rotor (counted in rotors_processing,
+    so they include the stepping done while compiling a Keystream)
+  - letters processed through a compiled Keystream (which has no stages)
+  Counters are kept per thread and summed when threads exit and on report.
+*/
+
+/* The stages of the machine, in the order a letter passes through them */
+enum InstrumentStage {
+  STAGE_PLUGBOARD,
+  STAGE_FORWARD_ROTORS,
+  STAGE_REFLECTOR,
+  STAGE_BACKWARD_ROTORS,
+  STAGE_SECOND_PLUGBOARD,
+  NUM_OF_STAGES
+};
+
+#ifdef ENIGMA_INSTRUMENT
+
+/* This function returns the current cycle count */
+uint64_t instrument_clock();
+/* This function adds the time since 'since' to a stage, and sets since to now */
+void instrument_stage(InstrumentStage stage, uint64_t& since);
+/* This function counts a rotation (if rotated) and a turnover (if the notch was triggered) of rotor index */
+void instrument_rotation(int index, bool rotated, bool turnover);
+/* This function counts letters processed through a compiled Keystream */
+void instrument_keystream(long long letters);
+
+#define INSTRUMENT_CLOCK(since) uint64_t since = instrument_clock()
+#define INSTRUMENT_STAGE(stage, since) instrument_stage(stage, since)
+#define INSTRUMENT_ROTATION(index, rotated, turnover) instrument_rotation(index, rotated, turnover)
+#define INSTRUMENT_KEYSTREAM(letters) instrument_keystream(letters)
+
+#else
+
+#define INSTRUMENT_CLOCK(since) ((void) 0)
+#define INSTRUMENT_STAGE(stage, since) ((void) 0)
+#define INSTRUMENT_ROTATION(index, rotated, turnover) ((void) 0)
+#define INSTRUMENT_KEYSTREAM(letters) ((void) 0)
+
+#endif
+
+/* This function returns true if the instrumentation is compiled in */
+bool instrument_enabled();
+
+/* 
+  This function writes the counters of this run as a JSON summary
+  - parameter: output stream
+  - writes {"enabled": false} if the instrumentation is not compiled in
+*/
+void instrument_report(ostream& out);
+
+#endif
@@ -0,0 +1,556 @@
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "job.h"
+#include "crack.h"
+#include "ngram.h"
+#include "search.h"
+#include "errors.h"
+using namespace std;
+
+static char const* const JOB_MAGIC = "enigma-job";
+static int const JOB_VERSION = 1;
+
+// orders candidates best first
+static bool better(JobCandidate const& a, JobCandidate const& b) {
+  return a.score > b.score;
+}
+
+static string shard_file(string const& directory, long long shard, char const* extension) {
+  return directory + "/shard-" + to_string(shard) + extension;
+}
+
+long long job_num_of_tasks(SearchJob const& job) {
+  vector<vector<int>> orders;
+  rotor_orders(job.rotor_files.size(), job.num_of_rotors, orders);
+  return (long long) job.reflector_files.size() * orders.size() * TOTAL_ALPHABET_COUNT;
+}
+
+long long job_num_of_shards(SearchJob const& job) {
+  return (job_num_of_tasks(job) + job.shard_size - 1) / job.shard_size;
+}
+
+/**************************** Job files ****************************/
+
+int write_job(string const& directory, SearchJob const& job) {
+  if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    cerr << "Error creating job directory " << directory << ": " << strerror(errno) << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  string job_file = directory + "/job";
+  if (access(job_file.c_str(), F_OK) == 0) {
+    cerr << "There is already a job in " << directory << endl;
+    return INVALID_JOB_FILE;
+  }
+
+  ofstream letters(directory + "/ciphertext", ios::trunc);
+  for (int letter : job.ciphertext)
+    letters << (char) ('A' + letter);
+  letters << '\n';
+  letters.close();
+
+  // the job file is written last: a directory without one is not a job yet
+  string temporary = job_file + ".tmp";
+  ofstream out(temporary, ios::trunc);
+  out << JOB_MAGIC << ' ' << JOB_VERSION << '\n'
+    << "num-of-rotors " << job.num_of_rotors << '\n'
+    << "shard-size " << job.shard_size << '\n'
+    << "keep " << job.keep << '\n';
+  if (!job.plugboard_file.empty())
+    out << "plugboard " << job.plugboard_file << '\n';
+  if (!job.ngrams_file.empty())
+    out << "ngrams " << job.ngrams_file << '\n';
+  for (string const& file : job.reflector_files)
+    out << "reflector " << file << '\n';
+  for (string const& file : job.rotor_files)
+    out << "rotor " << file << '\n';
+  out.close();
+  if (!letters || !out || rename(temporary.c_str(), job_file.c_str()) != 0) {
+    cerr << "Error writing job files in " << directory << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  return NO_ERROR;
+}
+
+int read_job(string const& directory, SearchJob& job) {
+  string job_file = directory + "/job";
+  ifstream in(job_file);
+  if (!in) {
+    cerr << "Error opening job file " << job_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  string magic, key, value;
+  int version = 0;
+  if (!(in >> magic >> version) || magic != JOB_MAGIC || version != JOB_VERSION) {
+    cerr << "Invalid job file " << job_file << " (bad header)\n";
+    return INVALID_JOB_FILE;
+  }
+  job = SearchJob();
+  while (in >> key && in >> ws && getline(in, value)) {
+    if (key == "num-of-rotors")
+      job.num_of_rotors = atoi(value.c_str());
+    else if (key == "shard-size")
+      job.shard_size = atoi(value.c_str());
+    else if (key == "keep")
+      job.keep = atoi(value.c_str());
+    else if (key == "plugboard")
+      job.plugboard_file = value;
+    else if (key == "ngrams")
+      job.ngrams_file = value;
+    else if (key == "reflector")
+      job.reflector_files.push_back(value);
+    else if (key == "rotor")
+      job.rotor_files.push_back(value);
+    else {
+      cerr << "Invalid job file " << job_file << " (unknown key " << key << ")\n";
+      return INVALID_JOB_FILE;
+    }
+  }
+  if (job.num_of_rotors < 1 || job.num_of_rotors > (int) job.rotor_files.size()
+      || job.reflector_files.empty() || job.shard_size < 1 || job.keep < 1) {
+    cerr << "Invalid job file " << job_file << " (missing or invalid settings)\n";
+    return INVALID_JOB_FILE;
+  }
+
+  ifstream letters(directory + "/ciphertext");
+  char error_input;
+  if (!letters || read_letters(letters, job.ciphertext, error_input) != NO_ERROR || job.ciphertext.empty()) {
+    cerr << "Invalid ciphertext in job directory " << directory << endl;
+    return INVALID_JOB_FILE;
+  }
+  return NO_ERROR;
+}
+
+int read_shard_progress(string const& directory, SearchJob const& job, long long shard, ShardProgress& progress) {
+  progress.shard = shard;
+  progress.next_task = shard * job.shard_size;
+  progress.best.clear();
+  string file = shard_file(directory, shard, ".best");
+  ifstream in(file);
+  if (!in)
+    return errno == ENOENT ? NO_ERROR : ERROR_OPENING_CONFIGURATION_FILE;
+
+  string key;
+  long long file_shard;
+  size_t num_of_candidates;
+  if (!(in >> key >> file_shard) || key != "shard" || file_shard != shard
+      || !(in >> key >> progress.next_task) || key != "next-task"
+      || !(in >> key >> num_of_candidates) || key != "candidates") {
+    cerr << "Invalid progress file " << file << endl;
+    return INVALID_JOB_FILE;
+  }
+  progress.best.resize(num_of_candidates);
+  for (JobCandidate& candidate : progress.best) {
+    candidate.rotor_order.resize(job.num_of_rotors);
+    candidate.starting_pos.resize(job.num_of_rotors);
+    in >> candidate.score >> candidate.reflector;
+    for (int& r : candidate.rotor_order)
+      in >> r;
+    for (int& p : candidate.starting_pos)
+      in >> p;
+  }
+  long long end = min((shard + 1) * job.shard_size, job_num_of_tasks(job));
+  if (!in || progress.next_task < shard * job.shard_size || progress.next_task > end) {
+    cerr << "Invalid progress file " << file << endl;
+    return INVALID_JOB_FILE;
+  }
+  return NO_ERROR;
+}
+
+int write_shard_progress(string const& directory, ShardProgress const& progress) {
+  string file = shard_file(directory, progress.shard, ".best");
+  string temporary = file + ".tmp";
+  ofstream out(temporary, ios::trunc);
+  out << "shard " << progress.shard << '\n'
+    << "next-task " << progress.next_task << '\n'
+    << "candidates " << progress.best.size() << '\n'
+    << setprecision(17);
+  for (JobCandidate const& candidate : progress.best) {
+    out << candidate.score << ' ' << candidate.reflector;
+    for (int r : candidate.rotor_order)
+      out << ' ' << r;
+    for (int p : candidate.starting_pos)
+      out << ' ' << p;
+    out << '\n';
+  }
+  out.close();
+  if (!out || rename(temporary.c_str(), file.c_str()) != 0) {
+    cerr << "Error writing progress file " << file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  return NO_ERROR;
+}
+
+/**************************** Worker ****************************/
+
+/* The machine parts of a job, set up once per worker */
+struct JobParts {
+  Plugboard pb;
+  vector<Reflector> reflectors;
+  vector<Rotor> rotor_set;
+  NgramTable ngrams;
+  bool use_ngrams = false;
+  vector<vector<int>> orders;
+
+  JobParts () : pb(NULL) {}
+};
+
+static int setup_job_parts(SearchJob const& job, JobParts& parts) {
+  int res = NO_ERROR;
+  if (!job.plugboard_file.empty()) {
+    parts.pb = Plugboard(const_cast<char*>(job.plugboard_file.c_str()));
+    if ((res = parts.pb.setup()) != NO_ERROR)
+      return res;
+  }
+  for (string const& file : job.reflector_files) {
+    parts.reflectors.push_back(Reflector(const_cast<char*>(file.c_str())));
+    if ((res = parts.reflectors.back().setup()) != NO_ERROR)
+      return res;
+  }
+  for (string const& file : job.rotor_files) {
+    parts.rotor_set.push_back(Rotor(const_cast<char*>(file.c_str())));
+    if ((res = parts.rotor_set.back().setup()) != NO_ERROR)
+      return res;
+  }
+  if (!job.ngrams_file.empty()) {
+    if ((res = parts.ngrams.load(const_cast<char*>(job.ngrams_file.c_str()))) != NO_ERROR)
+      return res;
+    parts.use_ngrams = true;
+  }
+  rotor_orders(job.rotor_files.size(), job.num_of_rotors, parts.orders);
+  return NO_ERROR;
+}
+
+/*
+  This function scores every setting of one task and keeps the best in best
+  - best is a min-heap (the worst kept candidate first) of at most job.keep candidates
+  - returns the number of settings scored
+*/
+static long long run_task(SearchJob const& job, JobParts& parts, long long task, vector<JobCandidate>& best) {
+  int const TAC = TOTAL_ALPHABET_COUNT, num_of_rotors = job.num_of_rotors;
+  long long tasks_per_reflector = (long long) parts.orders.size() * TAC;
+  Reflector& rf = parts.reflectors[task / tasks_per_reflector];
+  vector<int> const& order = parts.orders[(task / TAC) % parts.orders.size()];
+
+  JobCandidate candidate;
+  candidate.reflector = task / tasks_per_reflector;
+  candidate.rotor_order = order;
+  int length = job.ciphertext.size();
+  vector<int> plaintext(length);
+  return for_each_setting(parts.rotor_set, order, task % TAC, 0, [&](Rotor** rotors_ptr, vector<int> const& starting_pos) {
+    for (int t = 0; t < length; t++) {
+      int letter = job.ciphertext[t];
+      process_letter(letter, num_of_rotors, parts.pb, rotors_ptr, rf);
+      plaintext[t] = letter;
+    }
+    candidate.starting_pos = starting_pos;
+    candidate.score = parts.use_ngrams ? parts.ngrams.score(plaintext.data(), length) : index_of_coincidence(plaintext.data(), length);
+
+    if ((int) best.size() < job.keep || candidate.score > best.front().score) {
+      best.push_back(candidate);
+      push_heap(best.begin(), best.end(), better);
+      if ((int) best.size() > job.keep) {
+        pop_heap(best.begin(), best.end(), better);
+        best.pop_back();
+      }
+    }
+  });
+}
+
+/* This function saves the progress of a shard with its candidates best first (best itself stays a heap) */
+static int save_shard(string const& directory, ShardProgress const& progress) {
+  ShardProgress sorted = progress;
+  sort(sorted.best.begin(), sorted.best.end(), better);
+  return write_shard_progress(directory, sorted);
+}
+
+int run_job_worker(string const& directory, JobWorkerStats& stats) {
+  auto start_time = chrono::steady_clock::now();
+  SearchJob job;
+  JobParts parts;
+  int res = read_job(directory, job);
+  if (res == NO_ERROR)
+    res = setup_job_parts(job, parts);
+  if (res != NO_ERROR)
+    return res;
+
+  long long num_of_tasks = job_num_of_tasks(job), num_of_shards = job_num_of_shards(job);
+  ShardProgress progress;
+  for (long long shard = 0; shard < num_of_shards && res == NO_ERROR; shard++) {
+    long long end = min((shard + 1) * job.shard_size, num_of_tasks);
+    if ((res = read_shard_progress(directory, job, shard, progress)) != NO_ERROR)
+      break;
+    if (progress.next_task == end)
+      continue;
+
+    // a shard locked by another worker is skipped
+    string lock_file = shard_file(directory, shard, ".lock");
+    int lock_fd = open(lock_file.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0644);
+    if (lock_fd < 0) {
+      cerr << "Error opening lock file " << lock_file << ": " << strerror(errno) << endl;
+      res = ERROR_OPENING_CONFIGURATION_FILE;
+      break;
+    }
+    if (flock(lock_fd, LOCK_EX | LOCK_NB) != 0) {
+      close(lock_fd);
+      continue;
+    }
+    // the shard may have been finished (or checkpointed) between the first read and the lock
+    if ((res = read_shard_progress(directory, job, shard, progress)) != NO_ERROR || progress.next_task == end) {
+      close(lock_fd);
+      continue;
+    }
+
+    make_heap(progress.best.begin(), progress.best.end(), better);
+    auto last_save = chrono::steady_clock::now();
+    while (progress.next_task < end && res == NO_ERROR) {
+      stats.settings += run_task(job, parts, progress.next_task, progress.best);
+      progress.next_task++;
+      auto now = chrono::steady_clock::now();
+      if (progress.next_task == end || chrono::duration<double>(now - last_save).count() >= JOB_CHECKPOINT_SECONDS) {
+        res = save_shard(directory, progress);
+        last_save = now;
+      }
+    }
+    // closing the lock file releases the lock
+    close(lock_fd);
+    if (res == NO_ERROR)
+      stats.shards++;
+  }
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+  return res;
+}
+
+/**************************** Merge ****************************/
+
+int merge_job(string const& directory, SearchJob const& job, vector<JobCandidate>& best, JobStatus& status) {
+  status = JobStatus();
+  status.shards = job_num_of_shards(job);
+  status.num_of_tasks = job_num_of_tasks(job);
+  best.clear();
+  ShardProgress progress;
+  for (long long shard = 0; shard < status.shards; shard++) {
+    int res = read_shard_progress(directory, job, shard, progress);
+    if (res != NO_ERROR)
+      return res;
+    long long first = shard * job.shard_size, end = min(first + job.shard_size, status.num_of_tasks);
+    status.tasks_done += progress.next_task - first;
+    if (progress.next_task == end)
+      status.done++;
+    else if (progress.next_task > first)
+      status.started++;
+    best.insert(best.end(), progress.best.begin(), progress.best.end());
+  }
+  // ties are broken by setting, so that the merge does not depend on the order the shards finished in
+  sort(best.begin(), best.end(), [](JobCandidate const& a, JobCandidate const& b) {
+    if (a.score != b.score)
+      return a.score > b.score;
+    if (a.reflector != b.reflector)
+      return a.reflector < b.reflector;
+    return a.rotor_order != b.rotor_order ? a.rotor_order < b.rotor_order : a.starting_pos < b.starting_pos;
+  });
+  if ((int) best.size() > job.keep)
+    best.resize(job.keep);
+  return NO_ERROR;
+}
+
+/**************************** Subcommand ****************************/
+
+/* This function returns the absolute path of a file, or an empty string if it does not exist */
+static string absolute_path(char const* file) {
+  char resolved[PATH_MAX];
+  if (realpath(file, resolved) == NULL) {
+    cerr << "Error opening " << file << ": " << strerror(errno) << endl;
+    return "";
+  }
+  return resolved;
+}
+
+static int job_init(int argc, char** argv) {
+  SearchJob job;
+  char * plugboard_file = NULL, * ngrams_file = NULL;
+  vector<char*> reflector_files;
+  bool options_ok = true;
+  while (argc > 1 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--shard-size") == 0)
+      job.shard_size = atoi(argv[1]);
+    else if (strcmp(argv[0], "--keep") == 0)
+      job.keep = atoi(argv[1]);
+    else if (strcmp(argv[0], "--plugboard") == 0)
+      plugboard_file = argv[1];
+    else if (strcmp(argv[0], "--ngrams") == 0)
+      ngrams_file = argv[1];
+    else if (strcmp(argv[0], "--reflector") == 0)
+      reflector_files.push_back(argv[1]);
+    else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+  int const min_parameters = 3;
+  job.num_of_rotors = argc >= min_parameters ? atoi(argv[1]) : 0;
+  int num_of_rotor_files = argc - 2;
+  if (!options_ok || argc < min_parameters || reflector_files.empty() || job.num_of_rotors < 1 || job.num_of_rotors > num_of_rotor_files
+      || job.shard_size < 1 || job.keep < 1) {
+    cerr << "usage: enigma job init [--shard-size S] [--keep K] [--plugboard file] [--ngrams table-file] --reflector file [--reflector file...]\n"
+      << "         job-dir num-of-rotors (<rotor-file>)+ < ciphertext\n"
+      << "       enigma job work [--processes P] job-dir\n"
+      << "       enigma job merge job-dir\n"
+      << "(num-of-rotors must be between 1 and the number of rotor files)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  // the workers may run from another directory: every file is recorded by its absolute path
+  bool found = true;
+  if (plugboard_file)
+    found = !(job.plugboard_file = absolute_path(plugboard_file)).empty();
+  if (ngrams_file)
+    found = !(job.ngrams_file = absolute_path(ngrams_file)).empty() && found;
+  for (char * file : reflector_files) {
+    job.reflector_files.push_back(absolute_path(file));
+    found = !job.reflector_files.back().empty() && found;
+  }
+  for (int i = 0; i < num_of_rotor_files; i++) {
+    job.rotor_files.push_back(absolute_path(argv[2 + i]));
+    found = !job.rotor_files.back().empty() && found;
+  }
+  if (!found)
+    return ERROR_OPENING_CONFIGURATION_FILE;
+
+  // the configuration is checked once here rather than by every worker
+  JobParts parts;
+  int res = setup_job_parts(job, parts);
+  if (res != NO_ERROR)
+    return res;
+
+  char error_input;
+  ios::sync_with_stdio(false);
+  if ((res = read_letters(cin, job.ciphertext, error_input)) != NO_ERROR) {
+    cerr << error_input << " is not a valid input character "
+      << "(input characters must be upper case letters A-Z)!\n";
+    return res;
+  }
+  if (job.ciphertext.empty()) {
+    cerr << "The ciphertext is empty\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+  if ((res = write_job(argv[0], job)) != NO_ERROR)
+    return res;
+  cerr << "job " << argv[0] << ": " << job_num_of_tasks(job) << " tasks in " << job_num_of_shards(job) << " shards\n";
+  return NO_ERROR;
+}
+
+static int job_work(int argc, char** argv) {
+  int num_of_processes = 1;
+  bool options_ok = true;
+  while (argc > 1 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--processes") == 0)
+      num_of_processes = atoi(argv[1]);
+    else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+  if (!options_ok || argc != 1 || num_of_processes < 1) {
+    cerr << "usage: enigma job work [--processes P] job-dir\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  // every process is an independent worker: they only share the lock and progress files
+  cout.flush();
+  cerr.flush();
+  vector<pid_t> children;
+  for (int p = 1; p < num_of_processes; p++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      // a worker does not outlive the command that started it (its shard is resumed by the next run)
+      prctl(PR_SET_PDEATHSIG, SIGTERM);
+      children.clear();
+      break;
+    }
+    if (pid < 0) {
+      cerr << "Error starting worker process: " << strerror(errno) << endl;
+      break;
+    }
+    children.push_back(pid);
+  }
+
+  JobWorkerStats stats;
+  int res = run_job_worker(argv[0], stats);
+  cerr << "worker " << getpid() << ": " << stats.shards << " shards, " << stats.settings << " settings in "
+    << stats.seconds << " s (" << (stats.seconds > 0 ? stats.settings / stats.seconds : 0) << " settings/s)\n";
+
+  for (pid_t child : children) {
+    int status;
+    if (waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) != NO_ERROR && res == NO_ERROR)
+      res = WEXITSTATUS(status);
+  }
+  return res;
+}
+
+static int job_merge(int argc, char** argv) {
+  if (argc != 1) {
+    cerr << "usage: enigma job merge job-dir\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+  SearchJob job;
+  vector<JobCandidate> best;
+  JobStatus status;
+  int res = read_job(argv[0], job);
+  if (res == NO_ERROR)
+    res = merge_job(argv[0], job, best, status);
+  if (res != NO_ERROR)
+    return res;
+
+  for (JobCandidate const& candidate : best) {
+    cout << "score: " << candidate.score << "\nreflector: " << job.reflector_files[candidate.reflector] << "\nrotors:";
+    for (int r : candidate.rotor_order)
+      cout << ' ' << job.rotor_files[r];
+    cout << "\npositions:";
+    for (int p : candidate.starting_pos)
+      cout << ' ' << p;
+    cout << "\n\n";
+  }
+  cout.flush();
+  cerr << status.done << " of " << status.shards << " shards done, " << status.started << " in progress ("
+    << status.tasks_done << " of " << status.num_of_tasks << " tasks, "
+    << 100.0 * status.tasks_done / status.num_of_tasks << "%)\n";
+  return NO_ERROR;
+}
+
+int job_command(int argc, char** argv) {
+  // skip "job", then the action
+  argv++;
+  argc--;
+  char const* action = argc > 0 ? argv[0] : "";
+  if (strcmp(action, "init") == 0)
+    return job_init(argc - 1, argv + 1);
+  if (strcmp(action, "work") == 0)
+    return job_work(argc - 1, argv + 1);
+  if (strcmp(action, "merge") == 0)
+    return job_merge(argc - 1, argv + 1);
+  cerr << "usage: enigma job init [--shard-size S] [--keep K] [--plugboard file] [--ngrams table-file] --reflector file [--reflector file...]\n"
+    << "         job-dir num-of-rotors (<rotor-file>)+ < ciphertext\n"
+    << "       enigma job work [--processes P] job-dir\n"
+    << "       enigma job merge job-dir\n";
+  return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+}
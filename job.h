@@ -0,0 +1,136 @@
+#ifndef JOB_H
+#define JOB_H
+
+#include <string>
+#include <vector>
+#include "enigma.h"
+using namespace std;
+
+/* Number of tasks (reflector, rotor order, leftmost starting position) per shard unless specified otherwise */
+int const DEFAULT_JOB_SHARD_SIZE = 26;
+/* Number of best candidates kept per shard (and printed by merge) unless specified otherwise */
+int const DEFAULT_JOB_KEEP = 16;
+/* Minimum time (in seconds) between two progress files of a shard */
+double const JOB_CHECKPOINT_SECONDS = 1.0;
+
+/*
+  A keyspace search split into shards, as described by the "job" file of a job directory.
+  Every reflector, rotor order and starting position is scored by the fitness of its decryption of the ciphertext
+  (through the plugboard if there is one): the index of coincidence, or the n-gram fitness if an n-gram table is given.
+  The keyspace is cut into tasks: task t is reflector t / (num_of_orders * 26), rotor order (t / 26) % num_of_orders,
+  leftmost starting position t % 26, with the 26^(num_of_rotors - 1) positions of the other rotors. Shard s is tasks
+  [s * shard_size, (s + 1) * shard_size), so the shards only depend on the job file.
+*/
+struct SearchJob {
+  /* Configuration files, as absolute paths (an empty plugboard_file / ngrams_file means none) */
+  string plugboard_file, ngrams_file;
+  vector<string> reflector_files, rotor_files;
+  int num_of_rotors = 0;
+  int shard_size = DEFAULT_JOB_SHARD_SIZE;
+  int keep = DEFAULT_JOB_KEEP;
+  /* Letters (0-25) of the ciphertext, stored in the job directory */
+  vector<int> ciphertext;
+};
+
+/* A setting scored by a job */
+struct JobCandidate {
+  double score = 0;
+  /* Index into the reflector files of the job */
+  int reflector = 0;
+  /* Indices into the rotor files of the job, leftmost rotor first */
+  vector<int> rotor_order;
+  /* Starting position of each rotor, leftmost rotor first */
+  vector<int> starting_pos;
+};
+
+/*
+  The progress file of a shard (shard-N.best in the job directory), replaced atomically at each checkpoint:
+  the next task to run and the best candidates of the tasks before it
+*/
+struct ShardProgress {
+  long long shard = 0;
+  long long next_task = 0;
+  vector<JobCandidate> best;
+};
+
+/* Counters filled in by run_job_worker */
+struct JobWorkerStats {
+  long long shards = 0;
+  long long settings = 0;
+  double seconds = 0;
+};
+
+/* Progress of a whole job, filled in by merge_job */
+struct JobStatus {
+  long long shards = 0, done = 0, started = 0;
+  /* Number of tasks run, out of num_of_tasks */
+  long long tasks_done = 0, num_of_tasks = 0;
+};
+
+/* This function returns the number of tasks of a job (reflectors x rotor orders x 26) */
+long long job_num_of_tasks(SearchJob const& job);
+
+/* This function returns the number of shards of a job */
+long long job_num_of_shards(SearchJob const& job);
+
+/*
+  This function creates a job directory
+  - parameters: directory (created if it does not exist), job
+  - writes the job file and the ciphertext; an existing job is never overwritten
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int write_job(string const& directory, SearchJob const& job);
+
+/*
+  This function reads the job file and ciphertext of a job directory
+  - parameters: directory, job
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int read_job(string const& directory, SearchJob& job);
+
+/*
+  This function reads the progress file of a shard
+  - parameters: directory, job, shard, progress
+  - a shard that has not been started has no progress file: progress is then set to its first task
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int read_shard_progress(string const& directory, SearchJob const& job, long long shard, ShardProgress& progress);
+
+/*
+  This function replaces the progress file of a shard (written to a temporary file, then renamed)
+  - parameters: directory, progress
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int write_shard_progress(string const& directory, ShardProgress const& progress);
+
+/*
+  This function runs shards of a job until none is left to claim
+  - parameters: directory, stats
+  - a shard is claimed with an exclusive flock on its lock file (shard-N.lock), so any number of workers can
+    run on one host; the lock is released by the kernel if the worker dies
+  - a claimed shard resumes from its progress file, and its progress is saved at least every
+    JOB_CHECKPOINT_SECONDS, so a restarted worker only redoes the tasks after the last checkpoint
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int run_job_worker(string const& directory, JobWorkerStats& stats);
+
+/*
+  This function combines the progress files of all the shards of a job
+  - parameters: directory, job, best (the job's keep best candidates, best first), status
+  - shards still in progress contribute the candidates of their finished tasks
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int merge_job(string const& directory, SearchJob const& job, vector<JobCandidate>& best, JobStatus& status);
+
+/*
+  This function runs the "job" subcommand
+  - usage: enigma job init [--shard-size S] [--keep K] [--plugboard file] [--ngrams table-file] --reflector file
+             [--reflector file...] job-dir num-of-rotors (<rotor-file>)+ < ciphertext
+           enigma job work [--processes P] job-dir
+           enigma job merge job-dir
+  - parameters: argc, argv (argv[0] is "job")
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int job_command(int argc, char** argv);
+
+#endif
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <sys/stat.h>
+#include "keycache.h"
+#include "keyfile.h"
+#include "errors.h"
+using namespace std;
+
+/* This function names a key by its files and their metadata, without reading them */
+static int key_name(vector<string> const& key_files, string& name) {
+  name.clear();
+  bool key_file = false;
+  for (string const& file : key_files) {
+    name += file + '\n';
+    if (file == "--key") {
+      key_file = true;
+      continue;
+    }
+    struct stat st;
+    if (stat(file.c_str(), &st) != 0) {
+      cerr << "Error opening " << (key_file ? "key file " : "configuration file ") << file << endl;
+      return ERROR_OPENING_CONFIGURATION_FILE;
+    }
+    name += to_string(st.st_dev) + ':' + to_string(st.st_ino) + ':' + to_string(st.st_size) + ':'
+      + to_string(st.st_mtim.tv_sec) + '.' + to_string(st.st_mtim.tv_nsec) + '\n';
+  }
+  return NO_ERROR;
+}
+
+/* This function parses the files of a key into a machine */
+static int load_key(vector<string> const& key_files, Machine& machine) {
+  vector<char*> argv;
+  for (string const& file : key_files)
+    argv.push_back((char*) file.c_str());
+  if (key_files[0] == "--key")
+    return read_key_file(argv[1], machine);
+  // Machine::load takes the arguments of the enigma command: argv[0] is the program
+  argv.insert(argv.begin(), (char*) "enigma");
+  return machine.load(argv.size(), argv.data());
+}
+
+KeyCache::KeyCache (size_t capacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+void KeyCache::insert(string const& name, shared_ptr<Machine const> machine, bool compile_tried) {
+  lock_guard<mutex> guard(lock);
+  auto it = entries.find(name);
+  if (it != entries.end()) {
+    it->second.machine = machine;
+    it->second.compile_tried = it->second.compile_tried || compile_tried;
+    lru.splice(lru.begin(), lru, it->second.lru_pos);
+    return;
+  }
+  if (entries.size() >= capacity) {
+    entries.erase(lru.back());
+    lru.pop_back();
+  }
+  lru.push_front(name);
+  entries[name] = Entry{machine, compile_tried, lru.begin()};
+}
+
+int KeyCache::get(vector<string> const& key_files, bool compile, shared_ptr<Machine const>& machine) {
+  string name;
+  int res = key_name(key_files, name);
+  if (res != NO_ERROR)
+    return res;
+
+  shared_ptr<Machine const> cached;
+  {
+    lock_guard<mutex> guard(lock);
+    auto it = entries.find(name);
+    if (it != entries.end()) {
+      lru.splice(lru.begin(), lru, it->second.lru_pos);
+      cached = it->second.machine;
+      if (!compile || it->second.compile_tried) {
+        machine = cached;
+        return NO_ERROR;
+      }
+    }
+  }
+
+  if (!cached) {
+    shared_ptr<Machine> loaded = make_shared<Machine>();
+    if ((res = load_key(key_files, *loaded)) != NO_ERROR)
+      return res;
+    cached = loaded;
+  }
+  if (compile) {
+    // compiled as a copy, as the cached machine may be in use
+    shared_ptr<Machine> compiled = make_shared<Machine>(*cached);
+    compiled->compile();
+    cached = compiled;
+  }
+  insert(name, cached, compile);
+  machine = cached;
+  return NO_ERROR;
+}
+
+size_t KeyCache::size() {
+  lock_guard<mutex> guard(lock);
+  return entries.size();
+}
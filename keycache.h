@@ -0,0 +1,61 @@
+#ifndef KEYCACHE_H
+#define KEYCACHE_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "machine.h"
+using namespace std;
+
+/* Number of keys kept by a KeyCache unless specified otherwise */
+int const DEFAULT_KEY_CACHE_SIZE = 16;
+
+/*
+  A bounded, thread-safe cache of loaded (and compiled) keys, shared read-only by the
+  messages that use them. A key is named by its configuration files: their names and
+  what stat() says of them (device, inode, size and modification time), so that a hit
+  reads no file and a file changed on disk is loaded again.
+  The least recently used key is evicted first.
+*/
+class KeyCache {
+  /* Maximum number of keys held */
+  size_t capacity;
+  /* Key names in order of use, most recently used at the front */
+  list<string> lru;
+  struct Entry {
+    shared_ptr<Machine const> machine;
+    /* Set once the key has been compiled, even if its period was too long */
+    bool compile_tried;
+    list<string>::iterator lru_pos;
+  };
+  unordered_map<string, Entry> entries;
+  mutex lock;
+
+  /* This function adds a key (or replaces it), evicting the least recently used key when full */
+  void insert(string const& name, shared_ptr<Machine const> machine, bool compile_tried);
+
+  public:
+    /*
+      KeyCache constructor
+      - parameter: capacity (number of keys to keep)
+    */
+    KeyCache (size_t capacity = DEFAULT_KEY_CACHE_SIZE);
+    /*
+      This function returns the machine of a key, at its starting positions
+      - parameters: key_files (plugboard-file reflector-file (<rotor-file>)* rotor-positions,
+        or "--key" key-file), compile, machine
+      - on a hit, only the files' metadata is read: nothing is parsed or compiled
+      - on a miss, the files are loaded and the machine is cached
+      - with compile, the machine is compiled (see Machine::compile) the first time it is asked for:
+        a key whose period is too long is cached uncompiled, and never walked through again
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise (nothing is cached on error)
+    */
+    int get(vector<string> const& key_files, bool compile, shared_ptr<Machine const>& machine);
+    /* This function returns the number of keys held */
+    size_t size();
+};
+
+#endif
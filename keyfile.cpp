@@ -0,0 +1,136 @@
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "keyfile.h"
+#include "fileheader.h"
+#include "errors.h"
+using namespace std;
+
+static uint32_t checksum(unsigned char const data[], size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+int write_key_file(char * key_file, Machine& machine) {
+  int const TAC = TOTAL_ALPHABET_COUNT;
+  int num_of_rotors = machine.get_num_of_rotors();
+  vector<unsigned char> payload(2 * TAC + num_of_rotors * sizeof(KeyFileRotor));
+
+  int const* pb_map = machine.get_plugboard().get_mapping();
+  int const* rf_map = machine.get_reflector().get_mapping();
+  for (int i = 0; i < TAC; i++) {
+    payload[i] = pb_map[i];
+    payload[TAC + i] = rf_map[i];
+  }
+  for (int r = 0; r < num_of_rotors; r++) {
+    Rotor const* rotor = machine.get_rotors()[r];
+    KeyFileRotor record = {};
+    int const* wiring = rotor->get_mapping();
+    for (int i = 0; i < TAC; i++)
+      record.wiring[i] = wiring[i];
+    record.starting_pos = machine.get_starting_pos()[r];
+    record.notch_mask = rotor->get_notch_mask();
+    memcpy(&payload[2 * TAC + r * sizeof(KeyFileRotor)], &record, sizeof(record));
+  }
+
+  KeyFileHeader header;
+  memcpy(header.magic, KEY_FILE_MAGIC, sizeof(header.magic));
+  header.version = KEY_FILE_VERSION;
+  header.num_of_rotors = num_of_rotors;
+  header.checksum = checksum(payload.data(), payload.size());
+
+  ofstream out(key_file, ios::binary | ios::trunc);
+  if (!out) {
+    cerr << "Error opening key file " << key_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  out.write((char const*) &header, sizeof(header));
+  out.write((char const*) payload.data(), payload.size());
+  out.close();
+  if (!out) {
+    cerr << "Error writing key file " << key_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  return NO_ERROR;
+}
+
+int read_key_file(char * key_file, Machine& machine) {
+  int const TAC = TOTAL_ALPHABET_COUNT;
+  int fd = open(key_file, O_RDONLY);
+  struct stat file_stat;
+  if (fd < 0 || fstat(fd, &file_stat) != 0) {
+    cerr << "Error opening key file " << key_file << endl;
+    if (fd >= 0)
+      close(fd);
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  size_t size = file_stat.st_size;
+  void* mapped = size >= sizeof(KeyFileHeader) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    cerr << "Invalid key file " << key_file << " (too short)\n";
+    return INVALID_KEY_FILE;
+  }
+
+  unsigned char const* data = (unsigned char const*) mapped;
+  KeyFileHeader header;
+  memcpy(&header, data, sizeof(header));
+  unsigned char const* payload = data + sizeof(header);
+  size_t payload_size = size - sizeof(header);
+
+  int res = check_file_header(header.magic, header.version, KEY_FILE_MAGIC, KEY_FILE_VERSION, "key file", key_file, INVALID_KEY_FILE);
+  if (res == NO_ERROR && (header.num_of_rotors > payload_size || payload_size != 2 * TAC + header.num_of_rotors * sizeof(KeyFileRotor)
+      || checksum(payload, payload_size) != header.checksum)) {
+    cerr << "Invalid key file " << key_file << " (truncated or corrupted)\n";
+    res = INVALID_KEY_FILE;
+  }
+
+  Plugboard pb(key_file);
+  Reflector rf(key_file);
+  vector<Rotor> rotors;
+  vector<int> starting_pos;
+  if (res == NO_ERROR)
+    res = pb.setup(payload);
+  if (res == NO_ERROR)
+    res = rf.setup(payload + TAC);
+  for (uint32_t r = 0; res == NO_ERROR && r < header.num_of_rotors; r++) {
+    KeyFileRotor record;
+    memcpy(&record, payload + 2 * TAC + r * sizeof(KeyFileRotor), sizeof(record));
+    rotors.push_back(Rotor(key_file));
+    res = rotors.back().setup(record.wiring, record.notch_mask);
+    if (res == NO_ERROR && record.starting_pos >= TAC) {
+      cerr << "Invalid index in key file: " << key_file << " (starting position should be between 0-25)\n";
+      res = INVALID_INDEX;
+    }
+    starting_pos.push_back(record.starting_pos);
+  }
+  munmap(mapped, size);
+
+  if (res == NO_ERROR)
+    machine.load(pb, rf, rotors, starting_pos);
+  return res;
+}
+
+int compile_key_command(int argc, char** argv) {
+  if (argc < 1 + MIN_PARAMETERS) {
+    cerr << "usage: enigma compile-key key-file plugboard-file reflector-file (<rotor-file>)* rotor-positions\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+  // drop "compile-key" so that argv[1] is the plugboard file, as for the enigma command
+  char * key_file = argv[1];
+  argv++;
+  argc--;
+  Machine machine;
+  int res = machine.load(argc, argv);
+  if (res == NO_ERROR)
+    res = write_key_file(key_file, machine);
+  return res;
+}
@@ -0,0 +1,59 @@
+#ifndef KEYFILE_H
+#define KEYFILE_H
+
+#include <cstdint>
+#include "machine.h"
+using namespace std;
+
+/* 
+  Binary key file format (host byte order, see fileheader.h):
+  - KeyFileHeader
+  - plugboard lookup table (26 bytes), reflector lookup table (26 bytes)
+  - one KeyFileRotor per rotor, leftmost first
+  The checksum covers everything after the header.
+*/
+char const KEY_FILE_MAGIC[4] = {'E', 'N', 'G', 'K'};
+uint32_t const KEY_FILE_VERSION = 1;
+
+struct KeyFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t num_of_rotors;
+  /* 32-bit FNV-1a of the rest of the file */
+  uint32_t checksum;
+};
+
+struct KeyFileRotor {
+  /* Forward wiring at offset 0 */
+  uint8_t wiring[TOTAL_ALPHABET_COUNT];
+  uint8_t starting_pos;
+  uint8_t reserved;
+  /* Bit N set if there is a notch at N */
+  uint32_t notch_mask;
+};
+
+/* 
+  This function writes a machine, at its starting positions, to a binary key file
+  - parameters: key file, machine
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int write_key_file(char * key_file, Machine& machine);
+
+/* 
+  This function loads a machine from a binary key file
+  - parameters: key file, machine
+  - the file is memory-mapped and checked (header, checksum and tables) without any text parsing
+  - returns an integer: 0 if NO _ERROR, INVALID_KEY_FILE or another error code otherwise
+*/
+int read_key_file(char * key_file, Machine& machine);
+
+/* 
+  This function runs the "compile-key" subcommand
+  - usage: enigma compile-key key-file plugboard-file reflector-file (<rotor-file>)* rotor-positions
+  - parameters: argc, argv (argv[0] is "compile-key")
+  - the configuration files are parsed and checked as by the enigma command (same error codes)
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int compile_key_command(int argc, char** argv);
+
+#endif
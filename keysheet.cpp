@@ -0,0 +1,212 @@
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "keysheet.h"
+#include "errors.h"
+using namespace std;
+
+Reflector const* KeySheet::get_reflector(string const& file, int& res) {
+  auto it = reflectors.find(file);
+  if (it == reflectors.end()) {
+    it = reflectors.emplace(file, nullptr).first;
+    it->second.reset(new Reflector((char *) it->first.c_str()));
+    if ((res = it->second->setup()) != NO_ERROR) {
+      reflectors.erase(it);
+      return NULL;
+    }
+  }
+  return it->second.get();
+}
+
+Rotor const* KeySheet::get_rotor(string const& file, int& res) {
+  auto it = rotors.find(file);
+  if (it == rotors.end()) {
+    it = rotors.emplace(file, nullptr).first;
+    it->second.reset(new Rotor((char *) it->first.c_str()));
+    if ((res = it->second->setup()) != NO_ERROR) {
+      rotors.erase(it);
+      return NULL;
+    }
+  }
+  return it->second.get();
+}
+
+int KeySheet::add_key(string const& text, int line, char * sheet_file) {
+  istringstream words(text);
+  string id, word;
+  words >> id;
+  vector<string> files;
+  vector<int> starting_pos;
+  unsigned char pb_map[TOTAL_ALPHABET_COUNT];
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i++)
+    pb_map[i] = i;
+
+  // files, then positions, then pairs
+  int res = NO_ERROR;
+  bool has_pairs = false;
+  while (words >> word) {
+    bool is_number = word.find_first_not_of("0123456789") == string::npos;
+    bool is_pair = word.size() == 2 && isupper((unsigned char) word[0]) && isupper((unsigned char) word[1]);
+    if (is_pair) {
+      int a = word[0] - 'A', b = word[1] - 'A';
+      if (a == b || pb_map[a] != a || pb_map[b] != b) {
+        cerr << "Impossible plugboard pair " << word << " in key sheet " << sheet_file << " line " << line << endl;
+        return IMPOSSIBLE_PLUGBOARD_CONFIGURATION;
+      }
+      pb_map[a] = b;
+      pb_map[b] = a;
+      has_pairs = true;
+    } else if (is_number && !has_pairs) {
+      starting_pos.push_back(atoi(word.c_str()));
+      if (starting_pos.back() >= TOTAL_ALPHABET_COUNT) {
+        cerr << "Invalid starting position " << word << " in key sheet " << sheet_file << " line " << line << endl;
+        return INVALID_INDEX;
+      }
+    } else if (starting_pos.empty() && !has_pairs) {
+      files.push_back(word);
+    } else {
+      cerr << "Unexpected " << word << " in key sheet " << sheet_file << " line " << line 
+        << " (key-id reflector-file (<rotor-file>)* (<starting-position>)* (<plugboard-pair>)*)\n";
+      return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+    }
+  }
+  if (files.empty()) {
+    cerr << "No reflector in key sheet " << sheet_file << " line " << line << endl;
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+  if (starting_pos.size() != files.size() - 1) {
+    cerr << "No starting position for some rotor in key sheet " << sheet_file << " line " << line << endl;
+    return NO_ROTOR_STARTING_POSITION;
+  }
+  if (keys.count(id)) {
+    cerr << "Duplicate key id " << id << " in key sheet " << sheet_file << " line " << line << endl;
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  Reflector const* rf = get_reflector(files[0], res);
+  if (!rf)
+    return res;
+  vector<Rotor> key_rotors;
+  for (size_t i = 1; i < files.size(); i++) {
+    Rotor const* rotor = get_rotor(files[i], res);
+    if (!rotor)
+      return res;
+    key_rotors.push_back(*rotor);
+  }
+  Plugboard pb(NULL);
+  if ((res = pb.setup(pb_map)) != NO_ERROR)
+    return res;
+  keys[id].load(pb, *rf, key_rotors, starting_pos);
+  return NO_ERROR;
+}
+
+int KeySheet::load(char * sheet_file) {
+  ifstream in(sheet_file);
+  if (!in) {
+    cerr << "Error opening key sheet " << sheet_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  string text;
+  for (int line = 1; getline(in, text); line++) {
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == string::npos || text[first] == '#')
+      continue;
+    int res = add_key(text, line, sheet_file);
+    if (res != NO_ERROR)
+      return res;
+  }
+  return NO_ERROR;
+}
+
+Machine* KeySheet::get_key(string const& id, size_t message_length) {
+  auto it = keys.find(id);
+  if (it == keys.end())
+    return NULL;
+  it->second.reset();
+  // short messages are not worth a compile of their own: only a key in heavy use is compiled
+  long long& letters = key_letters[id];
+  letters += message_length;
+  if (letters > BLOCK_SIZE)
+    it->second.compile();
+  return &it->second;
+}
+
+size_t KeySheet::size() const {
+  return keys.size();
+}
+
+int keysheet_command(int argc, char** argv) {
+  bool print_stats = false;
+  // skip "keysheet", then the options
+  argv++;
+  argc--;
+  if (argc > 0 && strcmp(argv[0], "--stats") == 0) {
+    print_stats = true;
+    argv++;
+    argc--;
+  }
+  if (argc != 1) {
+    cerr << "usage: enigma keysheet [--stats] key-sheet-file < messages (one per line: key-id message)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  auto start_time = chrono::steady_clock::now();
+  KeySheet sheet;
+  int res = sheet.load(argv[0]);
+  if (res != NO_ERROR)
+    return res;
+  auto setup_time = chrono::steady_clock::now();
+
+  ios::sync_with_stdio(false);
+  int first_error = NO_ERROR;
+  long long messages = 0, letters = 0;
+  string text, id;
+  vector<char> output;
+  for (int line = 1; getline(cin, text); line++) {
+    size_t id_start = text.find_first_not_of(" \t\r");
+    if (id_start == string::npos)
+      continue;
+    size_t id_end = text.find_first_of(" \t", id_start);
+    id = text.substr(id_start, id_end == string::npos ? string::npos : id_end - id_start);
+    size_t message_start = id_end == string::npos ? text.size() : id_end;
+
+    Machine* key = sheet.get_key(id, text.size() - message_start);
+    char error_input = 0;
+    size_t output_length = 0;
+    res = NO_ERROR;
+    if (!key) {
+      cerr << "line " << line << ": unknown key " << id << endl;
+      res = UNKNOWN_KEY_ID;
+    } else {
+      output.resize(text.size() - message_start);
+      res = key->encrypt(text.data() + message_start, text.size() - message_start, output.data(), output_length, error_input);
+      if (res == INVALID_INPUT_CHARACTER)
+        cerr << "line " << line << ": " << error_input << " is not a valid input character "
+          << "(input characters must be upper case letters A-Z)!\n";
+    }
+
+    cout << id << ' ';
+    if (res == NO_ERROR)
+      cout.write(output.data(), output_length);
+    else {
+      cout << '!';
+      if (first_error == NO_ERROR)
+        first_error = res;
+    }
+    cout << '\n';
+    messages++;
+    letters += output_length;
+  }
+  cout.flush();
+
+  if (print_stats) {
+    double setup_secs = chrono::duration<double>(setup_time - start_time).count();
+    double run_secs = chrono::duration<double>(chrono::steady_clock::now() - setup_time).count();
+    cerr << "setup: " << sheet.size() << " keys in " << setup_secs * 1e3 << " ms\n"
+      << "run: " << messages << " messages, " << letters << " letters in " << run_secs << " s ("
+      << (run_secs > 0 ? messages / run_secs : 0) << " messages/s)\n";
+  }
+  return first_error;
+}
@@ -0,0 +1,65 @@
+#ifndef KEYSHEET_H
+#define KEYSHEET_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include "enigma.h"
+#include "machine.h"
+using namespace std;
+
+/* 
+  A key sheet: many keys, each loaded once and then reset to its starting positions for every message.
+  Key sheet file, one key per line (blank lines and lines starting with '#' are skipped):
+    key-id reflector-file (<rotor-file>)* (<starting-position>)* (<plugboard-pair>)*
+  e.g.
+    day1 reflectors/I.rf rotors/I.rot rotors/II.rot rotors/III.rot 0 5 12 AB CD EF
+  - one starting position (0-25) per rotor, leftmost first
+  - plugboard pairs are two upper case letters each
+  Every reflector and rotor file is parsed once, however many keys use it.
+*/
+class KeySheet {
+  /* Parsed configuration files, by file name (a Rotor / Reflector keeps a pointer to its name) */
+  map<string, unique_ptr<Reflector>> reflectors;
+  map<string, unique_ptr<Rotor>> rotors;
+  map<string, Machine> keys;
+  /* Number of letters given to each key so far (see get_key) */
+  map<string, long long> key_letters;
+
+  /* These functions return a configuration file set up once, or NULL (and the error in res) */
+  Reflector const* get_reflector(string const& file, int& res);
+  Rotor const* get_rotor(string const& file, int& res);
+  /* This function parses one line of a key sheet into a key */
+  int add_key(string const& text, int line, char * sheet_file);
+
+  public:
+    /* 
+      This function loads a key sheet file
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int load(char * sheet_file);
+    /* 
+      This function returns the key with this id, at its starting positions, or NULL if there is none
+      - parameters: id, message_length (of the message about to be processed with the key)
+      - the reset is O(1) per rotor (see Machine::seek): no file is read
+      - a key is compiled (see Machine::compile) once its messages add up to more than a block,
+        and kept compiled for the messages after that
+    */
+    Machine* get_key(string const& id, size_t message_length = 0);
+    /* This function returns the number of keys of the sheet */
+    size_t size() const;
+};
+
+/* 
+  This function runs the "keysheet" subcommand
+  - usage: enigma keysheet [--stats] key-sheet-file < messages
+  - parameters: argc, argv (argv[0] is "keysheet")
+  - every input line is a key id followed by a message; it is written out as the key id followed by the
+    message encoded / decoded from that key's starting positions
+  - a line with an unknown key or an invalid character is reported on stderr (as "key-id !" on stdout)
+    and the following lines are still processed
+  - returns an integer: 0 if NO _ERROR, the error code of the first failed line otherwise
+*/
+int keysheet_command(int argc, char** argv);
+
+#endif
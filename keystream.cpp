@@ -0,0 +1,106 @@
+#include <iostream>
+#include "keystream.h"
+#include "instrument.h"
+#include "errors.h"
+using namespace std;
+
+/**************************** Keystream ****************************/
+
+// copies of the rotors, so that the caller's rotors keep their positions
+static void copy_rotors(int num_of_rotors, Rotor** rotors_ptr, vector<Rotor>& rotors, vector<Rotor*>& copies_ptr) {
+  rotors.reserve(num_of_rotors);
+  for (int i=0; i < num_of_rotors; i++) {
+    rotors.push_back(*rotors_ptr[i]);
+    copies_ptr.push_back(&rotors[i]);
+  }
+}
+
+void Keystream::fill(Plugboard& pb, Reflector& rf, int num_of_rotors, Rotor** rotors_ptr, int num_of_steps) {
+  vector<Rotor> rotors;
+  vector<Rotor*> copies_ptr;
+  copy_rotors(num_of_rotors, rotors_ptr, rotors, copies_ptr);
+
+  int dummy = 0;
+  period = num_of_steps;
+  table.assign((size_t) num_of_steps * TOTAL_ALPHABET_COUNT, 0);
+  for (int step = 0; step < num_of_steps; step++) {
+    // the rotors step before each letter is mapped
+    if (num_of_rotors > 0)
+      rotors_processing(dummy, num_of_rotors, copies_ptr.data(), false);
+
+    for (int letter = 0; letter < TOTAL_ALPHABET_COUNT; letter++) {
+      int mapped = letter;
+      pb.process_input(mapped);
+      for (int i = num_of_rotors - 1; i >= 0; i--)
+        rotors[i].process_input(mapped);
+      rf.process_input(mapped);
+      if (num_of_rotors > 0)
+        rotors_processing(mapped, num_of_rotors, copies_ptr.data(), true);
+      pb.process_input(mapped);
+      table[(size_t) step * TOTAL_ALPHABET_COUNT + letter] = mapped;
+    }
+  }
+}
+
+bool Keystream::compile(Plugboard& pb, Reflector& rf, int num_of_rotors, Rotor** rotors_ptr) {
+  vector<Rotor> rotors;
+  vector<Rotor*> copies_ptr;
+  copy_rotors(num_of_rotors, rotors_ptr, rotors, copies_ptr);
+
+  // the stepping is a bijection on the rotor positions, so the machine
+  // always comes back to the starting positions; find out when
+  int new_period = 1, dummy = 0;
+  if (num_of_rotors > 0) {
+    for (new_period = 1; new_period <= MAX_KEYSTREAM_PERIOD; new_period++) {
+      rotors_processing(dummy, num_of_rotors, copies_ptr.data(), false);
+      bool back_at_start = true;
+      for (int i=0; i < num_of_rotors && back_at_start; i++)
+        back_at_start = rotors[i].get_offset() == rotors_ptr[i]->get_offset();
+      if (back_at_start)
+        break;
+    }
+    if (new_period > MAX_KEYSTREAM_PERIOD)
+      return false;
+  }
+
+  fill(pb, rf, num_of_rotors, rotors_ptr, new_period);
+  return true;
+}
+
+void Keystream::compile_steps(Plugboard& pb, Reflector& rf, int num_of_rotors, Rotor** rotors_ptr, int num_of_steps) {
+  fill(pb, rf, num_of_rotors, rotors_ptr, num_of_steps > 0 ? num_of_steps : 1);
+}
+
+int Keystream::get_period() const {
+  return period;
+}
+
+unsigned char const* Keystream::substitution(long long step) const {
+  return &table[(size_t) (step % period) * TOTAL_ALPHABET_COUNT];
+}
+
+int Keystream::process_block(char const input[], int input_length, char output[], int& output_length, long long& step, char& error_input) const {
+  unsigned char const* base = table.data();
+  int row = step % period;
+#ifdef ENIGMA_INSTRUMENT
+  long long const first_step = step;
+#endif
+
+  for (int i=0; i < input_length; i++) {
+    if (isspace((unsigned char) input[i]))
+      continue;
+
+    if (input[i] < 'A' || input[i] > 'Z') {
+      error_input = input[i];
+      INSTRUMENT_KEYSTREAM(step - first_step);
+      return INVALID_INPUT_CHARACTER;
+    }
+
+    output[output_length++] = base[row * TOTAL_ALPHABET_COUNT + input[i] - 'A'] + 'A';
+    if (++row == period)
+      row = 0;
+    step++;
+  }
+  INSTRUMENT_KEYSTREAM(step - first_step);
+  return NO_ERROR;
+}
@@ -0,0 +1,57 @@
+#ifndef KEYSTREAM_H
+#define KEYSTREAM_H
+
+#include <vector>
+#include "enigma.h"
+using namespace std;
+
+/* 
+  Longest period (in steps) that will be compiled into a Keystream
+  i.e. every setting of up to 3 rotors (26 * 26 * 26 steps, 26 bytes each)
+*/
+int const MAX_KEYSTREAM_PERIOD = TOTAL_ALPHABET_COUNT * TOTAL_ALPHABET_COUNT * TOTAL_ALPHABET_COUNT;
+
+class Keystream {
+  /* Number of steps after which the rotors are back at their starting positions */
+  int period = 0;
+  /* 
+    period * 26 entries: table[step * 26 + letter] is the letter that the whole machine 
+    (plugboard -> rotors -> reflector -> rotors -> plugboard) maps letter to at that step
+  */
+  vector<unsigned char> table;
+  /* This function fills the table with the first num_of_steps steps from the current rotor positions */
+  void fill(Plugboard& pb, Reflector& rf, int num_of_rotors, Rotor** rotors_ptr, int num_of_steps);
+
+  public:
+    /* 
+      This function walks the machine through one full period from the current rotor positions
+      - parameters: plugboard, reflector, num_of_rotors, pointer to an array of rotors
+      - the rotors themselves are not modified (copies of them are stepped)
+      - step 0 of the table is the substitution used for the next letter to be processed
+      - returns false if the period is longer than MAX_KEYSTREAM_PERIOD (nothing is compiled)
+    */
+    bool compile(Plugboard& pb, Reflector& rf, int num_of_rotors, Rotor** rotors_ptr);
+    /* 
+      This function compiles only the first num_of_steps steps from the current rotor positions
+      - parameters: as compile, plus num_of_steps (e.g. the length of a ciphertext under analysis)
+      - get_period() then returns num_of_steps: substitution() must only be used with step < num_of_steps
+    */
+    void compile_steps(Plugboard& pb, Reflector& rf, int num_of_rotors, Rotor** rotors_ptr, int num_of_steps);
+    /* This function returns the period of the compiled machine (0 if not compiled) */
+    int get_period() const;
+    /* 
+      This function returns the 26-letter substitution used at the given step
+      - parameter: step (0 is the first letter after compile), may exceed the period
+    */
+    unsigned char const* substitution(long long step) const;
+    /* 
+      This function encodes / decodes a block of input with the compiled table
+      - parameters: as process_block, plus step (the number of letters processed so far)
+      - step is incremented for every letter written to the output array
+      - whitespace is skipped and invalid characters are reported in the same way as process_block
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int process_block(char const input[], int input_length, char output[], int& output_length, long long& step, char& error_input) const;
+};
+
+#endif
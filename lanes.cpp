@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <vector>
+#include "lanes.h"
+#include "errors.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LANES_X86
+#endif
+using namespace std;
+
+/* Number of table entries per rotor in a lane's block: forward then backward wiring */
+static int const ROTOR_BLOCK = 2 * TOTAL_ALPHABET_COUNT;
+
+/* 
+  The state of up to NUM_OF_LANES machines stepped together. Keys with fewer
+  rotors than num_of_rotors are padded on the left with identity rotors that
+  have no notch, which neither change the mapping nor step any other rotor.
+*/
+struct LaneGroup {
+  int num_of_lanes = 0;
+  int num_of_rotors = 0;
+  int max_length = 0;
+  int length[NUM_OF_LANES] = {};
+  /* 
+    Tables of all lanes, one block per lane: plugboard, reflector, then 
+    forward/backward wiring of each rotor (26 entries each)
+  */
+  vector<int> tables;
+  /* Index of the first entry of each lane's block in tables */
+  int base[NUM_OF_LANES] = {};
+  /* offset[r * NUM_OF_LANES + lane] and notch_mask[...] of rotor r */
+  vector<int> offset;
+  vector<int> notch_mask;
+  /* Letters transposed: letters[t * NUM_OF_LANES + lane] is letter t of the lane's message */
+  vector<unsigned char> letters;
+};
+
+// copies the keys of the messages into the lanes and transposes their letters
+static void load_group(LaneGroup& group, BatchMessage* lane_messages[], int num_of_lanes) {
+  int const TAC = TOTAL_ALPHABET_COUNT;
+  group.num_of_lanes = num_of_lanes;
+  group.num_of_rotors = 0;
+  group.max_length = 0;
+  for (int lane = 0; lane < num_of_lanes; lane++) {
+    group.num_of_rotors = max(group.num_of_rotors, lane_messages[lane]->key->num_of_rotors);
+    group.max_length = max(group.max_length, lane_messages[lane]->output_length);
+  }
+
+  int const R = group.num_of_rotors, block = 2 * TAC + R * ROTOR_BLOCK;
+  // every entry that matters is overwritten below, so the buffers are only resized
+  group.tables.resize(NUM_OF_LANES * block);
+  group.offset.assign(max(R, 1) * NUM_OF_LANES, 0);
+  group.notch_mask.assign(max(R, 1) * NUM_OF_LANES, 0);
+  group.letters.resize((size_t) group.max_length * NUM_OF_LANES);
+
+  for (int lane = 0; lane < NUM_OF_LANES; lane++) {
+    int* table = &group.tables[lane * block];
+    group.base[lane] = lane * block;
+    group.length[lane] = 0;
+    // unused lanes run an identity machine, padded rotors are identity rotors
+    int padding = lane < num_of_lanes ? R - lane_messages[lane]->key->num_of_rotors : R;
+    int identity_entries = lane < num_of_lanes ? 2 * TAC + padding * ROTOR_BLOCK : block;
+    for (int i=0, letter=0; i < identity_entries; i++) {
+      table[i] = letter;
+      if (++letter == TAC)
+        letter = 0;
+    }
+    if (lane >= num_of_lanes)
+      continue;
+
+    BatchKey const* key = lane_messages[lane]->key;
+    int const* pb = key->pb->get_mapping();
+    int const* rf = key->rf->get_mapping();
+    copy(pb, pb + TAC, table);
+    copy(rf, rf + TAC, table + TAC);
+
+    for (int r = padding; r < R; r++) {
+      Rotor const* rotor = key->rotors_ptr[r - padding];
+      int const* forward = rotor->get_mapping(false);
+      int const* backward = rotor->get_mapping(true);
+      copy(forward, forward + TAC, table + 2 * TAC + r * ROTOR_BLOCK);
+      copy(backward, backward + TAC, table + 2 * TAC + r * ROTOR_BLOCK + TAC);
+      group.offset[r * NUM_OF_LANES + lane] = rotor->get_offset();
+      group.notch_mask[r * NUM_OF_LANES + lane] = rotor->get_notch_mask();
+    }
+
+    // the message's letter codes were compacted into its output array
+    BatchMessage* message = lane_messages[lane];
+    group.length[lane] = message->output_length;
+    for (int t = 0; t < message->output_length; t++)
+      group.letters[(size_t) t * NUM_OF_LANES + lane] = message->output[t];
+  }
+}
+
+// steps and maps every lane one letter at a time
+static void run_group_scalar(LaneGroup& group) {
+  int const TAC = TOTAL_ALPHABET_COUNT, R = group.num_of_rotors;
+  int const* tables = group.tables.data();
+
+  for (int lane = 0; lane < group.num_of_lanes; lane++) {
+    int const* pb = tables + group.base[lane];
+    int const* rf = pb + TAC;
+    int offset[R > 0 ? R : 1];
+    for (int r = 0; r < R; r++)
+      offset[r] = group.offset[r * NUM_OF_LANES + lane];
+
+    for (int t = 0; t < group.length[lane]; t++) {
+      // the rightmost rotor always rotates, the others when the one on their right hits a notch
+      bool carry = true;
+      for (int r = R - 1; r >= 0 && carry; r--) {
+        if (++offset[r] == TAC)
+          offset[r] = 0;
+        carry = (group.notch_mask[r * NUM_OF_LANES + lane] >> offset[r]) & 1;
+      }
+
+      unsigned char& letter = group.letters[(size_t) t * NUM_OF_LANES + lane];
+      int x = pb[letter];
+      for (int r = R - 1; r >= 0; r--) {
+        int const* forward = rf + TAC + r * ROTOR_BLOCK;
+        int shifted = x + offset[r];
+        if (shifted >= TAC)
+          shifted -= TAC;
+        x = forward[shifted] - offset[r];
+        if (x < 0)
+          x += TAC;
+      }
+      x = rf[x];
+      for (int r = 0; r < R; r++) {
+        int const* backward = rf + 2 * TAC + r * ROTOR_BLOCK;
+        int shifted = x + offset[r];
+        if (shifted >= TAC)
+          shifted -= TAC;
+        x = backward[shifted] - offset[r];
+        if (x < 0)
+          x += TAC;
+      }
+      letter = pb[x];
+    }
+  }
+}
+
+#ifdef LANES_X86
+// maps every lane's letter x through the 26-entry table at base + x
+__attribute__((target("avx2")))
+static inline __m256i lookup(int const* tables, __m256i base, __m256i x) {
+  return _mm256_i32gather_epi32(tables, _mm256_add_epi32(base, x), 4);
+}
+
+// maps every lane's letter through a rotor at the lanes' offsets
+__attribute__((target("avx2")))
+static inline __m256i rotor_lookup(int const* tables, __m256i base, __m256i x, __m256i offset) {
+  __m256i const max_letter = _mm256_set1_epi32(TOTAL_ALPHABET_COUNT - 1);
+  __m256i const count = _mm256_set1_epi32(TOTAL_ALPHABET_COUNT);
+  __m256i shifted = _mm256_add_epi32(x, offset);
+  shifted = _mm256_sub_epi32(shifted, _mm256_and_si256(_mm256_cmpgt_epi32(shifted, max_letter), count));
+  __m256i mapped = _mm256_sub_epi32(lookup(tables, base, shifted), offset);
+  return _mm256_add_epi32(mapped, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), mapped), count));
+}
+
+// steps and maps all lanes together, one 32-bit lane per machine
+__attribute__((target("avx2")))
+static void run_group_avx2(LaneGroup& group) {
+  // each register holds 8 lanes; the stages of both registers are
+  // interleaved so that one register's gathers hide the other's latency
+  int const TAC = TOTAL_ALPHABET_COUNT, R = group.num_of_rotors, H = NUM_OF_LANES / 8;
+  int const* tables = group.tables.data();
+  __m256i const one = _mm256_set1_epi32(1);
+  __m256i const max_letter = _mm256_set1_epi32(TAC - 1);
+  __m256i const count = _mm256_set1_epi32(TAC);
+
+  __m256i pb[H], rf[H];
+  __m256i offset[R > 0 ? R : 1][H], notch_mask[R > 0 ? R : 1][H], forward[R > 0 ? R : 1][H], backward[R > 0 ? R : 1][H];
+  for (int h = 0; h < H; h++) {
+    pb[h] = _mm256_loadu_si256((__m256i const*) &group.base[h * 8]);
+    rf[h] = _mm256_add_epi32(pb[h], count);
+    for (int r = 0; r < R; r++) {
+      offset[r][h] = _mm256_loadu_si256((__m256i const*) &group.offset[r * NUM_OF_LANES + h * 8]);
+      notch_mask[r][h] = _mm256_loadu_si256((__m256i const*) &group.notch_mask[r * NUM_OF_LANES + h * 8]);
+      forward[r][h] = _mm256_add_epi32(pb[h], _mm256_set1_epi32(2 * TAC + r * ROTOR_BLOCK));
+      backward[r][h] = _mm256_add_epi32(forward[r][h], count);
+    }
+  }
+
+  for (int t = 0; t < group.max_length; t++) {
+    unsigned char* letters = &group.letters[(size_t) t * NUM_OF_LANES];
+    __m256i x[H];
+
+    for (int h = 0; h < H; h++) {
+      __m256i carry = one;
+      for (int r = R - 1; r >= 0; r--) {
+        offset[r][h] = _mm256_add_epi32(offset[r][h], carry);
+        offset[r][h] = _mm256_sub_epi32(offset[r][h], _mm256_and_si256(_mm256_cmpgt_epi32(offset[r][h], max_letter), count));
+        carry = _mm256_and_si256(carry, _mm256_srlv_epi32(notch_mask[r][h], offset[r][h]));
+      }
+      x[h] = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*) &letters[h * 8]));
+      x[h] = lookup(tables, pb[h], x[h]);
+    }
+    for (int r = R - 1; r >= 0; r--)
+      for (int h = 0; h < H; h++)
+        x[h] = rotor_lookup(tables, forward[r][h], x[h], offset[r][h]);
+    for (int h = 0; h < H; h++)
+      x[h] = lookup(tables, rf[h], x[h]);
+    for (int r = 0; r < R; r++)
+      for (int h = 0; h < H; h++)
+        x[h] = rotor_lookup(tables, backward[r][h], x[h], offset[r][h]);
+
+    for (int h = 0; h < H; h++) {
+      x[h] = lookup(tables, pb[h], x[h]);
+      // pack the 8 letters (0-25) of the register back into bytes
+      __m128i packed = _mm_packus_epi16(_mm_packus_epi32(_mm256_castsi256_si128(x[h]), _mm256_extracti128_si256(x[h], 1)), _mm_setzero_si128());
+      _mm_storel_epi64((__m128i*) &letters[h * 8], packed);
+    }
+  }
+}
+#endif
+
+bool batch_simd_supported() {
+#ifdef LANES_X86
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+// validates a message and compacts its letter codes (0-25) into its output array
+static int compact_message(BatchMessage& message) {
+  message.output_length = 0;
+  message.error = NO_ERROR;
+  for (int i=0; i < message.input_length; i++) {
+    char ch = message.input[i];
+    if (ch >= 'A' && ch <= 'Z')
+      message.output[message.output_length++] = ch - 'A';
+    else if (!isspace((unsigned char) ch)) {
+      message.error = INVALID_INPUT_CHARACTER;
+      message.error_input = ch;
+      break;
+    }
+  }
+  return message.error;
+}
+
+int encrypt_batch(BatchMessage messages[], int num_of_messages, bool use_simd) {
+  int res = NO_ERROR;
+  vector<BatchMessage*> order(num_of_messages);
+  for (int i=0; i < num_of_messages; i++) {
+    int message_res = compact_message(messages[i]);
+    if (res == NO_ERROR)
+      res = message_res;
+    order[i] = &messages[i];
+  }
+
+  // lanes of a group run for as long as its longest message, so group messages of similar length
+  stable_sort(order.begin(), order.end(), [](BatchMessage* a, BatchMessage* b) {
+    return a->output_length > b->output_length;
+  });
+
+  bool simd = use_simd && batch_simd_supported();
+  LaneGroup group;
+  for (int first = 0; first < num_of_messages; first += NUM_OF_LANES) {
+    int num_of_lanes = min(NUM_OF_LANES, num_of_messages - first);
+    load_group(group, &order[first], num_of_lanes);
+#ifdef LANES_X86
+    if (simd)
+      run_group_avx2(group);
+    else
+#endif
+      run_group_scalar(group);
+
+    for (int lane = 0; lane < num_of_lanes; lane++) {
+      BatchMessage* message = order[first + lane];
+      for (int t = 0; t < message->output_length; t++)
+        message->output[t] = group.letters[(size_t) t * NUM_OF_LANES + lane] + 'A';
+    }
+  }
+  return res;
+}
@@ -0,0 +1,56 @@
+#ifndef LANES_H
+#define LANES_H
+
+#include "enigma.h"
+using namespace std;
+
+/* 
+  Number of machines stepped together by encrypt_batch: two AVX2 registers of 
+  eight 32-bit lanes, interleaved so that their table gathers overlap
+*/
+int const NUM_OF_LANES = 16;
+
+/* 
+  A key used by encrypt_batch: configurations that have been loaded by setup(), 
+  with the rotors at their starting positions. The key is never modified, 
+  so one key can be shared by any number of messages.
+*/
+struct BatchKey {
+  Plugboard* pb = NULL;
+  Reflector* rf = NULL;
+  int num_of_rotors = 0;
+  Rotor** rotors_ptr = NULL;
+};
+
+/* One message of a batch, encrypted from the starting positions of its key */
+struct BatchMessage {
+  BatchKey const* key = NULL;
+  /* Input letters (A-Z), whitespace is skipped */
+  char const* input = NULL;
+  int input_length = 0;
+  /* Output array provided by the caller, with room for at least input_length letters */
+  char* output = NULL;
+  /* Set by encrypt_batch: number of letters written to output */
+  int output_length = 0;
+  /* Set by encrypt_batch: 0 if NO_ERROR, > 0 otherwise (letters before an invalid input are still written) */
+  int error = 0;
+  /* Set by encrypt_batch when error is INVALID_INPUT_CHARACTER */
+  char error_input = 0;
+};
+
+/* 
+  This function encrypts many independent messages, each under its own key
+  - parameters: array of messages, num_of_messages, use_simd
+  - messages are packed NUM_OF_LANES at a time into lanes whose machine states are stepped together
+  - with use_simd, AVX2 gathers are used for the table lookups when the CPU supports them, 
+    otherwise (and on other CPUs) the lanes are stepped by scalar code
+  - keys may have different numbers of rotors
+  - output is identical to running process_block on each message from its starting positions
+  - returns an integer: 0 if every message is NO_ERROR, the first error found otherwise
+*/
+int encrypt_batch(BatchMessage messages[], int num_of_messages, bool use_simd = true);
+
+/* This function returns true if encrypt_batch can use AVX2 on this CPU */
+bool batch_simd_supported();
+
+#endif
@@ -0,0 +1,214 @@
+#include "machine.h"
+#include "parallel.h"
+#include "static_machine.h"
+#include "errors.h"
+using namespace std;
+
+/* The wiring of the standard configuration files, compiled in: rotors I, II and III with reflector I */
+typedef StaticMachine<wirings::Reflector_I, wirings::Rotor_I, wirings::Rotor_II, wirings::Rotor_III> StandardMachine;
+
+Machine::Machine () : pb(NULL), rf(NULL) {}
+
+Machine::Machine (Machine const& other) : pb(other.pb), rf(other.rf), rotors(other.rotors), 
+  starting_pos(other.starting_pos), num_of_rotors(other.num_of_rotors), position(other.position), 
+  keystream(other.keystream), compile_tried(other.compile_tried), standard(other.standard) {
+  link_rotors();
+}
+
+Machine& Machine::operator= (Machine const& other) {
+  if (this != &other) {
+    pb = other.pb;
+    rf = other.rf;
+    rotors = other.rotors;
+    starting_pos = other.starting_pos;
+    num_of_rotors = other.num_of_rotors;
+    position = other.position;
+    keystream = other.keystream;
+    compile_tried = other.compile_tried;
+    standard = other.standard;
+    link_rotors();
+  }
+  return *this;
+}
+
+void Machine::link_rotors() {
+  rotors_ptr.clear();
+  for (Rotor& rotor : rotors)
+    rotors_ptr.push_back(&rotor);
+}
+
+int Machine::load(char * pb_file, char * rf_file, int num_of_rotors, char** rot_files, char * pos_file) {
+  Plugboard new_pb(pb_file);
+  int res = new_pb.setup();
+  if (res != NO_ERROR)
+    return res;
+
+  Reflector new_rf(rf_file);
+  if ((res = new_rf.setup()) != NO_ERROR)
+    return res;
+
+  vector<int> new_starting_pos(num_of_rotors);
+  if (pos_file && (res = ::get_starting_pos(pos_file, num_of_rotors, new_starting_pos.data())) != NO_ERROR)
+    return res;
+
+  vector<Rotor> new_rotors;
+  new_rotors.reserve(num_of_rotors);
+  for (int i=0; i < num_of_rotors; i++) {
+    new_rotors.push_back(Rotor(rot_files[i]));
+    if ((res = new_rotors[i].setup()) != NO_ERROR)
+      return res;
+  }
+
+  load(new_pb, new_rf, new_rotors, new_starting_pos);
+  return NO_ERROR;
+}
+
+void Machine::load(Plugboard const& pb, Reflector const& rf, vector<Rotor> const& rotors, vector<int> const& starting_pos) {
+  this->pb = pb;
+  this->rf = rf;
+  this->rotors = rotors;
+  this->starting_pos = starting_pos;
+  num_of_rotors = rotors.size();
+  keystream = NULL;
+  compile_tried = false;
+  link_rotors();
+  reset();
+  standard = StandardMachine::matches(*this);
+}
+
+int Machine::load(int argc, char** argv) {
+  if (argc < MIN_PARAMETERS) {
+    cerr << "usage: enigma plugboard-file reflector-file (<rotor-file>)* rotor-positions\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+  return load(argv[1], argv[2], argc - MIN_PARAMETERS, argv + 3, argv[argc-1]);
+}
+
+void Machine::reset() {
+  seek(0);
+}
+
+void Machine::seek(long long position) {
+  seek_rotors(num_of_rotors, rotors_ptr.data(), starting_pos.data(), position);
+  this->position = position;
+}
+
+long long Machine::get_position() const {
+  return position;
+}
+
+void Machine::get_offsets(int offsets[]) const {
+  for (int i=0; i < num_of_rotors; i++)
+    offsets[i] = rotors[i].get_offset();
+}
+
+void Machine::restore(int const offsets[], long long position) {
+  // set_starting_position only sets the offset
+  for (int i=0; i < num_of_rotors; i++)
+    rotors[i].set_starting_position(offsets[i]);
+  this->position = position;
+}
+
+bool Machine::compile() {
+  if (!compile_tried) {
+    // the table starts at the starting positions, so that its step is the position
+    long long current = position;
+    reset();
+    shared_ptr<Keystream> compiled = make_shared<Keystream>();
+    if (compiled->compile(pb, rf, num_of_rotors, rotors_ptr.data()))
+      keystream = compiled;
+    compile_tried = true;
+    seek(current);
+  }
+  return keystream != NULL;
+}
+
+shared_ptr<Keystream const> Machine::get_keystream() const {
+  return keystream;
+}
+
+int Machine::encrypt(char const input[], size_t input_length, char output[], size_t& output_length, char& error_input) {
+  int res = NO_ERROR;
+  long long start = position;
+  output_length = 0;
+#ifndef ENIGMA_INSTRUMENT
+  // the StaticMachine has no counters (see instrument.h): instrumented builds take the runtime rotors
+  if (!keystream && standard) {
+    // the StaticMachine starts from the current offsets (of its three rotors), and leaves the rotors where they were
+    int offsets[3];
+    get_offsets(offsets);
+    StandardMachine fixed(pb, offsets);
+    res = fixed.encrypt(input, input_length, output, output_length, error_input);
+    advance_rotors(num_of_rotors, rotors_ptr.data(), output_length);
+    position += output_length;
+    return res;
+  }
+#endif
+  // process_block takes int lengths, so long buffers are fed in blocks
+  for (size_t begin = 0; begin < input_length && res == NO_ERROR; begin += BLOCK_SIZE) {
+    int length = input_length - begin < (size_t) BLOCK_SIZE ? input_length - begin : BLOCK_SIZE;
+    int written = 0;
+    if (keystream)
+      res = keystream->process_block(input + begin, length, output + output_length, written, position, error_input);
+    else {
+      res = process_block(input + begin, length, output + output_length, written, num_of_rotors, pb, rotors_ptr.data(), rf, error_input);
+      position += written;
+    }
+    output_length += written;
+  }
+  // the keystream leaves the rotors where they were
+  if (keystream)
+    advance_rotors(num_of_rotors, rotors_ptr.data(), position - start);
+  return res;
+}
+
+int Machine::encrypt_parallel(char const input[], size_t input_length, char output[], size_t& output_length, char& error_input, int num_of_threads) {
+  long long start = position, letters = 0;
+  int res = process_parallel(input, input_length, output, letters, num_of_rotors, pb, rotors_ptr.data(), rf, error_input, num_of_threads, keystream.get(), position);
+  output_length = letters;
+  // without the keystream, process_parallel has moved the rotors itself
+  if (keystream)
+    advance_rotors(num_of_rotors, rotors_ptr.data(), position - start);
+  else
+    position += letters;
+  return res;
+}
+
+int Machine::encrypt_stream(istream& in, ostream& out, char& error_input, StreamStats& stats, int num_of_threads) {
+  long long letters = stats.letters;
+  int res = process_stream(in, out, num_of_rotors, pb, rotors_ptr.data(), rf, error_input, stats, num_of_threads);
+  position += stats.letters - letters;
+  return res;
+}
+
+Plugboard& Machine::get_plugboard() {
+  return pb;
+}
+
+Reflector& Machine::get_reflector() {
+  return rf;
+}
+
+Rotor** Machine::get_rotors() {
+  return rotors_ptr.data();
+}
+
+int Machine::get_num_of_rotors() const {
+  return num_of_rotors;
+}
+
+int const* Machine::get_starting_pos() const {
+  return starting_pos.data();
+}
+
+Plugboard const& Machine::get_plugboard() const {
+  return pb;
+}
+
+Reflector const& Machine::get_reflector() const {
+  return rf;
+}
+
+Rotor const& Machine::get_rotor(int index) const {
+  return rotors[index];
+}
@@ -0,0 +1,120 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <memory>
+#include <vector>
+#include "enigma.h"
+#include "keystream.h"
+using namespace std;
+
+/* 
+  A complete machine (plugboard, reflector, rotors and their starting positions), 
+  loaded once from the configuration files and then used for any number of messages.
+  Configuration errors are returned as error codes: nothing in Machine exits the program.
+*/
+class Machine {
+  Plugboard pb;
+  Reflector rf;
+  vector<Rotor> rotors;
+  /* Pointers into rotors, in the Rotor** form taken by the free functions */
+  vector<Rotor*> rotors_ptr;
+  vector<int> starting_pos;
+  int num_of_rotors = 0;
+  /* Number of letters processed since the last reset() */
+  long long position = 0;
+  /* 
+    Keystream compiled from the starting positions (used by encrypt once compiled), 
+    shared by the copies of the machine; NULL if not compiled or if the period is too long
+  */
+  shared_ptr<Keystream const> keystream;
+  /* Set once compile() has been called, so that a period too long is only found once */
+  bool compile_tried = false;
+  /* True if the reflector and rotors are those of StandardMachine (see machine.cpp), found on load */
+  bool standard = false;
+
+  /* This function points rotors_ptr at the rotors of this machine */
+  void link_rotors();
+
+  public:
+    /* Machine constructor: an empty machine (no cables, no rotors) until load() is called */
+    Machine ();
+    /* Machine copy constructor and assignment: the copy has its own rotor positions (the keystream is shared) */
+    Machine (Machine const& other);
+    Machine& operator= (Machine const& other);
+    /* 
+      This function loads the configuration files and sets the rotors to their starting positions
+      - parameters: plugboard file, reflector file, num_of_rotors, rotor files (leftmost first), rotor position file
+        (NULL: the rotors start at 0, e.g. until restore_checkpoint sets them, see checkpoint.h)
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise (the machine is left unchanged on error)
+    */
+    int load(char * pb_file, char * rf_file, int num_of_rotors, char** rot_files, char * pos_file);
+    /* 
+      This function loads a machine from the command line arguments of enigma
+      - parameters: argc, argv (argv[1] is the plugboard file, argv[argc-1] the rotor position file)
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int load(int argc, char** argv);
+    /* 
+      This function builds the machine from parts that are already set up (e.g. from a key file)
+      - parameters: plugboard, reflector, rotors (leftmost first), starting positions (one per rotor)
+      - no file is read
+    */
+    void load(Plugboard const& pb, Reflector const& rf, vector<Rotor> const& rotors, vector<int> const& starting_pos);
+    /* This function sets the rotors back to their starting positions (no file is read) */
+    void reset();
+    /* This function sets the rotors to where they are after 'position' letters from the starting positions */
+    void seek(long long position);
+    /* This function returns the number of letters processed since the last reset() */
+    long long get_position() const;
+    /* This function copies the current offsets of the rotors (leftmost first) into offsets */
+    void get_offsets(int offsets[]) const;
+    /* 
+      This function puts the machine back into a saved state (see checkpoint.h)
+      - parameters: offsets of the rotors (leftmost first, 0-25), position (as returned by get_position)
+      - O(1) per rotor: the offsets are set directly, nothing is rotated or read from a file
+    */
+    void restore(int const offsets[], long long position);
+    /* 
+      This function compiles the machine into a keystream table (see Keystream)
+      - encrypt then uses one table lookup per letter
+      - the machine is only walked through on the first call, whether it succeeds or not
+      - returns false if the rotors' period is too long to be compiled
+    */
+    bool compile();
+    /* This function returns the compiled keystream, NULL if the machine is not compiled */
+    shared_ptr<Keystream const> get_keystream() const;
+    /* 
+      This function encodes / decodes a buffer from the current position
+      - parameters: input array, input_length, output array (with room for input_length letters), output_length, error_input
+      - until compiled, a machine with the standard wiring runs on a StaticMachine (see static_machine.h),
+        any other on the runtime rotors (and every machine on the runtime rotors with ENIGMA_INSTRUMENT)
+      - whitespace is skipped; the letters before an invalid input are still written
+      - nothing is allocated
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int encrypt(char const input[], size_t input_length, char output[], size_t& output_length, char& error_input);
+    /* 
+      This function encodes / decodes a buffer on several threads from the current position (see process_parallel)
+      - parameters: as encrypt, plus num_of_threads
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int encrypt_parallel(char const input[], size_t input_length, char output[], size_t& output_length, char& error_input, int num_of_threads);
+    /* 
+      This function encodes / decodes a whole stream from the current position (see process_stream)
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int encrypt_stream(istream& in, ostream& out, char& error_input, StreamStats& stats, int num_of_threads = 1);
+
+    /* These functions give access to the parts, in the form taken by the free functions */
+    Plugboard& get_plugboard();
+    Reflector& get_reflector();
+    Rotor** get_rotors();
+    int get_num_of_rotors() const;
+    int const* get_starting_pos() const;
+    /* These functions give read-only access to the wiring, e.g. to share one machine between sessions (see Session) */
+    Plugboard const& get_plugboard() const;
+    Reflector const& get_reflector() const;
+    Rotor const& get_rotor(int index) const;
+};
+
+#endif
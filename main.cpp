@@ -1,62 +1,265 @@
 #include <iostream>
+#include <cstring>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
 #include "enigma.h"
+#include "machine.h"
+#include "keyfile.h"
+#include "filemode.h"
+#include "checkpoint.h"
+#include "search.h"
+#include "crack.h"
+#include "serve.h"
+#include "catalogue.h"
+#include "bombe.h"
+#include "batch.h"
+#include "keysheet.h"
+#include "bytemode.h"
+#include "ngram.h"
+#include "job.h"
+#include "packed.h"
+#include "normalize.h"
+#include "drag.h"
+#include "instrument.h"
 #include "errors.h"
 using namespace std;
 
 int main(int argc, char** argv) {
-    char input[MAX_LENGTH], output[MAX_LENGTH];
-    int res = 0, num_of_rotors = 0, output_length = 0;
+    int res = 0, num_of_threads = 1;
+    long long seek_position = 0;
+    char * key_file = NULL;
+    char * in_file = NULL;
+    char * out_file = NULL;
+    char * instrument_file = NULL;
+    char * checkpoint_file = NULL;
+    char * resume_file = NULL;
+    long long checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;
+    bool in_place = false;
+    bool print_stats = false;
+    bool packed_input = false, packed_output = false;
+    bool normalize = false;
+    NormalizeOptions normalize_options;
+    auto start_time = chrono::steady_clock::now();
+
+    // subcommands
+    if (argc > 1 && strcmp(argv[1], "search") == 0)
+        return search_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "drag") == 0)
+        return drag_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "crack") == 0)
+        return crack_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "compile-key") == 0)
+        return compile_key_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "serve") == 0)
+        return serve_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "catalogue") == 0)
+        return catalogue_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "bombe") == 0)
+        return bombe_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "batch") == 0)
+        return batch_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "keysheet") == 0)
+        return keysheet_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "bytes") == 0)
+        return bytes_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "ngrams") == 0)
+        return ngrams_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "job") == 0)
+        return job_command(argc - 1, argv + 1);
+    if (argc > 1 && strcmp(argv[1], "pack") == 0)
+        return pack_command(argc - 1, argv + 1);
+
+    // options come before the configuration files
+    while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+        if (strcmp(argv[1], "--stats") == 0)
+            print_stats = true;
+        else if (strcmp(argv[1], "--packed-in") == 0)
+            packed_input = true;
+        else if (strcmp(argv[1], "--packed-out") == 0)
+            packed_output = true;
+        else if (strcmp(argv[1], "--keep-case") == 0)
+            normalize_options.uppercase = false;
+        else if (strcmp(argv[1], "--normalize") == 0 && argc > 2
+            && (strcmp(argv[2], "report") == 0 || strcmp(argv[2], "strip") == 0 || strcmp(argv[2], "pass") == 0)) {
+            normalize = true;
+            normalize_options.non_letters = strcmp(argv[2], "report") == 0 ? NON_LETTERS_REPORT
+                : strcmp(argv[2], "strip") == 0 ? NON_LETTERS_STRIP : NON_LETTERS_PASS;
+            argv++;
+            argc--;
+        } else if (strcmp(argv[1], "--threads") == 0 && argc > 2) {
+            num_of_threads = atoi(argv[2]);
+            if (num_of_threads <= 0)
+                num_of_threads = thread::hardware_concurrency();
+            argv++;
+            argc--;
+        } else if (strcmp(argv[1], "--key") == 0 && argc > 2) {
+            key_file = argv[2];
+            argv++;
+            argc--;
+        } else if ((strcmp(argv[1], "--in") == 0 || strcmp(argv[1], "--in-place") == 0) && argc > 2) {
+            in_place = strcmp(argv[1], "--in-place") == 0;
+            in_file = argv[2];
+            argv++;
+            argc--;
+        } else if (strcmp(argv[1], "--out") == 0 && argc > 2) {
+            out_file = argv[2];
+            argv++;
+            argc--;
+        } else if (strcmp(argv[1], "--checkpoint") == 0 && argc > 2) {
+            checkpoint_file = argv[2];
+            argv++;
+            argc--;
+        } else if (strcmp(argv[1], "--checkpoint-every") == 0 && argc > 2 && isdigit(argv[2][0]) && atoll(argv[2]) > 0) {
+            checkpoint_interval = atoll(argv[2]);
+            argv++;
+            argc--;
+        } else if (strcmp(argv[1], "--resume") == 0 && argc > 2) {
+            resume_file = argv[2];
+            argv++;
+            argc--;
+        } else if (strcmp(argv[1], "--instrument") == 0 && argc > 2) {
+            instrument_file = argv[2];
+            argv++;
+            argc--;
+        } else if (strcmp(argv[1], "--seek") == 0 && argc > 2 && isdigit(argv[2][0])) {
+            seek_position = atoll(argv[2]);
+            argv++;
+            argc--;
+        } else {
+            cerr << "unknown option " << argv[1] << endl;
+            res = INSUFFICIENT_NUMBER_OF_PARAMETERS;
+            break;
+        }
+        // drop the option so that argv[1] is the plugboard file again
+        argv++;
+        argc--;
+    }
 
     // check for number of command line parameters
-    if (argc < MIN_PARAMETERS) {
-        cerr << "usage: enigma plugboard-file reflector-file (<rotor-file>)* rotor-positions\n";
+    // --in needs --out, --in-place must not have one
+    bool files_ok = in_file ? (in_place == (out_file == NULL)) : out_file == NULL;
+    // checkpoints are taken in stream mode only, and of text streams
+    files_ok = files_ok && !(in_file && (checkpoint_file || resume_file));
+    files_ok = files_ok && !((packed_input || packed_output) && (in_file || checkpoint_file || resume_file));
+    files_ok = files_ok && !(normalize && (packed_input || packed_output || in_file || checkpoint_file || resume_file));
+    // --keep-case only changes the normalization stage
+    files_ok = files_ok && (normalize || normalize_options.uppercase);
+    // a resumed stream may leave out the rotor position file (the checkpoint has the starting positions)
+    if (res != NO_ERROR || !files_ok || (key_file ? argc != 1 : argc < (resume_file ? MIN_PARAMETERS - 1 : MIN_PARAMETERS))) {
+        cerr << "usage: enigma [options] plugboard-file reflector-file (<rotor-file>)* rotor-positions\n"
+            << "       enigma [options] --key key-file\n"
+            << "       enigma compile-key key-file plugboard-file reflector-file (<rotor-file>)* rotor-positions\n"
+            << "       enigma serve [--threads N] [--key key-file] socket-path (configuration files, as above, unless --key)\n"
+            << "       enigma search [--threads N] [--crib-offset K] plugboard-file reflector-file num-of-rotors CRIB (<rotor-file>)+ < ciphertext\n"
+            << "       enigma crack [--threads N] [--candidates K] [--restarts R] [--max-pairs P] [--ngrams table-file] reflector-file num-of-rotors (<rotor-file>)+ < ciphertext\n"
+            << "       enigma drag [--threads N] [--max-hits H] plugboard-file reflector-file num-of-rotors words-file (<rotor-file>)+ < ciphertext\n"
+            << "       enigma bombe [--threads N] [--crib-offset K] reflector-file num-of-rotors CRIB (<rotor-file>)+ < ciphertext\n"
+            << "       enigma catalogue build|query|signature|indicators ... (enigma catalogue for details)\n"
+            << "       enigma job init|work|merge ... (enigma job for details)\n"
+            << "       enigma batch [--threads N] [--queue-size Q] manifest-file\n"
+            << "       enigma keysheet [--stats] key-sheet-file < messages (one per line: key-id message)\n"
+            << "       enigma bytes [--alphabet N] [--stats] plugboard-file reflector-file (<rotor-file>)* rotor-positions < input > output\n"
+            << "       enigma ngrams build counts-file table-file | enigma ngrams score [--scalar] table-file < candidates\n"
+            << "       enigma pack < letters > packed | enigma pack --unpack [--from letter-position] [--count N] [packed-file] > letters\n"
+            << "options: --stats, --threads N, --seek letter-position, --in file --out file, --in-place file,\n"
+            << "         --checkpoint file [--checkpoint-every bytes], --resume file (stream mode; the rotor-positions\n"
+            << "         file may then be left out, as the checkpoint has the starting positions)\n"
+            << "         --packed-in, --packed-out (stream mode, 5-bit packed letters: see enigma pack)\n"
+            << "         --normalize report|strip|pass [--keep-case] (stream mode: lower case letters are uppercased,\n"
+            << "         other characters are reported and skipped, stripped or passed through unencoded)\n"
+            << "         --instrument json-file|- (enigma_instrumented only)\n";
         res = INSUFFICIENT_NUMBER_OF_PARAMETERS;
     }
     check_error(res);
 
-    num_of_rotors = argc - MIN_PARAMETERS;
-
-    // configure settings for plugboard, reflector and rotors
-    char * pb_file = argv[1];
-    Plugboard pb(pb_file);
-    res = pb.setup();
-    check_error(res);
+    // a resumed stream is given the rotor position file or not: the checkpoint's number of rotors tells which
+    MachineCheckpoint checkpoint;
+    bool resume_positions = false;
+    if (resume_file) {
+        res = read_checkpoint(resume_file, checkpoint);
+        check_error(res);
+        resume_positions = !key_file && argc - (MIN_PARAMETERS - 1) == (int) checkpoint.num_of_rotors;
+    }
 
-    char * rf_file = argv[2];
-    Reflector rf(rf_file);
-    res = rf.setup();
+    // configure settings for plugboard, reflector and rotors, 
+    // from the text configuration files or from a compiled key file
+    Machine machine;
+    if (key_file)
+        res = read_key_file(key_file, machine);
+    else if (resume_positions)
+        res = machine.load(argv[1], argv[2], argc - (MIN_PARAMETERS - 1), argv + 3, NULL);
+    else
+        res = machine.load(argc, argv);
     check_error(res);
 
-    char * pos_file = argv[argc-1];
-    int starting_pos[num_of_rotors];
-    res = get_starting_pos(pos_file, num_of_rotors, starting_pos);
-    check_error(res);
+    // the input starts at letter seek_position of a message
+    if (seek_position > 0)
+        machine.seek(seek_position);
 
-    Rotor** rotors_ptr = setup_rotors(num_of_rotors, argv, starting_pos);
+    // a resumed stream continues from the checkpoint: the input it had read is skipped,
+    // the output it had written is expected to be kept by the caller
+    ios::sync_with_stdio(false);
+    StreamStats stats;
+    if (resume_file) {
+        res = restore_checkpoint(machine, checkpoint, stats, !resume_positions);
+        check_error(res);
+        cin.ignore(stats.bytes_in);
+        cerr << "resuming after " << stats.bytes_in << " input bytes (" << stats.letters << " letters written)\n";
+    }
 
-    // prompt for input
-    cin.getline(input, MAX_LENGTH);
+    auto setup_time = chrono::steady_clock::now();
 
-    // encode / decode input 
+    // encode / decode the whole input: a memory-mapped file, or stdin block by block
     char error_input;
-    res = process_inputs(input, output, output_length, num_of_rotors, pb, rotors_ptr, rf, error_input);
-    output[output_length] = '\0';
-
-    for (int i=0; output[i] != '\0' && i<output_length; i++)
-      cout << output[i];
+    NormalizeStats normalize_stats;
+    if (in_file)
+        res = encrypt_file(machine, in_file, out_file, num_of_threads, error_input, stats);
+    else if (packed_input || packed_output)
+        res = encrypt_stream_packed(machine, cin, cout, packed_input, packed_output, error_input, stats, num_of_threads);
+    else if (normalize)
+        res = encrypt_stream_normalized(machine, cin, cout, normalize_options, normalize_stats, stats, num_of_threads);
+    else if (checkpoint_file)
+        res = encrypt_stream_checkpointed(machine, cin, cout, error_input, stats, num_of_threads, checkpoint_file, checkpoint_interval);
+    else
+        res = machine.encrypt_stream(cin, cout, error_input, stats, num_of_threads);
 
-    if (res == INVALID_INPUT_CHARACTER) {
+    // the normalization stage goes on after an invalid input, and reports them all at the end
+    if (normalize)
+        print_normalize_errors(normalize_stats, cerr);
+    else if (res == INVALID_INPUT_CHARACTER) {
         cerr << error_input << " is not a valid input character "
             << "(input characters must be upper case letters A-Z)!\n";
     }
 
+    if (print_stats) {
+        auto end_time = chrono::steady_clock::now();
+        double setup_secs = chrono::duration<double>(setup_time - start_time).count();
+        double run_secs = chrono::duration<double>(end_time - setup_time).count();
+        cerr << "setup: " << setup_secs * 1e3 << " ms\n"
+            << "input: " << stats.bytes_in << " bytes, " << stats.letters << " letters\n";
+        if (normalize)
+            cerr << "normalize: " << normalize_stats.non_letters << " non-letters "
+                << (normalize_options.non_letters == NON_LETTERS_PASS ? "passed through" : "skipped")
+                << ", " << normalize_stats.num_of_errors << " invalid\n";
+        cerr << "run: " << run_secs << " s ("
+            << (run_secs > 0 ? stats.bytes_in / run_secs / 1e6 : 0) << " MB/s)\n";
+    }
+
+    // per-stage cycles and rotor stepping counts (see instrument.h)
+    if (instrument_file) {
+        if (!instrument_enabled())
+            cerr << "instrumentation is not compiled in (make enigma_instrumented)\n";
+        else if (strcmp(instrument_file, "-") == 0)
+            instrument_report(cerr);
+        else {
+            ofstream json(instrument_file);
+            instrument_report(json);
+        }
+    }
+
     check_error(res);
-    
-    // free up memory 
-    for (int i=0; i<num_of_rotors; i++)
-        delete rotors_ptr[i];
-    delete [] rotors_ptr;
 
     return NO_ERROR;
 }
-
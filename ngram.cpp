@@ -0,0 +1,285 @@
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "ngram.h"
+#include "fileheader.h"
+#include "errors.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NGRAM_X86
+#endif
+using namespace std;
+
+/* This function returns 26^length, the number of n-grams of a length */
+static int num_of_ngrams(int length) {
+  int count = 1;
+  for (int i = 0; i < length; i++)
+    count *= TOTAL_ALPHABET_COUNT;
+  return count;
+}
+
+int NgramTable::build(int length, vector<long long> const& counts) {
+  if (length < MIN_NGRAM_LENGTH || length > MAX_NGRAM_LENGTH || (int) counts.size() != num_of_ngrams(length)) {
+    cerr << "Invalid n-gram counts (n should be between " << MIN_NGRAM_LENGTH << "-" << MAX_NGRAM_LENGTH << ")\n";
+    return INVALID_NGRAM_TABLE;
+  }
+  double total = 0;
+  for (long long count : counts)
+    total += count;
+  if (total <= 0) {
+    cerr << "Invalid n-gram counts (no n-gram occurs)\n";
+    return INVALID_NGRAM_TABLE;
+  }
+
+  this->length = length;
+  floor = log10(0.01 / total);
+  log_probs.resize(counts.size());
+  for (size_t i = 0; i < counts.size(); i++)
+    log_probs[i] = counts[i] > 0 ? log10(counts[i] / total) : floor;
+  return NO_ERROR;
+}
+
+int NgramTable::read_counts(char * counts_file, int& length, vector<long long>& counts) {
+  ifstream in(counts_file);
+  if (!in) {
+    cerr << "Error opening n-gram counts file " << counts_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  length = 0;
+  counts.clear();
+  string ngram;
+  long long count;
+  for (int line = 1; in >> ngram; line++) {
+    if (!(in >> count) || count < 0) {
+      cerr << "Invalid count in n-gram counts file " << counts_file << " (line " << line << ")\n";
+      return INVALID_NGRAM_TABLE;
+    }
+    // the first n-gram sets the length of all the others
+    if (length == 0) {
+      length = ngram.size();
+      if (length < MIN_NGRAM_LENGTH || length > MAX_NGRAM_LENGTH) {
+        cerr << "Invalid n-gram " << ngram << " in n-gram counts file " << counts_file
+          << " (n should be between " << MIN_NGRAM_LENGTH << "-" << MAX_NGRAM_LENGTH << ")\n";
+        return INVALID_NGRAM_TABLE;
+      }
+      counts.assign(num_of_ngrams(length), 0);
+    }
+    if ((int) ngram.size() != length) {
+      cerr << "Invalid n-gram " << ngram << " in n-gram counts file " << counts_file
+        << " (line " << line << ": all n-grams should have " << length << " letters)\n";
+      return INVALID_NGRAM_TABLE;
+    }
+    int index = 0;
+    for (char ch : ngram) {
+      ch = toupper(ch);
+      if (ch < 'A' || ch > 'Z') {
+        cerr << "Invalid n-gram " << ngram << " in n-gram counts file " << counts_file << " (line " << line << ")\n";
+        return INVALID_NGRAM_TABLE;
+      }
+      index = index * TOTAL_ALPHABET_COUNT + (ch - 'A');
+    }
+    counts[index] += count;
+  }
+  if (length == 0) {
+    cerr << "No n-gram in n-gram counts file " << counts_file << endl;
+    return INVALID_NGRAM_TABLE;
+  }
+  return NO_ERROR;
+}
+
+int NgramTable::load(char * table_file) {
+  ifstream in(table_file, ios::binary);
+  if (!in) {
+    cerr << "Error opening n-gram table file " << table_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  NgramFileHeader header;
+  if (!in.read((char*) &header, sizeof(header))) {
+    cerr << "Invalid n-gram table file " << table_file << " (too short)\n";
+    return INVALID_NGRAM_TABLE;
+  }
+  int res = check_file_header(header.magic, header.version, NGRAM_MAGIC, NGRAM_VERSION, "n-gram table file", table_file, INVALID_NGRAM_TABLE);
+  if (res != NO_ERROR)
+    return res;
+  if (header.length < (uint32_t) MIN_NGRAM_LENGTH || header.length > (uint32_t) MAX_NGRAM_LENGTH) {
+    cerr << "Invalid n-gram table file " << table_file << " (bad header)\n";
+    return INVALID_NGRAM_TABLE;
+  }
+  vector<float> table(num_of_ngrams(header.length));
+  if (!in.read((char*) table.data(), table.size() * sizeof(float)) || in.peek() != char_traits<char>::eof()) {
+    cerr << "Invalid n-gram table file " << table_file << " (wrong size)\n";
+    return INVALID_NGRAM_TABLE;
+  }
+  length = header.length;
+  floor = header.floor;
+  log_probs.swap(table);
+  return NO_ERROR;
+}
+
+int NgramTable::save(char * table_file) const {
+  NgramFileHeader header;
+  memcpy(header.magic, NGRAM_MAGIC, sizeof(header.magic));
+  header.version = NGRAM_VERSION;
+  header.length = length;
+  header.floor = floor;
+  ofstream out(table_file, ios::binary | ios::trunc);
+  out.write((char const*) &header, sizeof(header));
+  out.write((char const*) log_probs.data(), log_probs.size() * sizeof(float));
+  out.close();
+  if (!out) {
+    cerr << "Error writing n-gram table file " << table_file << endl;
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  return NO_ERROR;
+}
+
+int NgramTable::get_length() const {
+  return length;
+}
+
+// rolls the index letter by letter: the oldest letter is dropped by the modulo
+// (a constant, so that it compiles to a multiplication)
+template <int LENGTH>
+static double score_scalar(float const* log_probs, int const letters[], int num_of_letters) {
+  int const modulo = LENGTH == 2 ? 26 : LENGTH == 3 ? 26 * 26 : 26 * 26 * 26;
+  int index = 0;
+  for (int i = 0; i < LENGTH - 1; i++)
+    index = index * TOTAL_ALPHABET_COUNT + letters[i];
+  double sum = 0;
+  for (int i = LENGTH - 1; i < num_of_letters; i++) {
+    index = (index % modulo) * TOTAL_ALPHABET_COUNT + letters[i];
+    sum += log_probs[index];
+  }
+  return sum;
+}
+
+#ifdef NGRAM_X86
+// the indices of the n-grams starting at 8 consecutive letters, from 8-letter loads shifted by one letter each
+template <int LENGTH>
+__attribute__((target("avx2")))
+static double score_avx2(float const* log_probs, int const letters[], int num_of_letters) {
+  __m256i const letter_count = _mm256_set1_epi32(TOTAL_ALPHABET_COUNT);
+  int const num_of_ngrams = num_of_letters - LENGTH + 1;
+  // two accumulators so that consecutive gathers do not wait for each other's add
+  __m256 sum[2] = {_mm256_setzero_ps(), _mm256_setzero_ps()};
+  int i = 0;
+  for (; i + 8 <= num_of_ngrams; i += 8) {
+    __m256i index = _mm256_loadu_si256((__m256i const*) (letters + i));
+    for (int k = 1; k < LENGTH; k++)
+      index = _mm256_add_epi32(_mm256_mullo_epi32(index, letter_count), _mm256_loadu_si256((__m256i const*) (letters + i + k)));
+    sum[(i / 8) & 1] = _mm256_add_ps(sum[(i / 8) & 1], _mm256_i32gather_ps(log_probs, index, 4));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, _mm256_add_ps(sum[0], sum[1]));
+  double total = 0;
+  for (float lane : lanes)
+    total += lane;
+  // the last n-grams, fewer than 8
+  if (i < num_of_ngrams)
+    total += score_scalar<LENGTH>(log_probs, letters + i, num_of_letters - i);
+  return total;
+}
+#endif
+
+bool ngram_simd_supported() {
+#ifdef NGRAM_X86
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+double NgramTable::score(int const letters[], int num_of_letters, bool use_simd) const {
+  if (length == 0 || num_of_letters < length)
+    return 0;
+#ifdef NGRAM_X86
+  static bool const simd_supported = ngram_simd_supported();
+  if (use_simd && simd_supported) {
+    switch (length) {
+      case 2: return score_avx2<2>(log_probs.data(), letters, num_of_letters);
+      case 3: return score_avx2<3>(log_probs.data(), letters, num_of_letters);
+      case 4: return score_avx2<4>(log_probs.data(), letters, num_of_letters);
+    }
+  }
+#endif
+  switch (length) {
+    case 2: return score_scalar<2>(log_probs.data(), letters, num_of_letters);
+    case 3: return score_scalar<3>(log_probs.data(), letters, num_of_letters);
+    default: return score_scalar<4>(log_probs.data(), letters, num_of_letters);
+  }
+}
+
+void NgramTable::score_batch(int const letters[], int num_of_letters, int num_of_candidates, double scores[], bool use_simd) const {
+  for (int c = 0; c < num_of_candidates; c++)
+    scores[c] = score(letters + (size_t) c * num_of_letters, num_of_letters, use_simd);
+}
+
+/**************************** Subcommand ****************************/
+
+int ngrams_command(int argc, char** argv) {
+  // skip "ngrams"
+  argv++;
+  argc--;
+  char const* action = argc > 0 ? argv[0] : "";
+  bool use_simd = true;
+  if (strcmp(action, "score") == 0 && argc > 1 && strcmp(argv[1], "--scalar") == 0) {
+    use_simd = false;
+    argv++;
+    argc--;
+  }
+
+  NgramTable table;
+  int res;
+  if (strcmp(action, "build") == 0 && argc == 3) {
+    int length;
+    vector<long long> counts;
+    if ((res = NgramTable::read_counts(argv[1], length, counts)) != NO_ERROR
+        || (res = table.build(length, counts)) != NO_ERROR)
+      return res;
+    return table.save(argv[2]);
+  }
+  if (strcmp(action, "score") != 0 || argc != 2) {
+    cerr << "usage: enigma ngrams build counts-file table-file\n"
+      << "       enigma ngrams score [--scalar] table-file < candidates\n"
+      << "(counts-file lines: NGRAM count, with n-grams of 2 to 4 letters; candidates: one per line)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+  if ((res = table.load(argv[1])) != NO_ERROR)
+    return res;
+
+  // the candidates are converted to letter codes first, so that only the scoring is timed
+  ios::sync_with_stdio(false);
+  vector<int> letters;
+  vector<size_t> starts(1, 0);
+  string line;
+  for (int line_number = 1; getline(cin, line); line_number++) {
+    for (char ch : line) {
+      if (ch >= 'A' && ch <= 'Z')
+        letters.push_back(ch - 'A');
+      else if (!isspace((unsigned char) ch)) {
+        cerr << "line " << line_number << ": " << ch << " is not a valid input character "
+          << "(input characters must be upper case letters A-Z)!\n";
+        return INVALID_INPUT_CHARACTER;
+      }
+    }
+    starts.push_back(letters.size());
+  }
+
+  size_t num_of_candidates = starts.size() - 1;
+  vector<double> scores(num_of_candidates);
+  auto start_time = chrono::steady_clock::now();
+  for (size_t c = 0; c < num_of_candidates; c++)
+    scores[c] = table.score(letters.data() + starts[c], starts[c + 1] - starts[c], use_simd);
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+  for (double score : scores)
+    cout << score << '\n';
+  cout.flush();
+  cerr << num_of_candidates << " candidates (" << letters.size() << " letters, "
+    << table.get_length() << "-grams, " << (use_simd && ngram_simd_supported() ? "avx2" : "scalar") << ") in " << secs << " s ("
+    << (secs > 0 ? num_of_candidates / secs : 0) << " candidates/s)\n";
+  return NO_ERROR;
+}
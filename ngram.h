@@ -0,0 +1,96 @@
+#ifndef NGRAM_H
+#define NGRAM_H
+
+#include <cstdint>
+#include <vector>
+#include "enigma.h"
+using namespace std;
+
+/* Shortest and longest n-grams a table can hold (bigrams to quadgrams) */
+int const MIN_NGRAM_LENGTH = 2;
+int const MAX_NGRAM_LENGTH = 4;
+
+char const NGRAM_MAGIC[4] = {'E', 'N', 'G', 'N'};
+uint32_t const NGRAM_VERSION = 1;
+
+/*
+  Header of an n-gram table file, followed by 26^n floats (log10 probabilities, indexed by the letter codes 0-25
+  of the n-gram read as a base-26 number, first letter most significant), in host byte order (see fileheader.h)
+*/
+struct NgramFileHeader {
+  char magic[4];
+  uint32_t version;
+  /* n-gram length (MIN_NGRAM_LENGTH to MAX_NGRAM_LENGTH) */
+  uint32_t length;
+  /* Log10 probability given to the n-grams that never occurred in the counts */
+  float floor;
+};
+
+/*
+  Log10 probabilities of every n-gram of one length, in a flat array of 26^n floats (a quadgram table is 1.8 MB,
+  small enough to stay in cache while candidates are scored). Texts are scored as letter codes 0-25, as computed
+  by the machine (read_letters, process_letter, Keystream...), without going back to ASCII.
+*/
+class NgramTable {
+  int length = 0;
+  float floor = 0;
+  vector<float> log_probs;
+
+  public:
+    /*
+      This function builds the table from n-gram counts
+      - parameters: length (n), counts (26^n counts, indexed as log_probs)
+      - n-grams with a count of 0 get the log probability of a hundredth of an occurrence
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int build(int length, vector<long long> const& counts);
+    /*
+      This function reads n-gram counts from a text file of "NGRAM count" lines (e.g. "TION 13168375")
+      - parameters: counts file, length (set to the length of the n-grams of the file), counts (26^n counts)
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    static int read_counts(char * counts_file, int& length, vector<long long>& counts);
+    /*
+      This function loads a table file written by save()
+      - parameter: table file
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise (the table is left unchanged on error)
+    */
+    int load(char * table_file);
+    /*
+      This function writes the table to a file
+      - parameter: table file
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int save(char * table_file) const;
+    /* This function returns the n-gram length of the table (0 if nothing has been loaded) */
+    int get_length() const;
+    /*
+      This function returns the fitness of a text: the sum of the log probabilities of its n-grams
+      - parameters: letters (0-25), num_of_letters, use_simd
+      - with use_simd (and an AVX2 CPU), the indices of 8 consecutive n-grams are computed in one register
+        and their log probabilities gathered together; otherwise the index is rolled letter by letter
+      - texts shorter than the n-gram length score 0
+    */
+    double score(int const letters[], int num_of_letters, bool use_simd = true) const;
+    /*
+      This function scores many candidate texts of the same length stored one after the other
+      - parameters: letters (num_of_candidates * num_of_letters codes 0-25), num_of_letters, num_of_candidates, scores, use_simd
+      - scores[i] is set to the fitness of the candidate starting at letters + i * num_of_letters
+    */
+    void score_batch(int const letters[], int num_of_letters, int num_of_candidates, double scores[], bool use_simd = true) const;
+};
+
+/* This function returns true if NgramTable::score can use AVX2 on this CPU */
+bool ngram_simd_supported();
+
+/*
+  This function runs the "ngrams" subcommand
+  - usage: enigma ngrams build counts-file table-file
+           enigma ngrams score [--scalar] table-file < candidates (one candidate per line)
+  - parameters: argc, argv (argv[0] is "ngrams")
+  - score prints the fitness of every candidate to stdout, and the candidates scored per second to stderr
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int ngrams_command(int argc, char** argv);
+
+#endif
@@ -0,0 +1,266 @@
+#include <cstring>
+#include <iostream>
+#include "normalize.h"
+#include "errors.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NORMALIZE_X86
+#endif
+using namespace std;
+
+/* This function returns true for the characters skipped as whitespace (as isspace in the "C" locale) */
+static inline bool is_space(unsigned char ch) {
+  return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+/* This function returns true for the characters normalized to letters */
+static inline bool is_letter(unsigned char ch, bool uppercase) {
+  return (unsigned char) (ch - 'A') < TOTAL_ALPHABET_COUNT
+    || (uppercase && (unsigned char) (ch - 'a') < TOTAL_ALPHABET_COUNT);
+}
+
+// counts a character that is not a letter, and records it if it is invalid
+static void count_non_letter(char ch, long long position, NormalizeOptions const& options, NormalizeStats& stats) {
+  if (options.non_letters != NON_LETTERS_REPORT || is_space(ch)) {
+    stats.non_letters++;
+    return;
+  }
+  if (stats.errors.size() < options.max_errors) {
+    NormalizeError error;
+    error.position = position;
+    error.input = ch;
+    stats.errors.push_back(error);
+  }
+  stats.num_of_errors++;
+}
+
+// one character at a time: every character is stored, and the next one overwrites it unless it is a letter
+static size_t normalize_scalar(char const input[], size_t input_length, char letters[], NormalizeOptions const& options, NormalizeStats& stats, long long first_position) {
+  size_t num_of_letters = 0;
+  for (size_t i = 0; i < input_length; i++) {
+    unsigned char ch = input[i];
+    bool letter = is_letter(ch, options.uppercase);
+    // clearing bit 5 uppercases a lower case letter and leaves an upper case one as it is
+    letters[num_of_letters] = ch & ~0x20;
+    num_of_letters += letter;
+    if (!letter)
+      count_non_letter(ch, first_position + i, options, stats);
+  }
+  return num_of_letters;
+}
+
+static void restore_scalar(char const input[], size_t input_length, char const letters[], char output[], NormalizeOptions const& options) {
+  size_t next = 0;
+  for (size_t i = 0; i < input_length; i++) {
+    bool letter = is_letter(input[i], options.uppercase);
+    output[i] = letter ? letters[next] : input[i];
+    next += letter;
+  }
+}
+
+#ifdef NORMALIZE_X86
+/*
+  pshufb controls for 8 bytes, indexed by the mask of their letters (bit i for byte i):
+  compact moves the letters to the front, expand moves the front bytes back to the letters' places
+*/
+struct ShuffleTables {
+  unsigned char compact[256][8];
+  unsigned char expand[256][8];
+
+  ShuffleTables () {
+    for (int mask = 0; mask < 256; mask++) {
+      int count = 0;
+      for (int i = 0; i < 8; i++) {
+        compact[mask][i] = 0x80;
+        expand[mask][i] = 0x80;
+      }
+      for (int i = 0; i < 8; i++)
+        if (mask & (1 << i)) {
+          compact[mask][count] = i;
+          expand[mask][i] = count++;
+        }
+    }
+  }
+};
+
+static ShuffleTables const shuffle_tables;
+
+// sets letter to 0xFF for the letters of 32 bytes and normalized to the bytes with their letters uppercased
+__attribute__((target("avx2")))
+static inline void classify_avx2(__m256i bytes, bool uppercase, __m256i& letter, __m256i& normalized) {
+  // the compares are signed, so bytes from 0x80 are below every letter
+  __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), bytes));
+  __m256i lower = _mm256_setzero_si256();
+  if (uppercase)
+    lower = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), bytes));
+  letter = _mm256_or_si256(upper, lower);
+  normalized = _mm256_xor_si256(bytes, _mm256_and_si256(lower, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+static inline unsigned space_mask_avx2(__m256i bytes) {
+  __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+    _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('\t' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), bytes)));
+  return _mm256_movemask_epi8(space);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t normalize_avx2(char const input[], size_t input_length, char letters[], NormalizeOptions const& options, NormalizeStats& stats, long long first_position) {
+  size_t i = 0, num_of_letters = 0;
+  for (; i + 32 <= input_length; i += 32) {
+    __m256i bytes = _mm256_loadu_si256((__m256i const*) (input + i)), letter, normalized;
+    classify_avx2(bytes, options.uppercase, letter, normalized);
+    unsigned mask = _mm256_movemask_epi8(letter);
+    // the common case: 32 letters in a row
+    if (mask == 0xFFFFFFFF) {
+      _mm256_storeu_si256((__m256i*) (letters + num_of_letters), normalized);
+      num_of_letters += 32;
+      continue;
+    }
+
+    // 8 bytes at a time: the letters are shuffled to the front and the 8 bytes stored, the next
+    // group overwriting what is past its letters (never past input_length, as letters lag behind input)
+    __m128i halves[2] = {_mm256_castsi256_si128(normalized), _mm256_extracti128_si256(normalized, 1)};
+    for (int group = 0; group < 4; group++) {
+      __m128i group_bytes = group & 1 ? _mm_srli_si128(halves[group / 2], 8) : halves[group / 2];
+      unsigned group_mask = (mask >> (8 * group)) & 0xFF;
+      __m128i control = _mm_loadl_epi64((__m128i const*) shuffle_tables.compact[group_mask]);
+      _mm_storel_epi64((__m128i*) (letters + num_of_letters), _mm_shuffle_epi8(group_bytes, control));
+      num_of_letters += _mm_popcnt_u32(group_mask);
+    }
+
+    unsigned invalid = 0;
+    if (options.non_letters == NON_LETTERS_REPORT)
+      invalid = ~mask & ~space_mask_avx2(bytes);
+    stats.non_letters += _mm_popcnt_u32(~mask & ~invalid);
+    // once max_errors positions are kept, the invalid characters are only counted
+    if (stats.errors.size() >= options.max_errors) {
+      stats.num_of_errors += _mm_popcnt_u32(invalid);
+      continue;
+    }
+    for (; invalid != 0; invalid &= invalid - 1) {
+      int j = __builtin_ctz(invalid);
+      count_non_letter(input[i + j], first_position + i + j, options, stats);
+    }
+  }
+  // the last bytes, fewer than 32
+  return num_of_letters + normalize_scalar(input + i, input_length - i, letters + num_of_letters, options, stats, first_position + i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static void restore_avx2(char const input[], size_t input_length, char const letters[], char output[], NormalizeOptions const& options) {
+  size_t i = 0, next = 0;
+  for (; i + 32 <= input_length; i += 32) {
+    __m256i bytes = _mm256_loadu_si256((__m256i const*) (input + i)), letter, normalized;
+    classify_avx2(bytes, options.uppercase, letter, normalized);
+    unsigned mask = _mm256_movemask_epi8(letter);
+    if (mask == 0xFFFFFFFF) {
+      _mm256_storeu_si256((__m256i*) (output + i), _mm256_loadu_si256((__m256i const*) (letters + next)));
+      next += 32;
+      continue;
+    }
+    if (mask == 0) {
+      _mm256_storeu_si256((__m256i*) (output + i), bytes);
+      continue;
+    }
+
+    // 8 bytes at a time: the next letters are spread to the letters' places, then blended with the input
+    __m128i groups[4];
+    for (int group = 0; group < 4; group++) {
+      unsigned group_mask = (mask >> (8 * group)) & 0xFF;
+      __m128i control = _mm_loadl_epi64((__m128i const*) shuffle_tables.expand[group_mask]);
+      groups[group] = _mm_shuffle_epi8(_mm_loadl_epi64((__m128i const*) (letters + next)), control);
+      next += _mm_popcnt_u32(group_mask);
+    }
+    __m256i expanded = _mm256_set_m128i(_mm_unpacklo_epi64(groups[2], groups[3]), _mm_unpacklo_epi64(groups[0], groups[1]));
+    _mm256_storeu_si256((__m256i*) (output + i), _mm256_blendv_epi8(bytes, expanded, letter));
+  }
+  restore_scalar(input + i, input_length - i, letters + next, output + i, options);
+}
+#endif
+
+bool normalize_simd_supported() {
+#ifdef NORMALIZE_X86
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#else
+  return false;
+#endif
+}
+
+size_t normalize_letters(char const input[], size_t input_length, char letters[], NormalizeOptions const& options, NormalizeStats& stats, bool use_simd) {
+  size_t num_of_letters;
+#ifdef NORMALIZE_X86
+  static bool const simd_supported = normalize_simd_supported();
+  if (use_simd && simd_supported)
+    num_of_letters = normalize_avx2(input, input_length, letters, options, stats, stats.bytes);
+  else
+#endif
+    num_of_letters = normalize_scalar(input, input_length, letters, options, stats, stats.bytes);
+  stats.bytes += input_length;
+  stats.letters += num_of_letters;
+  return num_of_letters;
+}
+
+void restore_non_letters(char const input[], size_t input_length, char const letters[], char output[], NormalizeOptions const& options, bool use_simd) {
+#ifdef NORMALIZE_X86
+  static bool const simd_supported = normalize_simd_supported();
+  if (use_simd && simd_supported) {
+    restore_avx2(input, input_length, letters, output, options);
+    return;
+  }
+#endif
+  restore_scalar(input, input_length, letters, output, options);
+}
+
+int encrypt_stream_normalized(Machine& machine, istream& in, ostream& out, NormalizeOptions const& options,
+  NormalizeStats& normalize_stats, StreamStats& stats, int num_of_threads) {
+  bool pass = options.non_letters == NON_LETTERS_PASS;
+  vector<char> input(BLOCK_SIZE), letters(BLOCK_SIZE), encrypted(BLOCK_SIZE), output(pass ? BLOCK_SIZE : 0);
+  int res = NO_ERROR;
+  while (res == NO_ERROR) {
+    in.read(input.data(), BLOCK_SIZE);
+    size_t input_length = in.gcount(), output_length = 0;
+    if (input_length == 0)
+      break;
+    stats.bytes_in += input_length;
+
+    // only letters reach the machine, so it cannot stop on an invalid input
+    size_t num_of_letters = normalize_letters(input.data(), input_length, letters.data(), options, normalize_stats);
+    char error_input;
+    if (num_of_threads > 1)
+      res = machine.encrypt_parallel(letters.data(), num_of_letters, encrypted.data(), output_length, error_input, num_of_threads);
+    else
+      res = machine.encrypt(letters.data(), num_of_letters, encrypted.data(), output_length, error_input);
+    stats.letters += output_length;
+
+    if (pass) {
+      restore_non_letters(input.data(), input_length, encrypted.data(), output.data(), options);
+      out.write(output.data(), input_length);
+    } else
+      out.write(encrypted.data(), output_length);
+
+    // once the input turns out to be longer than one block, the machine is compiled
+    if (input_length == (size_t) BLOCK_SIZE)
+      machine.compile();
+  }
+  out.flush();
+  if (res == NO_ERROR && normalize_stats.num_of_errors > 0)
+    res = INVALID_INPUT_CHARACTER;
+  return res;
+}
+
+void print_normalize_errors(NormalizeStats const& stats, ostream& out) {
+  if (stats.num_of_errors == 0)
+    return;
+  out << stats.num_of_errors << " invalid input character" << (stats.num_of_errors > 1 ? "s" : "")
+    << " skipped (input characters must be letters or whitespace):\n";
+  for (NormalizeError const& error : stats.errors) {
+    out << "  byte " << error.position << ": ";
+    if (isprint((unsigned char) error.input))
+      out << error.input << '\n';
+    else
+      out << "0x" << hex << (int) (unsigned char) error.input << dec << '\n';
+  }
+  if ((size_t) stats.num_of_errors > stats.errors.size())
+    out << "  (" << stats.num_of_errors - stats.errors.size() << " more)\n";
+}
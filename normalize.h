@@ -0,0 +1,90 @@
+#ifndef NORMALIZE_H
+#define NORMALIZE_H
+
+#include <iostream>
+#include <vector>
+#include "enigma.h"
+#include "machine.h"
+using namespace std;
+
+/* Number of invalid input characters whose position is kept unless specified otherwise (all are counted) */
+size_t const DEFAULT_MAX_NORMALIZE_ERRORS = 100;
+
+/* What the normalization stage does with the characters that are not letters */
+enum NonLetters {
+  /* Whitespace is skipped, any other character is dropped and its position recorded (see NormalizeStats) */
+  NON_LETTERS_REPORT,
+  /* Every character that is not a letter is dropped */
+  NON_LETTERS_STRIP,
+  /* Every character that is not a letter is copied to the output as it is, without stepping the rotors */
+  NON_LETTERS_PASS
+};
+
+struct NormalizeOptions {
+  /* 'a'-'z' are letters, encoded as 'A'-'Z' (otherwise they are not letters) */
+  bool uppercase = true;
+  NonLetters non_letters = NON_LETTERS_REPORT;
+  /* Number of invalid characters whose position is kept in NormalizeStats::errors */
+  size_t max_errors = DEFAULT_MAX_NORMALIZE_ERRORS;
+};
+
+/* An input character rejected by NON_LETTERS_REPORT */
+struct NormalizeError {
+  /* Position of the character in the input (in bytes, from the start of the stream) */
+  long long position = 0;
+  char input = 0;
+};
+
+/* Counters filled in by the normalization stage, across all the calls of a stream */
+struct NormalizeStats {
+  /* Number of input bytes normalized */
+  long long bytes = 0;
+  long long letters = 0;
+  /* Number of characters dropped (stripped, or whitespace skipped) or passed through */
+  long long non_letters = 0;
+  /* Number of invalid characters (NON_LETTERS_REPORT only), and the first max_errors of them */
+  long long num_of_errors = 0;
+  vector<NormalizeError> errors;
+};
+
+/*
+  This function normalizes a buffer ahead of the rotors: its letters are uppercased and compacted
+  - parameters: input, input_length, letters (with room for input_length characters), options, stats, use_simd
+  - letters is filled with the letters of the input only ('A'-'Z'), ready for Machine::encrypt
+  - input positions are counted from stats.bytes, which is then moved past the buffer, so that a stream
+    can be normalized block by block
+  - 32 bytes at a time with use_simd on an AVX2 CPU: they are classified with a few byte compares and
+    their letters are compacted 8 at a time with one shuffle (runs of 32 letters are copied as they are)
+  - returns the number of letters written
+*/
+size_t normalize_letters(char const input[], size_t input_length, char letters[], NormalizeOptions const& options, NormalizeStats& stats, bool use_simd = true);
+
+/*
+  This function puts the characters that are not letters back among encoded letters (NON_LETTERS_PASS)
+  - parameters: input (as given to normalize_letters), input_length, letters (the encoded letters, in a buffer
+    with room for input_length characters), output (with room for input_length characters), options, use_simd
+  - output is input with its letters replaced by the encoded letters, in order
+*/
+void restore_non_letters(char const input[], size_t input_length, char const letters[], char output[], NormalizeOptions const& options, bool use_simd = true);
+
+/* This function returns true if normalize_letters / restore_non_letters can use AVX2 on this CPU */
+bool normalize_simd_supported();
+
+/*
+  This function encodes / decodes a whole stream through the normalization stage
+  - parameters: machine, input stream, output stream, options, normalize_stats, stats, num_of_threads
+  - an invalid character does not stop the stream: it is recorded in normalize_stats and the stream goes on
+  - stats.letters counts the letters encoded / decoded (passed through characters are not counted)
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise (INVALID_INPUT_CHARACTER once the whole stream has been
+    processed, if an invalid character was found)
+*/
+int encrypt_stream_normalized(Machine& machine, istream& in, ostream& out, NormalizeOptions const& options,
+  NormalizeStats& normalize_stats, StreamStats& stats, int num_of_threads = 1);
+
+/*
+  This function prints the invalid characters recorded in stats (at most max_errors of them)
+  - parameters: stats, output stream
+*/
+void print_normalize_errors(NormalizeStats const& stats, ostream& out);
+
+#endif
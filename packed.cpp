@@ -0,0 +1,400 @@
+#include <cstdlib>
+#include <cstring>
+#include <endian.h>
+#include <fstream>
+#include <iostream>
+#include "packed.h"
+#include "fileheader.h"
+#include "errors.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACKED_X86
+#endif
+using namespace std;
+
+/* The low 5 bits of each byte of a 64-bit word */
+static uint64_t const LETTER_BITS = 0x1F1F1F1F1F1F1F1FULL;
+/* 'A' in each byte of a 64-bit word (the letter codes 0-25 never carry into the next byte) */
+static uint64_t const LETTER_A = 0x4141414141414141ULL;
+
+size_t packed_size(size_t num_of_letters) {
+  return (num_of_letters * 5 + 7) / 8;
+}
+
+/**************************** Packing ****************************/
+
+// loads the 5 bytes of a group of 8 packed letters (as two loads: a 5-byte memcpy into a
+// 64-bit word goes through the stack and stalls on store forwarding)
+static inline uint64_t load_group(unsigned char const packed[]) {
+  uint32_t low;
+  memcpy(&low, packed, 4);
+  return le32toh(low) | (uint64_t) packed[4] << 32;
+}
+
+// packs the letters after the last full group of 8, one at a time
+static void pack_tail(char const letters[], size_t num_of_letters, unsigned char packed[]) {
+  uint64_t bits = 0;
+  for (size_t i = 0; i < num_of_letters; i++)
+    bits |= (uint64_t) (letters[i] - 'A') << (5 * i);
+  bits = htole64(bits);
+  memcpy(packed, &bits, packed_size(num_of_letters));
+}
+
+static void pack_groups_scalar(char const letters[], size_t num_of_groups, unsigned char packed[]) {
+  for (size_t g = 0; g < num_of_groups; g++) {
+    uint64_t word, bits = 0;
+    memcpy(&word, letters + 8 * g, 8);
+    // letter i is byte i of the word, and bits 5i to 5i+4 of the group, on any host
+    word = le64toh(word) - LETTER_A;
+    for (int i = 0; i < 8; i++)
+      bits |= ((word >> (8 * i)) & 0x1F) << (5 * i);
+    bits = htole64(bits);
+    memcpy(packed + 5 * g, &bits, 5);
+  }
+}
+
+static bool unpack_groups_scalar(unsigned char const packed[], size_t num_of_groups, char letters[]) {
+  uint64_t invalid = 0;
+  for (size_t g = 0; g < num_of_groups; g++) {
+    uint64_t bits = load_group(packed + 5 * g), word = 0;
+    for (int i = 0; i < 8; i++)
+      word |= ((bits >> (5 * i)) & 0x1F) << (8 * i);
+    // a byte above 25 has bit 5 set once 6 is added to it
+    invalid |= (word + 0x0606060606060606ULL) & 0x2020202020202020ULL;
+    word = htole64(word + LETTER_A);
+    memcpy(letters + 8 * g, &word, 8);
+  }
+  return invalid == 0;
+}
+
+// x86 is little-endian, so the pext / pdep words need no byte swap
+#ifdef PACKED_X86
+__attribute__((target("bmi2")))
+static void pack_groups_bmi2(char const letters[], size_t num_of_groups, unsigned char packed[]) {
+  for (size_t g = 0; g < num_of_groups; g++) {
+    uint64_t word;
+    memcpy(&word, letters + 8 * g, 8);
+    uint64_t bits = _pext_u64(word - LETTER_A, LETTER_BITS);
+    memcpy(packed + 5 * g, &bits, 5);
+  }
+}
+
+__attribute__((target("bmi2")))
+static bool unpack_groups_bmi2(unsigned char const packed[], size_t num_of_groups, char letters[]) {
+  uint64_t invalid = 0;
+  for (size_t g = 0; g < num_of_groups; g++) {
+    uint64_t word = _pdep_u64(load_group(packed + 5 * g), LETTER_BITS);
+    invalid |= (word + 0x0606060606060606ULL) & 0x2020202020202020ULL;
+    word += LETTER_A;
+    memcpy(letters + 8 * g, &word, 8);
+  }
+  return invalid == 0;
+}
+#endif
+
+bool packing_bmi2_supported() {
+#ifdef PACKED_X86
+  return __builtin_cpu_supports("bmi2");
+#else
+  return false;
+#endif
+}
+
+void pack_letters(char const letters[], size_t num_of_letters, unsigned char packed[], bool use_bmi2) {
+  size_t num_of_groups = num_of_letters / 8;
+#ifdef PACKED_X86
+  static bool const bmi2 = packing_bmi2_supported();
+  if (use_bmi2 && bmi2)
+    pack_groups_bmi2(letters, num_of_groups, packed);
+  else
+#endif
+    pack_groups_scalar(letters, num_of_groups, packed);
+  pack_tail(letters + 8 * num_of_groups, num_of_letters % 8, packed + 5 * num_of_groups);
+}
+
+bool unpack_letters(unsigned char const packed[], size_t num_of_letters, char letters[], bool use_bmi2) {
+  size_t num_of_groups = num_of_letters / 8;
+  bool valid;
+#ifdef PACKED_X86
+  static bool const bmi2 = packing_bmi2_supported();
+  if (use_bmi2 && bmi2)
+    valid = unpack_groups_bmi2(packed, num_of_groups, letters);
+  else
+#endif
+    valid = unpack_groups_scalar(packed, num_of_groups, letters);
+
+  // the letters after the last full group of 8
+  size_t tail = num_of_letters % 8;
+  uint64_t bits = 0;
+  memcpy(&bits, packed + 5 * num_of_groups, packed_size(tail));
+  bits = le64toh(bits);
+  for (size_t i = 0; i < tail; i++) {
+    int letter = (bits >> (5 * i)) & 0x1F;
+    valid = valid && letter < TOTAL_ALPHABET_COUNT;
+    letters[8 * num_of_groups + i] = 'A' + letter;
+  }
+  return valid;
+}
+
+/**************************** PackedWriter ****************************/
+
+PackedWriter::PackedWriter (ostream& out, int block_letters) : out(out), block_letters(block_letters) {
+  pending.reserve(block_letters);
+  packed.resize(packed_size(block_letters));
+}
+
+void PackedWriter::write_header() {
+  if (header_written)
+    return;
+  PackedHeader header;
+  memcpy(header.magic, PACKED_MAGIC, sizeof(header.magic));
+  header.version = htole32(PACKED_VERSION);
+  header.block_letters = htole32(block_letters);
+  header.reserved = 0;
+  out.write((char const*) &header, sizeof(header));
+  header_written = true;
+}
+
+void PackedWriter::write_block() {
+  uint32_t num_of_letters = pending.size(), count = htole32(num_of_letters);
+  pack_letters(pending.data(), num_of_letters, packed.data());
+  out.write((char const*) &count, sizeof(count));
+  out.write((char const*) packed.data(), packed_size(num_of_letters));
+  pending.clear();
+}
+
+int PackedWriter::write(char const letters[], size_t num_of_letters) {
+  write_header();
+  while (num_of_letters > 0) {
+    size_t length = min(num_of_letters, (size_t) block_letters - pending.size());
+    pending.insert(pending.end(), letters, letters + length);
+    letters += length;
+    num_of_letters -= length;
+    if ((int) pending.size() == block_letters)
+      write_block();
+  }
+  if (!out) {
+    cerr << "Error writing the packed output\n";
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  return NO_ERROR;
+}
+
+int PackedWriter::finish() {
+  write_header();
+  if (!pending.empty())
+    write_block();
+  out.flush();
+  if (!out) {
+    cerr << "Error writing the packed output\n";
+    return ERROR_OPENING_CONFIGURATION_FILE;
+  }
+  return NO_ERROR;
+}
+
+/**************************** PackedReader ****************************/
+
+PackedReader::PackedReader (istream& in) : in(in) {}
+
+int PackedReader::open() {
+  if (!in.read((char*) &header, sizeof(header))) {
+    cerr << "Invalid packed stream (too short)\n";
+    return INVALID_PACKED_STREAM;
+  }
+  header.version = le32toh(header.version);
+  header.block_letters = le32toh(header.block_letters);
+  int res = check_file_header(header.magic, header.version, PACKED_MAGIC, PACKED_VERSION, "packed stream", NULL, INVALID_PACKED_STREAM);
+  if (res != NO_ERROR)
+    return res;
+  if (header.block_letters == 0 || header.block_letters % 8 != 0 || header.block_letters > (uint32_t) MAX_PACKED_BLOCK_LETTERS) {
+    cerr << "Invalid packed stream (bad header)\n";
+    return INVALID_PACKED_STREAM;
+  }
+  packed.resize(packed_size(header.block_letters));
+  return NO_ERROR;
+}
+
+int PackedReader::read_block(vector<char>& letters) {
+  letters.clear();
+  uint32_t num_of_letters;
+  if (!in.read((char*) &num_of_letters, sizeof(num_of_letters))) {
+    // the end of the stream falls between two blocks, or it is truncated
+    if (in.gcount() == 0)
+      return NO_ERROR;
+    cerr << "Invalid packed stream (truncated block)\n";
+    return INVALID_PACKED_STREAM;
+  }
+  num_of_letters = le32toh(num_of_letters);
+  if (num_of_letters > header.block_letters || last_block) {
+    cerr << "Invalid packed stream (bad block framing)\n";
+    return INVALID_PACKED_STREAM;
+  }
+  last_block = num_of_letters < header.block_letters;
+  if (!in.read((char*) packed.data(), packed_size(num_of_letters))) {
+    cerr << "Invalid packed stream (truncated block)\n";
+    return INVALID_PACKED_STREAM;
+  }
+  letters.resize(num_of_letters);
+  if (!unpack_letters(packed.data(), num_of_letters, letters.data())) {
+    cerr << "Invalid packed stream (letter out of range)\n";
+    return INVALID_PACKED_STREAM;
+  }
+  if (skip > 0) {
+    letters.erase(letters.begin(), letters.begin() + min((long long) num_of_letters, skip));
+    skip = 0;
+  }
+  return NO_ERROR;
+}
+
+int PackedReader::seek(long long letter) {
+  long long block = letter / header.block_letters;
+  streamoff offset = sizeof(PackedHeader) + block * (long long) (sizeof(uint32_t) + packed_size(header.block_letters));
+  in.clear();
+  if (!in.seekg(offset)) {
+    cerr << "Error seeking in the packed stream\n";
+    return INVALID_PACKED_STREAM;
+  }
+  last_block = false;
+  skip = letter % header.block_letters;
+  return NO_ERROR;
+}
+
+/**************************** Stream ****************************/
+
+int encrypt_stream_packed(Machine& machine, istream& in, ostream& out, bool packed_input, bool packed_output,
+  char& error_input, StreamStats& stats, int num_of_threads) {
+  PackedReader reader(in);
+  PackedWriter writer(out);
+  int res = NO_ERROR;
+  if (packed_input) {
+    if ((res = reader.open()) != NO_ERROR)
+      return res;
+    stats.bytes_in += sizeof(PackedHeader);
+  }
+
+  size_t block_size = packed_input ? PACKED_BLOCK_LETTERS : BLOCK_SIZE;
+  vector<char> input(block_size), output;
+  while (res == NO_ERROR) {
+    size_t input_length, output_length = 0;
+    if (packed_input) {
+      if ((res = reader.read_block(input)) != NO_ERROR)
+        break;
+      input_length = input.size();
+      stats.bytes_in += sizeof(uint32_t) + packed_size(input_length);
+    } else {
+      in.read(input.data(), block_size);
+      input_length = in.gcount();
+      stats.bytes_in += input_length;
+    }
+    if (input_length == 0)
+      break;
+
+    output.resize(input_length);
+    if (num_of_threads > 1)
+      res = machine.encrypt_parallel(input.data(), input_length, output.data(), output_length, error_input, num_of_threads);
+    else
+      res = machine.encrypt(input.data(), input_length, output.data(), output_length, error_input);
+
+    // letters before an invalid character are still written out
+    if (packed_output) {
+      int write_res = writer.write(output.data(), output_length);
+      res = res == NO_ERROR ? write_res : res;
+    } else
+      out.write(output.data(), output_length);
+    stats.letters += output_length;
+
+    // once the input turns out to be longer than one block, the machine is compiled
+    if (input_length == block_size)
+      machine.compile();
+  }
+
+  if (packed_output) {
+    int finish_res = writer.finish();
+    res = res == NO_ERROR ? finish_res : res;
+  } else
+    out.flush();
+  return res;
+}
+
+/**************************** Subcommand ****************************/
+
+int pack_command(int argc, char** argv) {
+  bool unpack = false;
+  long long from = 0, count = -1;
+  bool options_ok = true;
+  // skip "pack", then the options
+  argv++;
+  argc--;
+  while (argc > 0 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--unpack") == 0) {
+      unpack = true;
+      argv++;
+      argc--;
+      continue;
+    }
+    if (argc > 1 && strcmp(argv[0], "--from") == 0 && isdigit(argv[1][0]))
+      from = atoll(argv[1]);
+    else if (argc > 1 && strcmp(argv[0], "--count") == 0 && isdigit(argv[1][0]))
+      count = atoll(argv[1]);
+    else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+  if (!options_ok || argc > 1 || (!unpack && (argc > 0 || from > 0 || count >= 0)) || (from > 0 && argc == 0)) {
+    cerr << "usage: enigma pack < letters > packed\n"
+      << "       enigma pack --unpack [--from letter-position] [--count N] [packed-file] > letters\n"
+      << "(--from needs packed-file, so that it can be seeked)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  ios::sync_with_stdio(false);
+  int res = NO_ERROR;
+  if (!unpack) {
+    // whitespace is skipped, as by the machine
+    PackedWriter writer(cout);
+    vector<char> buffer(BLOCK_SIZE);
+    size_t length;
+    while (res == NO_ERROR && (length = cin.read(buffer.data(), BLOCK_SIZE).gcount()) > 0) {
+      size_t letters = 0;
+      for (size_t i = 0; i < length; i++) {
+        if (buffer[i] >= 'A' && buffer[i] <= 'Z')
+          buffer[letters++] = buffer[i];
+        else if (!isspace((unsigned char) buffer[i])) {
+          cerr << buffer[i] << " is not a valid input character "
+            << "(input characters must be upper case letters A-Z)!\n";
+          res = INVALID_INPUT_CHARACTER;
+          break;
+        }
+      }
+      int write_res = writer.write(buffer.data(), letters);
+      res = res == NO_ERROR ? write_res : res;
+    }
+    int finish_res = writer.finish();
+    return res == NO_ERROR ? finish_res : res;
+  }
+
+  ifstream file;
+  if (argc == 1) {
+    file.open(argv[0], ios::binary);
+    if (!file) {
+      cerr << "Error opening packed file " << argv[0] << endl;
+      return ERROR_OPENING_CONFIGURATION_FILE;
+    }
+  }
+  PackedReader reader(argc == 1 ? (istream&) file : cin);
+  if ((res = reader.open()) != NO_ERROR || (from > 0 && (res = reader.seek(from)) != NO_ERROR))
+    return res;
+  vector<char> letters;
+  while (count != 0 && (res = reader.read_block(letters)) == NO_ERROR && !letters.empty()) {
+    size_t length = count >= 0 ? min((long long) letters.size(), count) : letters.size();
+    cout.write(letters.data(), length);
+    if (count >= 0)
+      count -= length;
+  }
+  cout.flush();
+  return res;
+}
@@ -0,0 +1,145 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "enigma.h"
+#include "machine.h"
+using namespace std;
+
+/* Number of letters per block of a packed stream unless specified otherwise (a multiple of 8) */
+int const PACKED_BLOCK_LETTERS = 1 << 16;
+/* Largest number of letters per block accepted when reading a packed stream */
+int const MAX_PACKED_BLOCK_LETTERS = 1 << 24;
+
+char const PACKED_MAGIC[4] = {'E', 'N', 'G', '5'};
+uint32_t const PACKED_VERSION = 1;
+
+/*
+  Header of a packed letter stream. It is followed by blocks, each one a uint32_t number of letters and the
+  letters packed 5 bits each: letter i of a block (0-25) is bits 5i to 5i+4 of the block's bytes, least
+  significant bit first, so 8 letters take 5 bytes. Unlike the formats of fileheader.h, the integers and
+  the bits are little-endian on every host, so a packed stream can be moved between hosts. Every block but the last holds block_letters letters,
+  so block k starts at sizeof(PackedHeader) + k * (4 + packed_size(block_letters)) and a reader can seek
+  to any letter without reading what comes before it.
+*/
+struct PackedHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t block_letters;
+  uint32_t reserved;
+};
+
+/* This function returns the number of bytes taken by num_of_letters packed letters */
+size_t packed_size(size_t num_of_letters);
+
+/*
+  This function packs letters 5 bits each
+  - parameters: letters ('A'-'Z', nothing else), num_of_letters, packed (with room for packed_size(num_of_letters) bytes), use_bmi2
+  - 8 letters at a time: the letters are loaded as one 64-bit word, and their low 5 bits are extracted
+    with a single pext with use_bmi2 on a BMI2 CPU (shifts and ors otherwise)
+*/
+void pack_letters(char const letters[], size_t num_of_letters, unsigned char packed[], bool use_bmi2 = true);
+
+/*
+  This function unpacks letters packed by pack_letters
+  - parameters: packed, num_of_letters, letters (with room for num_of_letters letters, written as 'A'-'Z'), use_bmi2
+  - 8 letters at a time, spread back into bytes with a single pdep with use_bmi2 on a BMI2 CPU
+  - returns false if a packed value is not a letter (25 is the largest letter code)
+*/
+bool unpack_letters(unsigned char const packed[], size_t num_of_letters, char letters[], bool use_bmi2 = true);
+
+/* This function returns true if pack_letters / unpack_letters can use BMI2 on this CPU */
+bool packing_bmi2_supported();
+
+/* Writes letters to a packed stream, one block at a time */
+class PackedWriter {
+  ostream& out;
+  int block_letters;
+  /* Letters of the block being filled */
+  vector<char> pending;
+  vector<unsigned char> packed;
+  bool header_written = false;
+
+  /* This function writes the header if it has not been written yet */
+  void write_header();
+  /* This function packs and writes the letters of pending as one block */
+  void write_block();
+
+  public:
+    /*
+      PackedWriter constructor
+      - parameters: output stream, block_letters (a multiple of 8)
+    */
+    PackedWriter (ostream& out, int block_letters = PACKED_BLOCK_LETTERS);
+    /*
+      This function adds letters to the stream
+      - parameters: letters ('A'-'Z'), num_of_letters
+      - full blocks are written as they are filled
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int write(char const letters[], size_t num_of_letters);
+    /*
+      This function writes the last (partial) block and flushes the stream
+      - a stream without any letter is a header alone
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int finish();
+};
+
+/* Reads letters from a packed stream, one block at a time */
+class PackedReader {
+  istream& in;
+  PackedHeader header;
+  vector<unsigned char> packed;
+  /* True once a block of fewer than block_letters letters has been read: it must be the last one */
+  bool last_block = false;
+  /* Letters dropped from the start of the next block (set by seek) */
+  long long skip = 0;
+
+  public:
+    /* PackedReader constructor: the header is read by open() */
+    PackedReader (istream& in);
+    /*
+      This function reads and checks the header of the stream
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int open();
+    /*
+      This function reads the next block of letters
+      - parameter: letters (filled with the block's letters, 'A'-'Z', empty at the end of the stream)
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int read_block(vector<char>& letters);
+    /*
+      This function moves to a letter of the stream (the stream must be seekable, e.g. a file)
+      - parameter: letter (number of letters before it in the stream)
+      - only the block holding the letter is read, by the next read_block
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int seek(long long letter);
+};
+
+/*
+  This function encodes / decodes a whole stream that is packed on input, output or both
+  - parameters: machine, input stream, output stream, packed_input, packed_output, error_input, stats, num_of_threads
+  - an input that is not packed is read as in stream mode (whitespace is skipped), an output that is not
+    packed is written as letters; the letters before an invalid input are still written
+  - stats.bytes_in counts the bytes of the input stream (header and block framing included)
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int encrypt_stream_packed(Machine& machine, istream& in, ostream& out, bool packed_input, bool packed_output,
+  char& error_input, StreamStats& stats, int num_of_threads = 1);
+
+/*
+  This function runs the "pack" subcommand
+  - usage: enigma pack < letters > packed
+           enigma pack --unpack [--from letter-position] [--count N] [packed-file] > letters
+  - parameters: argc, argv (argv[0] is "pack")
+  - --from seeks directly to the block holding the letter (packed-file must be given)
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int pack_command(int argc, char** argv);
+
+#endif
@@ -0,0 +1,107 @@
+#include <thread>
+#include <vector>
+#include "parallel.h"
+#include "errors.h"
+using namespace std;
+
+/* One thread's share of the buffer */
+struct Chunk {
+  long long begin = 0, end = 0;
+  /* Number of letters in the chunk (up to the first invalid input, if any) */
+  long long letters = 0;
+  /* Index of the first letter of the chunk in the whole buffer */
+  long long first_letter = 0;
+  bool invalid = false;
+  int res = NO_ERROR;
+  char error_input = 0;
+};
+
+// counts the letters of a chunk, stopping at the first invalid input
+static void count_letters(char const input[], Chunk& chunk) {
+  for (long long i = chunk.begin; i < chunk.end; i++) {
+    if (input[i] >= 'A' && input[i] <= 'Z')
+      chunk.letters++;
+    else if (!isspace((unsigned char) input[i])) {
+      chunk.invalid = true;
+      chunk.end = i + 1;
+      return;
+    }
+  }
+}
+
+// runs a function on each chunk, on its own thread
+template <typename Function>
+static void for_each_chunk(vector<Chunk>& chunks, Function function) {
+  vector<thread> threads;
+  for (size_t c = 1; c < chunks.size(); c++)
+    threads.emplace_back(function, ref(chunks[c]));
+  function(chunks[0]);
+  for (thread& t : threads)
+    t.join();
+}
+
+int process_parallel(char const input[], long long input_length, char output[], long long& output_length, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf, char& error_input, int num_of_threads, Keystream const* keystream, long long& step) {
+  output_length = 0;
+  if (input_length <= 0)
+    return NO_ERROR;
+  if (num_of_threads < 1)
+    num_of_threads = 1;
+  if (num_of_threads > input_length)
+    num_of_threads = input_length;
+
+  vector<Chunk> chunks(num_of_threads);
+  for (int c = 0; c < num_of_threads; c++) {
+    chunks[c].begin = input_length * c / num_of_threads;
+    chunks[c].end = input_length * (c + 1) / num_of_threads;
+  }
+
+  for_each_chunk(chunks, [input](Chunk& chunk) { count_letters(input, chunk); });
+
+  // nothing after the first invalid input is processed
+  long long letters = 0;
+  size_t used = 0;
+  while (used < chunks.size()) {
+    chunks[used].first_letter = letters;
+    letters += chunks[used].letters;
+    if (chunks[used++].invalid)
+      break;
+  }
+  chunks.resize(used);
+
+  for_each_chunk(chunks, [&](Chunk& chunk) {
+    // each thread works on its own copy of the rotors, moved to the chunk's first letter
+    vector<Rotor> rotors;
+    vector<Rotor*> copies_ptr;
+    if (!keystream) {
+      rotors.reserve(num_of_rotors);
+      for (int i=0; i < num_of_rotors; i++) {
+        rotors.push_back(*rotors_ptr[i]);
+        copies_ptr.push_back(&rotors[i]);
+      }
+      advance_rotors(num_of_rotors, copies_ptr.data(), chunk.first_letter);
+    }
+    long long chunk_step = step + chunk.first_letter;
+    char* chunk_output = output + chunk.first_letter;
+
+    // process_block takes int lengths, so the chunk is fed in blocks
+    for (long long begin = chunk.begin; begin < chunk.end && chunk.res == NO_ERROR; begin += BLOCK_SIZE) {
+      int length = min<long long>(BLOCK_SIZE, chunk.end - begin), written = 0;
+      if (keystream)
+        chunk.res = keystream->process_block(input + begin, length, chunk_output, written, chunk_step, chunk.error_input);
+      else
+        chunk.res = process_block(input + begin, length, chunk_output, written, num_of_rotors, pb, copies_ptr.data(), rf, chunk.error_input);
+      chunk_output += written;
+    }
+  });
+
+  output_length = letters;
+  int res = chunks.back().res;
+  if (res != NO_ERROR)
+    error_input = chunks.back().error_input;
+
+  if (keystream)
+    step += letters;
+  else
+    advance_rotors(num_of_rotors, rotors_ptr, letters);
+  return res;
+}
@@ -0,0 +1,25 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "enigma.h"
+#include "keystream.h"
+using namespace std;
+
+/* Number of input bytes given to each thread per block in multithreaded stream mode */
+int const PARALLEL_CHUNK_SIZE = 1 << 20;
+
+/* 
+  This function encodes / decodes a buffer on several threads
+  - parameters: input array, input_length, output array, output_length, num_of_rotors, plugboard, 
+    pointer to an array of rotors, reflector, error_input, num_of_threads, keystream, step
+  - the input is split into one chunk per thread; each thread counts the letters of its chunk, 
+    then seeks its own copy of the rotors to its first letter and processes the chunk
+  - if keystream is not NULL, it is used instead of the rotors, starting at step; 
+    step is incremented by the number of letters processed and the rotors are not moved
+  - otherwise the rotors are advanced past all letters processed
+  - output is identical to calling process_block on the whole buffer, including error reporting
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int process_parallel(char const input[], long long input_length, char output[], long long& output_length, int num_of_rotors, Plugboard& pb, Rotor** rotors_ptr, Reflector& rf, char& error_input, int num_of_threads, Keystream const* keystream, long long& step);
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/* 
+  A bounded lock-free queue for any number of producers and consumers (a ring of slots,
+  each with a sequence number telling whether it is free for the next push or holds the 
+  value for the next pop). push and pop wait (yielding the thread) while the queue is full / empty.
+*/
+template <class T>
+class BoundedQueue {
+  struct Slot {
+    atomic<size_t> sequence;
+    T value;
+  };
+  vector<Slot> slots;
+  size_t mask;
+  /* Positions of the next push and the next pop, each on its own cache line */
+  alignas(64) atomic<size_t> push_pos;
+  alignas(64) atomic<size_t> pop_pos;
+
+  public:
+    /* 
+      BoundedQueue constructor
+      - parameter: capacity (rounded up to a power of two, at least 2)
+    */
+    BoundedQueue (size_t capacity) : push_pos(0), pop_pos(0) {
+      size_t size = 2;
+      while (size < capacity)
+        size *= 2;
+      slots = vector<Slot>(size);
+      mask = size - 1;
+      for (size_t i=0; i < size; i++)
+        slots[i].sequence.store(i, memory_order_relaxed);
+    }
+    BoundedQueue (BoundedQueue const&) = delete;
+    BoundedQueue& operator= (BoundedQueue const&) = delete;
+
+    /* This function adds a value, returns false if the queue is full */
+    bool try_push(T const& value) {
+      size_t pos = push_pos.load(memory_order_relaxed);
+      for (;;) {
+        Slot& slot = slots[pos & mask];
+        size_t sequence = slot.sequence.load(memory_order_acquire);
+        long long difference = (long long) sequence - (long long) pos;
+        if (difference == 0) {
+          if (push_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+            slot.value = value;
+            slot.sequence.store(pos + 1, memory_order_release);
+            return true;
+          }
+        } else if (difference < 0)
+          return false;
+        else
+          pos = push_pos.load(memory_order_relaxed);
+      }
+    }
+
+    /* This function takes the oldest value, returns false if the queue is empty */
+    bool try_pop(T& value) {
+      size_t pos = pop_pos.load(memory_order_relaxed);
+      for (;;) {
+        Slot& slot = slots[pos & mask];
+        size_t sequence = slot.sequence.load(memory_order_acquire);
+        long long difference = (long long) sequence - (long long) (pos + 1);
+        if (difference == 0) {
+          if (pop_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+            value = slot.value;
+            slot.sequence.store(pos + mask + 1, memory_order_release);
+            return true;
+          }
+        } else if (difference < 0)
+          return false;
+        else
+          pos = pop_pos.load(memory_order_relaxed);
+      }
+    }
+
+    /* These functions wait until the value can be pushed / a value can be popped */
+    void push(T const& value) {
+      while (!try_push(value))
+        this_thread::yield();
+    }
+
+    T pop() {
+      T value;
+      while (!try_pop(value))
+        this_thread::yield();
+      return value;
+    }
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include <thread>
+#include "scheduler.h"
+using namespace std;
+
+WorkStealingPool::WorkStealingPool (int num_of_workers) : num_of_workers(num_of_workers), cancelled(false) {
+  if (this->num_of_workers <= 0)
+    this->num_of_workers = max(1u, thread::hardware_concurrency());
+  for (int w = 0; w < this->num_of_workers; w++)
+    ranges.emplace_back(new Range);
+}
+
+bool WorkStealingPool::next_task(int worker, long long& task) {
+  Range& own = *ranges[worker];
+  while (!cancelled.load(memory_order_relaxed)) {
+    {
+      lock_guard<mutex> guard(own.lock);
+      if (own.begin < own.end) {
+        task = own.begin++;
+        return true;
+      }
+    }
+
+    // steal the back half of the largest range left
+    int victim = -1;
+    long long largest = 0;
+    for (int w = 0; w < num_of_workers; w++) {
+      if (w == worker)
+        continue;
+      lock_guard<mutex> guard(ranges[w]->lock);
+      if (ranges[w]->end - ranges[w]->begin > largest) {
+        largest = ranges[w]->end - ranges[w]->begin;
+        victim = w;
+      }
+    }
+    if (victim < 0)
+      return false;
+
+    // both locks at once: the victim may be trying to steal from this worker
+    Range& other = *ranges[victim];
+    scoped_lock both(other.lock, own.lock);
+    long long remaining = other.end - other.begin;
+    // the victim may have emptied its range in the meantime; look again
+    if (remaining <= 0)
+      continue;
+    long long middle = other.begin + remaining / 2;
+    own.begin = middle;
+    own.end = other.end;
+    other.end = middle;
+  }
+  return false;
+}
+
+void WorkStealingPool::run(long long num_of_tasks, function<void(long long task, int worker)> const& function) {
+  cancelled = false;
+  for (int w = 0; w < num_of_workers; w++) {
+    ranges[w]->begin = num_of_tasks * w / num_of_workers;
+    ranges[w]->end = num_of_tasks * (w + 1) / num_of_workers;
+  }
+
+  auto work = [this, &function](int worker) {
+    long long task;
+    while (next_task(worker, task))
+      function(task, worker);
+  };
+  vector<thread> threads;
+  for (int w = 1; w < num_of_workers; w++)
+    threads.emplace_back(work, w);
+  work(0);
+  for (thread& t : threads)
+    t.join();
+}
+
+void WorkStealingPool::cancel() {
+  cancelled = true;
+}
+
+bool WorkStealingPool::is_cancelled() const {
+  return cancelled;
+}
+
+int WorkStealingPool::get_num_of_workers() const {
+  return num_of_workers;
+}
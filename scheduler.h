@@ -0,0 +1,53 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+/* 
+  A fixed set of worker threads that run numbered tasks with work stealing:
+  every worker starts with an equal contiguous range of the tasks and takes 
+  them from the front; a worker that runs out steals the back half of the 
+  largest remaining range of another worker.
+*/
+class WorkStealingPool {
+  /* The tasks still to be run by one worker */
+  struct Range {
+    mutex lock;
+    long long begin = 0, end = 0;
+  };
+  int num_of_workers;
+  vector<unique_ptr<Range>> ranges;
+  atomic<bool> cancelled;
+
+  /* 
+    This function takes the next task of a worker, stealing if its own range is empty
+    - returns false when there is no task left anywhere (or the pool was cancelled)
+  */
+  bool next_task(int worker, long long& task);
+
+  public:
+    /* 
+      WorkStealingPool constructor
+      - parameter: num_of_workers (if <= 0, one per hardware thread)
+    */
+    WorkStealingPool (int num_of_workers);
+    /* 
+      This function runs function(task, worker) for every task in [0, num_of_tasks)
+      - worker (0 to get_num_of_workers() - 1) identifies the thread, so per-thread state can be indexed by it
+      - the calling thread is worker 0; returns when every task has been run or the pool was cancelled
+    */
+    void run(long long num_of_tasks, function<void(long long task, int worker)> const& function);
+    /* This function makes run() return as soon as the tasks being run finish */
+    void cancel();
+    /* This function returns true if cancel() was called during the current run() */
+    bool is_cancelled() const;
+    /* This function returns the number of worker threads */
+    int get_num_of_workers() const;
+};
+
+#endif
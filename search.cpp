@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "search.h"
+#include "scheduler.h"
+#include "errors.h"
+using namespace std;
+
+void rotor_orders(int num_of_rotor_files, int num_of_rotors, vector<vector<int>>& orders) {
+  orders.clear();
+  if (num_of_rotors <= 0 || num_of_rotors > num_of_rotor_files)
+    return;
+  vector<int> order(num_of_rotors);
+  vector<bool> used(num_of_rotor_files, false);
+  // depth-first over the rotor slots, leftmost first
+  function<void(int)> choose = [&](int slot) {
+    if (slot == num_of_rotors) {
+      orders.push_back(order);
+      return;
+    }
+    for (int r = 0; r < num_of_rotor_files; r++) {
+      if (used[r])
+        continue;
+      used[r] = true;
+      order[slot] = r;
+      choose(slot + 1);
+      used[r] = false;
+    }
+  };
+  choose(0);
+}
+
+long long for_each_setting(vector<Rotor> const& rotor_set, vector<int> const& order, int leftmost_pos, long long position, 
+  function<void(Rotor** rotors_ptr, vector<int> const& starting_pos)> const& callback) {
+  int num_of_rotors = order.size();
+  // the rotors of this order are copied once per call, not per setting
+  vector<Rotor> rotors;
+  vector<Rotor*> rotors_ptr;
+  rotors.reserve(num_of_rotors);
+  for (int i = 0; i < num_of_rotors; i++) {
+    rotors.push_back(rotor_set[order[i]]);
+    rotors_ptr.push_back(&rotors[i]);
+  }
+
+  long long num_of_settings = 1;
+  for (int i = 1; i < num_of_rotors; i++)
+    num_of_settings *= TOTAL_ALPHABET_COUNT;
+  vector<int> starting_pos(num_of_rotors, 0);
+  starting_pos[0] = leftmost_pos;
+  for (long long p = 0; p < num_of_settings; p++) {
+    seek_rotors(num_of_rotors, rotors_ptr.data(), starting_pos.data(), position);
+    callback(rotors_ptr.data(), starting_pos);
+
+    // next starting positions of the other rotors, rightmost fastest
+    for (int i = num_of_rotors - 1; i > 0; i--) {
+      if (++starting_pos[i] < TOTAL_ALPHABET_COUNT)
+        break;
+      starting_pos[i] = 0;
+    }
+  }
+  return num_of_settings;
+}
+
+// true if the machine, from its current rotor positions, turns the ciphertext into the crib
+static bool matches_crib(Plugboard& pb, Reflector& rf, int num_of_rotors, Rotor** rotors_ptr, int const ciphertext[], int const crib[], int crib_length) {
+  for (int j = 0; j < crib_length; j++) {
+    int letter = ciphertext[j];
+    process_letter(letter, num_of_rotors, pb, rotors_ptr, rf);
+    if (letter != crib[j])
+      return false;
+  }
+  return true;
+}
+
+void crib_search(Plugboard& pb, Reflector& rf, vector<Rotor> const& rotor_set, int num_of_rotors, int const ciphertext[], int const crib[], int crib_length, long long crib_offset, int num_of_threads, vector<SearchCandidate>& found, SearchStats& stats) {
+  auto start_time = chrono::steady_clock::now();
+  vector<vector<int>> orders;
+  rotor_orders(rotor_set.size(), num_of_rotors, orders);
+
+  WorkStealingPool pool(num_of_threads);
+  int num_of_workers = pool.get_num_of_workers();
+  vector<vector<SearchCandidate>> worker_found(num_of_workers);
+  vector<long long> worker_candidates(num_of_workers, 0);
+
+  // one task per rotor order and starting position of the leftmost rotor
+  pool.run((long long) orders.size() * TOTAL_ALPHABET_COUNT, [&](long long task, int worker) {
+    vector<int> const& order = orders[task / TOTAL_ALPHABET_COUNT];
+    worker_candidates[worker] += for_each_setting(rotor_set, order, task % TOTAL_ALPHABET_COUNT, crib_offset,
+      [&](Rotor** rotors_ptr, vector<int> const& starting_pos) {
+        if (matches_crib(pb, rf, num_of_rotors, rotors_ptr, ciphertext + crib_offset, crib, crib_length))
+          worker_found[worker].push_back(SearchCandidate{order, starting_pos});
+      });
+  });
+
+  found.clear();
+  stats.candidates = 0;
+  for (int w = 0; w < num_of_workers; w++) {
+    found.insert(found.end(), worker_found[w].begin(), worker_found[w].end());
+    stats.candidates += worker_candidates[w];
+  }
+  sort(found.begin(), found.end(), [](SearchCandidate const& a, SearchCandidate const& b) {
+    return a.rotor_order != b.rotor_order ? a.rotor_order < b.rotor_order : a.starting_pos < b.starting_pos;
+  });
+  stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+int read_letters(istream& in, vector<int>& letters, char& error_input) {
+  char buffer[BLOCK_SIZE];
+  while (in.read(buffer, BLOCK_SIZE).gcount() > 0) {
+    for (streamsize i = 0; i < in.gcount(); i++) {
+      if (buffer[i] >= 'A' && buffer[i] <= 'Z')
+        letters.push_back(buffer[i] - 'A');
+      else if (!isspace((unsigned char) buffer[i])) {
+        error_input = buffer[i];
+        return INVALID_INPUT_CHARACTER;
+      }
+    }
+  }
+  return NO_ERROR;
+}
+
+int search_command(int argc, char** argv) {
+  int num_of_threads = 0;
+  long long crib_offset = 0;
+  bool options_ok = true;
+  // skip "search", then the options
+  argv++;
+  argc--;
+  while (argc > 1 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--threads") == 0)
+      num_of_threads = atoi(argv[1]);
+    else if (strcmp(argv[0], "--crib-offset") == 0)
+      crib_offset = atoll(argv[1]);
+    else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+
+  int const min_parameters = 5;
+  int num_of_rotors = argc >= min_parameters ? atoi(argv[2]) : 0;
+  int num_of_rotor_files = argc - 4;
+  if (!options_ok || argc < min_parameters || num_of_rotors < 1 || num_of_rotors > num_of_rotor_files || crib_offset < 0 || argv[3][0] == '\0') {
+    cerr << "usage: enigma search [--threads N] [--crib-offset K] plugboard-file reflector-file num-of-rotors CRIB (<rotor-file>)+ < ciphertext\n"
+      << "(num-of-rotors must be between 1 and the number of rotor files; CRIB must be at least one letter)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  Plugboard pb(argv[0]);
+  int res = pb.setup();
+  if (res != NO_ERROR)
+    return res;
+  Reflector rf(argv[1]);
+  if ((res = rf.setup()) != NO_ERROR)
+    return res;
+
+  char* crib_text = argv[3];
+  vector<int> crib;
+  for (int i = 0; crib_text[i] != '\0'; i++) {
+    if (crib_text[i] < 'A' || crib_text[i] > 'Z') {
+      cerr << crib_text[i] << " is not a valid crib character "
+        << "(input characters must be upper case letters A-Z)!\n";
+      return INVALID_INPUT_CHARACTER;
+    }
+    crib.push_back(crib_text[i] - 'A');
+  }
+
+  // every rotor file is parsed once, whatever the number of candidates
+  char** rot_files = argv + 4;
+  vector<Rotor> rotor_set;
+  for (int i = 0; i < num_of_rotor_files; i++) {
+    rotor_set.push_back(Rotor(rot_files[i]));
+    if ((res = rotor_set.back().setup()) != NO_ERROR)
+      return res;
+  }
+
+  vector<int> ciphertext;
+  char error_input;
+  ios::sync_with_stdio(false);
+  if ((res = read_letters(cin, ciphertext, error_input)) != NO_ERROR) {
+    cerr << error_input << " is not a valid input character "
+      << "(input characters must be upper case letters A-Z)!\n";
+    return res;
+  }
+  if ((long long) ciphertext.size() < crib_offset + (long long) crib.size()) {
+    cerr << "The ciphertext is shorter than the crib (" << ciphertext.size() << " letters)\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  vector<SearchCandidate> found;
+  SearchStats stats;
+  crib_search(pb, rf, rotor_set, num_of_rotors, ciphertext.data(), crib.data(), crib.size(), crib_offset, num_of_threads, found, stats);
+
+  for (SearchCandidate const& candidate : found) {
+    for (int r : candidate.rotor_order)
+      cout << rot_files[r] << ' ';
+    cout << "positions:";
+    for (int p : candidate.starting_pos)
+      cout << ' ' << p;
+    cout << '\n';
+  }
+  cout.flush();
+
+  cerr << "searched " << stats.candidates << " candidates in " << stats.seconds << " s ("
+    << (stats.seconds > 0 ? stats.candidates / stats.seconds : 0) << " candidates/s), "
+    << found.size() << " found\n";
+  return NO_ERROR;
+}
@@ -0,0 +1,73 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <functional>
+#include <vector>
+#include "enigma.h"
+using namespace std;
+
+/* A setting found by crib_search */
+struct SearchCandidate {
+  /* Indices into the rotor set, leftmost rotor first */
+  vector<int> rotor_order;
+  /* Starting position of each rotor, leftmost rotor first */
+  vector<int> starting_pos;
+};
+
+/* Counters filled in by crib_search */
+struct SearchStats {
+  /* Number of (rotor order, starting positions) candidates tested */
+  long long candidates = 0;
+  /* Wall-clock time of the search */
+  double seconds = 0;
+};
+
+/* 
+  This function lists every ordered choice of num_of_rotors different rotors out of a set
+  - parameters: size of the rotor set, num_of_rotors, orders
+  - orders is filled with vectors of indices into the rotor set, leftmost rotor first
+*/
+void rotor_orders(int num_of_rotor_files, int num_of_rotors, vector<vector<int>>& orders);
+
+/* 
+  This function runs through the settings of one rotor order that share the leftmost rotor's starting position
+  - parameters: rotor_set, order (indices into the rotor set, leftmost first), leftmost_pos, position, callback
+  - the rotors of the order are copied once; for each starting position of the other rotors (rightmost 
+    fastest), the copies are set to 'position' letters after the starting positions and callback is called 
+    with them and the starting positions
+  - this is the task of crib_search, crib_drag, crack, bombe, build_catalogue and job workers
+  - returns the number of settings (26^(num_of_rotors-1))
+*/
+long long for_each_setting(vector<Rotor> const& rotor_set, vector<int> const& order, int leftmost_pos, long long position, 
+  function<void(Rotor** rotors_ptr, vector<int> const& starting_pos)> const& callback);
+
+/* 
+  This function searches for the rotor orders and starting positions that turn the ciphertext into the crib
+  - parameters: plugboard, reflector, rotor_set (rotors set up once from their files), num_of_rotors, 
+    ciphertext (letters 0-25), crib (letters 0-25), crib_length, crib_offset (letter position of the crib 
+    in the ciphertext), num_of_threads, found, stats
+  - every rotor order is tested with all 26^num_of_rotors starting positions; a candidate is 
+    dropped at the first letter that does not match the crib
+  - the work is spread over num_of_threads workers with a WorkStealingPool
+  - found is filled with the matching candidates, sorted by rotor order then starting positions
+*/
+void crib_search(Plugboard& pb, Reflector& rf, vector<Rotor> const& rotor_set, int num_of_rotors, int const ciphertext[], int const crib[], int crib_length, long long crib_offset, int num_of_threads, vector<SearchCandidate>& found, SearchStats& stats);
+
+/* 
+  This function runs the "search" subcommand
+  - usage: enigma search [--threads N] [--crib-offset K] plugboard-file reflector-file num-of-rotors CRIB (<rotor-file>)+ < ciphertext
+  - parameters: argc, argv (argv[0] is "search")
+  - prints the matching settings to stdout and the search rate to stderr
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int search_command(int argc, char** argv);
+
+/* 
+  This function reads the letters of a ciphertext from a stream
+  - parameters: input stream, letters (filled with 0-25), error_input
+  - whitespace is skipped
+  - returns an integer: 0 if NO _ERROR, INVALID_INPUT_CHARACTER otherwise
+*/
+int read_letters(istream& in, vector<int>& letters, char& error_input);
+
+#endif
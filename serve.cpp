@@ -0,0 +1,260 @@
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "serve.h"
+#include "session.h"
+#include "keycache.h"
+#include "errors.h"
+using namespace std;
+
+/* Written by the SIGINT / SIGTERM handler, and watched by every event loop */
+static int stop_fd = -1;
+
+static void stop_serving(int) {
+  uint64_t one = 1;
+  ssize_t written = write(stop_fd, &one, sizeof(one));
+  (void) written;
+}
+
+/* A client connection and its session */
+struct Connection {
+  int fd;
+  Session session;
+  /* Output not written to the socket yet (from pending_start on) */
+  vector<char> pending;
+  size_t pending_start = 0;
+  /* The connection is closed once pending has been written */
+  bool closing = false;
+  /* The connection waits for the socket to be writable (and reads nothing meanwhile) */
+  bool waiting_output = false;
+
+  Connection (int fd, shared_ptr<Machine const> const& machine) : fd(fd), session(machine) {}
+};
+
+/* This function encodes what was read from a connection into its pending output (see serve for the protocol) */
+static void process_request(Connection& connection, char const input[], size_t length) {
+  vector<char>& output = connection.pending;
+  size_t start = 0;
+  for (size_t i=0; i <= length && !connection.closing; i++) {
+    if (i < length && input[i] != '\n' && input[i] != '#')
+      continue;
+
+    // the letters up to the newline / reset / end of the input
+    size_t output_length = output.size();
+    output.resize(output_length + (i - start));
+    char error_input;
+    int res = connection.session.encrypt(input + start, i - start, output.data(), output_length, error_input);
+    output.resize(output_length);
+    if (res != NO_ERROR) {
+      output.push_back('!');
+      output.push_back(error_input);
+      output.push_back('\n');
+      connection.closing = true;
+    } else if (i < length && input[i] == '\n')
+      output.push_back('\n');
+    else if (i < length)
+      connection.session.reset();
+    start = i + 1;
+  }
+}
+
+/* 
+  This function writes as much of the pending output as the socket takes
+  - returns false if the connection failed
+*/
+static bool flush(Connection& connection) {
+  while (connection.pending_start < connection.pending.size()) {
+    ssize_t written = send(connection.fd, connection.pending.data() + connection.pending_start, 
+      connection.pending.size() - connection.pending_start, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    connection.pending_start += written;
+  }
+  connection.pending.clear();
+  connection.pending_start = 0;
+  return true;
+}
+
+/* 
+  This function reads and answers a connection until its socket is drained or its output backs up
+  - returns false if the connection is finished (closed by the client, failed or ended by an error)
+*/
+static bool serve_connection(Connection& connection, int epoll_fd) {
+  char input[SERVE_READ_SIZE];
+  while (!connection.closing && connection.pending.empty()) {
+    ssize_t length = read(connection.fd, input, sizeof(input));
+    if (length < 0 && errno == EINTR)
+      continue;
+    if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    if (length <= 0)
+      connection.closing = true;
+    else
+      process_request(connection, input, length);
+    if (!flush(connection))
+      return false;
+  }
+
+  // a client that does not read its replies is not read from either
+  bool waiting_output = !connection.pending.empty();
+  if (waiting_output != connection.waiting_output) {
+    epoll_event event = {};
+    event.events = waiting_output ? EPOLLOUT : EPOLLIN;
+    event.data.ptr = &connection;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.waiting_output = waiting_output;
+  }
+  return !(connection.closing && connection.pending.empty());
+}
+
+/* This function runs the event loop of one thread: it accepts connections and serves them until stop_fd is written */
+static void event_loop(int listen_fd, shared_ptr<Machine const> machine) {
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    cerr << "Error creating an event loop: " << strerror(errno) << endl;
+    return;
+  }
+  // the listening socket wakes one loop per new connection; the stop event wakes them all
+  static int listen_tag, stop_tag;
+  epoll_event event = {};
+  event.events = EPOLLIN | EPOLLEXCLUSIVE;
+  event.data.ptr = &listen_tag;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+  event.events = EPOLLIN;
+  event.data.ptr = &stop_tag;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &event);
+
+  unordered_map<Connection*, unique_ptr<Connection>> connections;
+  epoll_event events[SERVE_MAX_EVENTS];
+  bool stopping = false;
+  while (!stopping) {
+    int num_of_events = epoll_wait(epoll_fd, events, SERVE_MAX_EVENTS, -1);
+    if (num_of_events < 0 && errno != EINTR) {
+      cerr << "Error waiting for events: " << strerror(errno) << endl;
+      break;
+    }
+    for (int e = 0; e < num_of_events; e++) {
+      void* tag = events[e].data.ptr;
+      if (tag == &stop_tag) {
+        stopping = true;
+      } else if (tag == &listen_tag) {
+        int fd;
+        while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+          unique_ptr<Connection> connection(new Connection(fd, machine));
+          epoll_event client_event = {};
+          client_event.events = EPOLLIN;
+          client_event.data.ptr = connection.get();
+          epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &client_event);
+          connections[connection.get()] = move(connection);
+        }
+      } else {
+        Connection* connection = (Connection*) tag;
+        bool open = flush(*connection) && serve_connection(*connection, epoll_fd);
+        if (!open) {
+          close(connection->fd);
+          connections.erase(connection);
+        }
+      }
+    }
+  }
+
+  for (auto& connection : connections)
+    close(connection.second->fd);
+  close(epoll_fd);
+}
+
+int serve(char const* socket_path, shared_ptr<Machine const> machine, int num_of_threads) {
+  if (num_of_threads <= 0)
+    num_of_threads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address.sun_path)) {
+    cerr << "Socket path too long: " << socket_path << endl;
+    return SOCKET_ERROR;
+  }
+  strcpy(address.sun_path, socket_path);
+
+  // a socket left behind by a previous server is replaced, any other file is not
+  struct stat status;
+  if (stat(socket_path, &status) == 0 && S_ISSOCK(status.st_mode))
+    unlink(socket_path);
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0 || bind(listen_fd, (sockaddr*) &address, sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+    cerr << "Error listening on " << socket_path << ": " << strerror(errno) << endl;
+    if (listen_fd >= 0)
+      close(listen_fd);
+    return SOCKET_ERROR;
+  }
+
+  stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  signal(SIGINT, stop_serving);
+  signal(SIGTERM, stop_serving);
+  signal(SIGPIPE, SIG_IGN);
+  cerr << "serving on " << socket_path << " with " << num_of_threads << " thread(s)\n";
+
+  // the calling thread runs the first event loop
+  vector<thread> threads;
+  for (int t = 1; t < num_of_threads; t++)
+    threads.push_back(thread(event_loop, listen_fd, machine));
+  event_loop(listen_fd, machine);
+  for (thread& t : threads)
+    t.join();
+
+  close(listen_fd);
+  close(stop_fd);
+  unlink(socket_path);
+  return NO_ERROR;
+}
+
+int serve_command(int argc, char** argv) {
+  int num_of_threads = 0;
+  char * key_file = NULL;
+  bool options_ok = true;
+  // skip "serve", then the options
+  argv++;
+  argc--;
+  while (argc > 1 && strncmp(argv[0], "--", 2) == 0) {
+    if (strcmp(argv[0], "--threads") == 0)
+      num_of_threads = atoi(argv[1]);
+    else if (strcmp(argv[0], "--key") == 0)
+      key_file = argv[1];
+    else {
+      cerr << "unknown option " << argv[0] << endl;
+      options_ok = false;
+      break;
+    }
+    argv += 2;
+    argc -= 2;
+  }
+
+  // argv[0] is the socket path, followed by the configuration files as for the enigma command
+  if (!options_ok || argc < 1 || strncmp(argv[0], "--", 2) == 0 || (key_file ? argc != 1 : argc < MIN_PARAMETERS)) {
+    cerr << "usage: enigma serve [--threads N] socket-path plugboard-file reflector-file (<rotor-file>)* rotor-positions\n"
+      << "       enigma serve [--threads N] --key key-file socket-path\n";
+    return INSUFFICIENT_NUMBER_OF_PARAMETERS;
+  }
+
+  // compiled once, so that every session looks its letters up in the same keystream
+  vector<string> key_files = key_file ? vector<string>{"--key", key_file} : vector<string>(argv + 1, argv + argc);
+  shared_ptr<Machine const> machine;
+  KeyCache keys;
+  int res = keys.get(key_files, true, machine);
+  if (res != NO_ERROR)
+    return res;
+  return serve(argv[0], machine, num_of_threads);
+}
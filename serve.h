@@ -0,0 +1,33 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <memory>
+#include "machine.h"
+using namespace std;
+
+/* Number of bytes a connection reads from its socket at a time */
+int const SERVE_READ_SIZE = 1 << 14;
+/* Maximum number of events handled per wake-up of an event loop */
+int const SERVE_MAX_EVENTS = 64;
+
+/* 
+  This function serves encoding / decoding sessions on a Unix domain socket until SIGINT or SIGTERM
+  - parameters: socket_path, machine (shared read-only by every session), num_of_threads (if <= 0, one per hardware thread)
+  - every thread runs its own event loop (epoll) over the connections it accepted, so a fixed
+    number of threads serves any number of connections
+  - every connection is a Session that starts at the machine's starting positions:
+    letters A-Z come back encoded / decoded, a newline comes back as a newline (a client can send
+    a message per line and wait for the line of reply), other whitespace is skipped, '#' sets the
+    session back to the starting positions, and any other character ends the connection with "!<character>\n"
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int serve(char const* socket_path, shared_ptr<Machine const> machine, int num_of_threads);
+
+/* 
+  This function runs the serve subcommand: enigma serve [--threads N] socket-path (configuration files | --key key-file)
+  - parameters: argc, argv (argv[0] is "serve")
+  - returns an integer: 0 if NO _ERROR, > 0 otherwise
+*/
+int serve_command(int argc, char** argv);
+
+#endif
@@ -0,0 +1,63 @@
+#include <cctype>
+#include "session.h"
+#include "errors.h"
+using namespace std;
+
+Session::Session (shared_ptr<Machine const> machine) : machine(machine), keystream(machine->get_keystream()), num_of_rotors(machine->get_num_of_rotors()),
+  pb_map(machine->get_plugboard().get_mapping()), rf_map(machine->get_reflector().get_mapping()), offsets(num_of_rotors) {
+  for (int i=0; i < num_of_rotors; i++)
+    rotors.push_back(&machine->get_rotor(i));
+  reset();
+}
+
+void Session::reset() {
+  int const* starting_pos = machine->get_starting_pos();
+  for (int i=0; i < num_of_rotors; i++)
+    offsets[i] = starting_pos[i] % TOTAL_ALPHABET_COUNT;
+  position = 0;
+}
+
+long long Session::get_position() const {
+  return position;
+}
+
+int Session::encrypt(char const input[], size_t input_length, char output[], size_t& output_length, char& error_input) {
+  if (keystream) {
+    // the table's step is the position; process_block takes int lengths, so long buffers are fed in blocks
+    int res = NO_ERROR;
+    for (size_t begin = 0; begin < input_length && res == NO_ERROR; begin += BLOCK_SIZE) {
+      int length = input_length - begin < (size_t) BLOCK_SIZE ? input_length - begin : BLOCK_SIZE;
+      int written = 0;
+      res = keystream->process_block(input + begin, length, output + output_length, written, position, error_input);
+      output_length += written;
+    }
+    return res;
+  }
+
+  Rotor const* const* rotors_ptr = rotors.data();
+  int* offset = offsets.data();
+  for (size_t i=0; i < input_length; i++) {
+    // ignore any whitespace, including line breaks
+    if (isspace((unsigned char) input[i]))
+      continue;
+
+    if (input[i] < 'A' || input[i] > 'Z') {
+      error_input = input[i];
+      return INVALID_INPUT_CHARACTER;
+    }
+
+    // rotate the rightmost rotor, and each rotor whose right neighbour hits a notch
+    for (int r = num_of_rotors - 1; r >= 0 && rotors_ptr[r]->step(offset[r]); r--)
+      ;
+
+    int letter = pb_map[input[i] - 'A'];
+    for (int r = num_of_rotors - 1; r >= 0; r--)
+      letter = rotors_ptr[r]->map(letter, offset[r], false);
+    letter = rf_map[letter];
+    for (int r = 0; r < num_of_rotors; r++)
+      letter = rotors_ptr[r]->map(letter, offset[r], true);
+    output[output_length++] = pb_map[letter] + 'A';
+    position++;
+  }
+  return NO_ERROR;
+}
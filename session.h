@@ -0,0 +1,51 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <memory>
+#include <vector>
+#include "enigma.h"
+#include "machine.h"
+using namespace std;
+
+/* 
+  One operator's use of a shared machine: the wiring (plugboard, reflector, rotors) is
+  read from a Machine that is shared, read-only, by every session, and only the rotor 
+  offsets - the state that changes as letters are processed - belong to the session.
+  Any number of sessions can run on different threads over one Machine.
+*/
+class Session {
+  /* The shared wiring, kept alive by the session */
+  shared_ptr<Machine const> machine;
+  /* The machine's keystream if it is compiled (see Machine::compile), NULL otherwise */
+  shared_ptr<Keystream const> keystream;
+  int num_of_rotors;
+  int const* pb_map;
+  int const* rf_map;
+  vector<Rotor const*> rotors;
+  /* The offsets of the rotors of this session (leftmost first) */
+  vector<int> offsets;
+  /* Number of letters processed since the last reset() */
+  long long position = 0;
+
+  public:
+    /* 
+      Session constructor
+      - parameter: the shared machine (its rotors' own offsets are never used)
+      - the session starts at the machine's starting positions
+    */
+    Session (shared_ptr<Machine const> machine);
+    /* This function sets the rotors of this session back to the starting positions */
+    void reset();
+    /* This function returns the number of letters processed since the last reset() */
+    long long get_position() const;
+    /* 
+      This function encodes / decodes a buffer from the session's current position (as process_block)
+      - one table lookup per letter if the machine is compiled, the rotors are walked through otherwise
+      - parameters: input array, input_length, output array (with room for input_length letters), output_length, error_input
+      - whitespace is skipped; the letters before an invalid input are still written
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int encrypt(char const input[], size_t input_length, char output[], size_t& output_length, char& error_input);
+};
+
+#endif
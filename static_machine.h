@@ -0,0 +1,154 @@
+#ifndef STATIC_MACHINE_H
+#define STATIC_MACHINE_H
+
+#include <cctype>
+#include <cstddef>
+#include <tuple>
+#include "enigma.h"
+#include "machine.h"
+#include "errors.h"
+#include "wirings.h"
+using namespace std;
+
+/* 
+  A machine whose reflector and rotors are fixed at compile time, e.g.
+    StaticMachine<wirings::Reflector_I, wirings::Rotor_I, wirings::Rotor_II, wirings::Rotor_III>
+  with the constexpr wirings generated into wirings.h from the standard configuration files.
+  - rotors are given leftmost first, as on the command line
+  - the rotor loops are unrolled and there is no num_of_rotors > 0 check, so the offsets
+    can stay in registers; the plugboard and the starting positions are still set at run time
+  - encodes exactly as process_block does; custom rotor files use the runtime machine (Machine)
+*/
+template <class ReflectorWiring, class... RotorWirings>
+class StaticMachine {
+  static_assert(sizeof...(RotorWirings) > 0, "a StaticMachine needs at least one rotor");
+  static int const NUM_OF_ROTORS = sizeof...(RotorWirings);
+
+  /* The wiring of rotor I (0 is the leftmost) */
+  template <int I>
+  using RotorAt = typename tuple_element<I, tuple<RotorWirings...>>::type;
+
+  int pb_map[TOTAL_ALPHABET_COUNT];
+  int starting_pos[NUM_OF_ROTORS];
+  int offsets[NUM_OF_ROTORS];
+
+  /* This function maps input through a wiring table turned by offset (as Rotor::process_input) */
+  static int shift(unsigned char const table[], int input, int offset) {
+    int shifted = input + offset;
+    if (shifted > TOTAL_ALPHABET_COUNT - 1)
+      shifted -= TOTAL_ALPHABET_COUNT;
+    int output = table[shifted] - offset;
+    return output < 0 ? output + TOTAL_ALPHABET_COUNT : output;
+  }
+
+  /* This function rotates rotor I, and the rotor to its left if the notch of I is triggered */
+  template <int I>
+  void step() {
+    offsets[I] = offsets[I] < TOTAL_ALPHABET_COUNT - 1 ? offsets[I] + 1 : 0;
+    if constexpr (I > 0) {
+      if ((RotorAt<I>::notch_mask >> offsets[I]) & 1u)
+        step<I - 1>();
+    }
+  }
+
+  /* These functions pass input through rotors I down to 0 (R-L), and I up to the rightmost (L-R) */
+  template <int I>
+  int forward(int input) const {
+    input = shift(RotorAt<I>::forward, input, offsets[I]);
+    if constexpr (I > 0)
+      return forward<I - 1>(input);
+    else
+      return input;
+  }
+
+  template <int I>
+  int backward(int input) const {
+    input = shift(RotorAt<I>::backward, input, offsets[I]);
+    if constexpr (I < NUM_OF_ROTORS - 1)
+      return backward<I + 1>(input);
+    else
+      return input;
+  }
+
+  public:
+    /* 
+      StaticMachine constructor
+      - parameters: plugboard (already set up), starting positions (one per rotor, leftmost first)
+    */
+    StaticMachine (Plugboard const& pb, int const starting_pos[]) {
+      int const* mapping = pb.get_mapping();
+      for (int i=0; i < TOTAL_ALPHABET_COUNT; i++)
+        pb_map[i] = mapping[i];
+      for (int i=0; i < NUM_OF_ROTORS; i++)
+        this->starting_pos[i] = starting_pos[i] % TOTAL_ALPHABET_COUNT;
+      reset();
+    }
+
+    /* StaticMachine constructor: the plugboard and starting positions of a loaded machine (see matches) */
+    explicit StaticMachine (Machine& machine) : StaticMachine(machine.get_plugboard(), machine.get_starting_pos()) {}
+
+    /* 
+      This function checks whether a loaded machine has this reflector and these rotors
+      - returns true if the machine can be replaced by a StaticMachine constructed from it
+    */
+    static bool matches(Machine& machine) {
+      if (machine.get_num_of_rotors() != NUM_OF_ROTORS)
+        return false;
+      int const* rf_map = machine.get_reflector().get_mapping();
+      for (int i=0; i < TOTAL_ALPHABET_COUNT; i++)
+        if (rf_map[i] != ReflectorWiring::mapping[i])
+          return false;
+      Rotor** rotors = machine.get_rotors();
+      unsigned char const* forwards[] = {RotorWirings::forward...};
+      unsigned const notch_masks[] = {RotorWirings::notch_mask...};
+      for (int r=0; r < NUM_OF_ROTORS; r++) {
+        if (rotors[r]->get_notch_mask() != notch_masks[r])
+          return false;
+        int const* mapping = rotors[r]->get_mapping();
+        for (int i=0; i < TOTAL_ALPHABET_COUNT; i++)
+          if (mapping[i] != forwards[r][i])
+            return false;
+      }
+      return true;
+    }
+
+    /* This function sets the rotors back to their starting positions */
+    void reset() {
+      for (int i=0; i < NUM_OF_ROTORS; i++)
+        offsets[i] = starting_pos[i];
+    }
+
+    /* 
+      This function encodes / decodes one letter (0-25) and steps the rotors
+      - returns the encoded letter (0-25)
+    */
+    int process_letter(int letter) {
+      step<NUM_OF_ROTORS - 1>();
+      letter = forward<NUM_OF_ROTORS - 1>(pb_map[letter]);
+      letter = backward<0>(ReflectorWiring::mapping[letter]);
+      return pb_map[letter];
+    }
+
+    /* 
+      This function encodes / decodes a buffer from the current rotor positions (see process_block)
+      - parameters: input array, input_length, output array (with room for input_length letters), output_length, error_input
+      - whitespace is skipped; the letters before an invalid input are still written
+      - returns an integer: 0 if NO _ERROR, > 0 otherwise
+    */
+    int encrypt(char const input[], size_t input_length, char output[], size_t& output_length, char& error_input) {
+      for (size_t i=0; i < input_length; i++) {
+        if (isspace((unsigned char) input[i]))
+          continue;
+
+        if (input[i] < 'A' || input[i] > 'Z') {
+          error_input = input[i];
+          return INVALID_INPUT_CHARACTER;
+        }
+
+        output[output_length++] = process_letter(input[i] - 'A') + 'A';
+      }
+      return NO_ERROR;
+    }
+};
+
+#endif
@@ -0,0 +1,71 @@
+// Generates wirings.h: the wirings of the standard rotor and reflector files
+// as constexpr tables, for the compile-time machines of static_machine.h.
+// The files are read and checked by Rotor::setup / Reflector::setup, so a
+// generated table is exactly what the runtime machine would load.
+//
+// usage: wirings_gen (rotor-file | reflector-file)* > wirings.h
+// (rotors/I.rot becomes wirings::Rotor_I, reflectors/II.rf wirings::Reflector_II)
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "enigma.h"
+#include "errors.h"
+using namespace std;
+
+/* This function returns the C++ name of a configuration file: its base name without extension */
+static string type_name(char const* prefix, char const* file) {
+  char const* base = strrchr(file, '/');
+  base = base ? base + 1 : file;
+  string name = prefix;
+  for (char const* c = base; *c && *c != '.'; c++)
+    name += isalnum((unsigned char) *c) ? *c : '_';
+  return name;
+}
+
+static void print_table(char const* name, int const table[]) {
+  cout << "  static constexpr unsigned char " << name << "[TOTAL_ALPHABET_COUNT] = {";
+  for (int i=0; i < TOTAL_ALPHABET_COUNT; i++)
+    cout << (i ? ", " : "") << table[i];
+  cout << "};\n";
+}
+
+static bool has_extension(char const* file, char const* extension) {
+  size_t length = strlen(file), ext_length = strlen(extension);
+  return length > ext_length && strcmp(file + length - ext_length, extension) == 0;
+}
+
+int main(int argc, char** argv) {
+  cout << "// Generated by wirings_gen from the standard configuration files: do not edit\n"
+    << "#ifndef WIRINGS_H\n#define WIRINGS_H\n\n"
+    << "#include \"enigma.h\"\n\nnamespace wirings {\n";
+
+  for (int i=1; i < argc; i++) {
+    int res = NO_ERROR;
+    if (has_extension(argv[i], ".rot")) {
+      Rotor rotor(argv[i]);
+      res = rotor.setup();
+      if (res == NO_ERROR) {
+        cout << "\n/* " << argv[i] << " */\nstruct " << type_name("Rotor_", argv[i]) << " {\n";
+        print_table("forward", rotor.get_mapping(false));
+        print_table("backward", rotor.get_mapping(true));
+        cout << "  static constexpr unsigned notch_mask = " << rotor.get_notch_mask() << "u;\n};\n";
+      }
+    } else if (has_extension(argv[i], ".rf")) {
+      Reflector reflector(argv[i]);
+      res = reflector.setup();
+      if (res == NO_ERROR) {
+        cout << "\n/* " << argv[i] << " */\nstruct " << type_name("Reflector_", argv[i]) << " {\n";
+        print_table("mapping", reflector.get_mapping());
+        cout << "};\n";
+      }
+    } else {
+      cerr << "wirings_gen: " << argv[i] << " is neither a rotor (.rot) nor a reflector (.rf) file\n";
+      res = INSUFFICIENT_NUMBER_OF_PARAMETERS;
+    }
+    if (res != NO_ERROR)
+      return res;
+  }
+
+  cout << "\n}\n\n#endif\n";
+  return NO_ERROR;
+}